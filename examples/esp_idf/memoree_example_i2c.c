@@ -58,43 +58,52 @@ void i2c_detect(void)
   printf("\n-[ Scan Done ]-\n\n");
 }
 
+/// @brief Running state of memdump()
+typedef struct
+{
+  uint32_t addr;      ///< Address of the next byte to print
+  uint8_t line_width; ///< Number of bytes to print out in one line
+} memdump_ctx_t;
+
+/// @brief Sink of memoree_dump_stream() printing each chunk as lines of hex bytes
+static int memdump_sink(const uint8_t *data, uint32_t len, void *ctx)
+{
+  memdump_ctx_t *dump = ctx;
+  char line_buff[256];
+
+  for (uint32_t j = 0; j < len; j += dump->line_width)
+  {
+    snprintf(line_buff, sizeof(line_buff), "0x%04lX: ", dump->addr + j);
+    for (uint32_t k = j; k < len && k < j + dump->line_width; k++)
+      snprintf(line_buff + strlen(line_buff), sizeof(line_buff) - strlen(line_buff), "0x%02X ", data[k]);
+    printf("%s\n", line_buff);
+  }
+
+  dump->addr += len;
+  return 0;
+}
+
 /// @brief Dump the contents of the entire memoree_t
-/// @param buff_size Size of chunks used to read data
-/// @param iter_delay_ms Millisecond delay between reading of data chunks
-/// @param line_width Number of bytes to print out in one line
-bool memdump(memoree_t mem, uint16_t buff_size, uint32_t iter_delay_ms, uint8_t line_width)
+/// @param chunk Size of chunks used to read data, or 0 to let memoree_dump_stream() pick the most efficient size
+/// @param line_width Number of bytes to print out in one line, a divisor of \a chunk
+bool memdump(memoree_t mem, uint32_t chunk, uint8_t line_width)
 {
   memoree_info_t memory;
   memoree_get_info(mem, &memory);
-  buff_size = (memory.size < buff_size) ? memory.size : buff_size;
 
-  uint8_t buff[buff_size];
-  int iterations = memory.size / buff_size;
   char line_buff[256];
-
   snprintf(line_buff, sizeof(line_buff), "        ");
   for (int header = 0; header < line_width; header++)
-    snprintf(line_buff + strlen(line_buff), sizeof(line_buff), "0x%02X ", header);
+    snprintf(line_buff + strlen(line_buff), sizeof(line_buff) - strlen(line_buff), "0x%02X ", header);
   printf("%s\n", line_buff);
 
-  for (int i = 0; i < iterations; i++)
+  // On I2C each chunk is read and then printed, only SPI reads the next chunk while the current one is being printed
+  memdump_ctx_t dump = {.addr = 0, .line_width = line_width};
+  int ret = memoree_dump_stream(mem, 0, memory.size, memdump_sink, &dump, chunk);
+  if (ret < 0)
   {
-    int bytes_read = memoree_read(mem, i * buff_size, buff, buff_size, buff_size * (memory.speed / 8000));
-    if (bytes_read > 0)
-    {
-      for (int j = 0; j < (buff_size / line_width); j++)
-      {
-        snprintf(line_buff, sizeof(line_buff), "0x%04X: ", (i * buff_size) + (j * line_width));
-        for (int k = 0; k < line_width; k++)
-          snprintf(line_buff + strlen(line_buff), sizeof(line_buff), "0x%02X ", buff[j]);
-        printf("%s\n", line_buff);
-      }
-    }
-    else
-    {
-      printf("Memory read at 0x%04X: failed\n", i);
-      return false;
-    }
+    printf("Memory read at 0x%04lX: failed\n", dump.addr);
+    return false;
   }
   printf("\n!!!!!Memory dumped :%ld bytes!!!!!\n", memory.size);
 
@@ -128,7 +137,7 @@ void app_main(void)
       vTaskDelay(pdMS_TO_TICKS(1000));
   }
 
-  // memdump(mem, 1024, 1, 16);
+  // memdump(mem, 1024, 16);
 
   // vTaskDelay(pdMS_TO_TICKS(1000));
 
@@ -143,7 +152,7 @@ void app_main(void)
 
   vTaskDelay(pdMS_TO_TICKS(1000));
 
-  memdump(mem, 1024, 1, 16);
+  memdump(mem, 1024, 16);
 
   memoree_deinit(mem, true);
 }
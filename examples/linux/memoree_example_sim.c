@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memoree.h"
+#include "memoree_sim.h"
+#include "memoree_platform.h"
+
+/// Build on any Linux host against the simulated platform with
+///   gcc -I. -Iplatform memoree.c platform/memoree_sim.c examples/linux/memoree_example_sim.c -o memoree_sim -pthread
+
+#define SIM_I2C_PORT 0
+#define SIM_SPI_PORT 1
+#define SIM_93CXX_CS 0
+#define SIM_25XX_CS 1
+
+/// @brief Print the virtual time taken since \a start and the resulting throughput
+static void report(const char *op, uint32_t bytes, uint64_t start_us, bool ok)
+{
+  uint64_t elapsed_us = memoree_sim_time_us() - start_us;
+  printf("  %-6s %8lu bytes in %10.3f ms  %10.1f KB/s  %s\n", op, (unsigned long)bytes, elapsed_us / 1000.0,
+         elapsed_us ? (bytes * 1000000.0 / 1024) / elapsed_us : 0, ok ? "" : "FAILED");
+}
+
+/// @brief Time a full-chip write, read back and erase of \a mem
+static bool bench(const char *name, memoree_t mem, int chip)
+{
+  memoree_info_t info;
+  if (!mem || memoree_get_info(mem, &info) != MEMOREE_ERR_OK)
+  {
+    printf("%s: init failed\n", name);
+    return false;
+  }
+
+  uint8_t *image = malloc(info.size);
+  uint8_t *readback = malloc(info.size);
+  if (!image || !readback)
+  {
+    free(image);
+    free(readback);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < info.size; i++)
+    image[i] = rand();
+
+  printf("%s: %lu bytes, %u byte pages @ %lu Hz\n", name, (unsigned long)info.size, info.page_size, (unsigned long)info.speed);
+  memoree_reset_stats(mem);
+
+  uint64_t start = memoree_sim_time_us();
+  bool ok = memoree_write(mem, 0, image, info.size, 100, false) == (int)info.size &&
+            !memcmp(memoree_sim_data(chip), image, info.size);
+  report("write", info.size, start, ok);
+
+  start = memoree_sim_time_us();
+  ok = memoree_read(mem, 0, readback, info.size, 1000) == (int)info.size && !memcmp(readback, image, info.size);
+  report("read", info.size, start, ok);
+
+  start = memoree_sim_time_us();
+  ok = memoree_erase(mem, 0xFF) == MEMOREE_ERR_OK;
+  for (uint32_t i = 0; ok && i < info.size; i++)
+    ok = memoree_sim_data(chip)[i] == 0xFF;
+  report("erase", info.size, start, ok);
+
+  // Where the time went: clocking data over the bus, or waiting for the chip's write and erase cycles
+  memoree_stats_t stats;
+  if (memoree_get_stats(mem, &stats) == MEMOREE_ERR_OK)
+    printf("  %lu transactions, %.3f ms on the bus, %.3f ms waiting for write and erase cycles, %lu busy polls\n",
+           (unsigned long)stats.transactions, stats.bus_us / 1000.0, stats.wait_us / 1000.0, (unsigned long)stats.polls);
+
+  free(image);
+  free(readback);
+  return ok;
+}
+
+/// @brief Rewrite the whole of \a mem asynchronously while the application keeps doing 1 ms of other work per iteration
+static bool bench_async(const char *name, memoree_t mem, int chip)
+{
+  memoree_info_t info;
+  if (!mem || memoree_get_info(mem, &info) != MEMOREE_ERR_OK)
+    return false;
+
+  uint8_t *image = malloc(info.size);
+  if (!image)
+    return false;
+
+  for (uint32_t i = 0; i < info.size; i++)
+    image[i] = rand();
+
+  uint64_t start = memoree_sim_time_us();
+  uint32_t samples = 0;
+  memoree_job_t job = memoree_write_async(mem, 0, image, info.size, NULL, NULL);
+  int ret = job ? MEMOREE_ERR_IN_PROGRESS : MEMOREE_ERR_FAIL;
+
+  while (ret == MEMOREE_ERR_IN_PROGRESS)
+  {
+    // Stands in for e.g. sampling a sensor between bus transfers
+    platform_ms_delay(1);
+    samples++;
+    ret = memoree_job_poll(job);
+  }
+
+  bool ok = ret == (int)info.size && !memcmp(memoree_sim_data(chip), image, info.size);
+  printf("%s: asynchronous write with %lu other tasks run meanwhile\n", name, (unsigned long)samples);
+  report("write", info.size, start, ok);
+
+  if (job)
+    memoree_job_free(job);
+  free(image);
+  return ok;
+}
+
+int main(void)
+{
+  memoree_sim_conf_t eeprom_24xx = {
+      .chip = MEMOREE_SIM_CHIP_24XX,
+      .port = SIM_I2C_PORT,
+      .addr = 0x50,
+      .size = 32768,
+      .page_size = 64,
+      .addr_len = 16,
+      .write_time_us = 2000,
+  };
+
+  memoree_sim_conf_t eeprom_93cxx = {
+      .chip = MEMOREE_SIM_CHIP_93CXX,
+      .port = SIM_SPI_PORT,
+      .cs_pin = SIM_93CXX_CS,
+      .size = 128,
+      .page_size = 1,
+      .addr_len = 7,
+      .write_time_us = 2000,
+      .erase_time_us = 2000,
+      .chip_erase_time_us = 6000,
+  };
+
+  memoree_sim_conf_t flash_25xx = {
+      .chip = MEMOREE_SIM_CHIP_25XX,
+      .port = SIM_SPI_PORT,
+      .cs_pin = SIM_25XX_CS,
+      .size = 2 * 1024 * 1024,
+      .page_size = 256,
+      .write_time_us = 700,
+      .erase_time_us = 45000,
+      .block_erase_time_us = 150000,
+      .chip_erase_time_us = 5000000,
+  };
+
+  int chip_24xx = memoree_sim_add(&eeprom_24xx);
+  int chip_93cxx = memoree_sim_add(&eeprom_93cxx);
+  int chip_25xx = memoree_sim_add(&flash_25xx);
+
+  memoree_i2c_conf_t i2c_conf = {
+      .port = SIM_I2C_PORT,
+      .addr = 0x50,
+      .speed = 400000,
+  };
+
+  // Both SPI chips are attached to one bus, each with its own chip select and clock speed
+  memoree_spi_conf_t spi_bus_conf = {
+      .port = SIM_SPI_PORT,
+  };
+  memoree_bus_t spi_bus = memoree_bus_init(MEMOREE_TYPE_SPI, &spi_bus_conf);
+
+  memoree_spi_conf_t spi_93cxx_conf = {
+      .cs_pin = SIM_93CXX_CS,
+      .speed = 2000000,
+      .bus = spi_bus,
+  };
+
+  memoree_spi_conf_t spi_25xx_conf = {
+      .cs_pin = SIM_25XX_CS,
+      .speed = 40000000,
+      .bus = spi_bus,
+  };
+
+  memoree_t mem_24xx = memoree_init(MEMOREE_VARIANT_24XX256, &i2c_conf);
+  memoree_t mem_93cxx = memoree_init(MEMOREE_VARIANT_93C46, &spi_93cxx_conf);
+  memoree_t mem_25xx = memoree_init(MEMOREE_VARIANT_25XX_SFDP, &spi_25xx_conf);
+
+  bool ok = bench("24XX256", mem_24xx, chip_24xx);
+  ok &= bench("93C46", mem_93cxx, chip_93cxx);
+  ok &= bench("25XX", mem_25xx, chip_25xx);
+  ok &= bench_async("24XX256", mem_24xx, chip_24xx);
+
+  if (mem_24xx)
+    memoree_deinit(mem_24xx, true);
+  if (mem_93cxx)
+    memoree_deinit(mem_93cxx, true);
+  if (mem_25xx)
+    memoree_deinit(mem_25xx, true);
+  if (spi_bus)
+    memoree_bus_deinit(spi_bus);
+  memoree_sim_reset();
+
+  return ok ? 0 : 1;
+}
@@ -1,18 +1,57 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "memoree.h"
 #include "platform/memoree_platform.h"
 
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#elif defined(__SSE4_2__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#if !defined(__ARM_FEATURE_CRC32)
+#include "memoree_crc_tables.h"
+#endif
+
 #define VARIANT_ISSTUB(v) (v == MEMOREE_VARIANT_STUB_I2C || v == MEMOREE_VARIANT_STUB_SPI)
 #define VARIANT_ISVALID(v) (v < MEMOREE_VARIANT_MAX && v != MEMOREE_VARIANT_I2C_MAX && v != MEMOREE_VARIANT_93CXX_MAX && v != MEMOREE_VARIANT_STUB_SPI && v != MEMOREE_VARIANT_STUB_I2C)
 #define MEMOREE_ISVALID(m) (m && m->interface && VARIANT_ISVALID(m->info.variant))
 #define ADDRESS_ISVALID(m, a) (m && (a < m->info.size))
 #define PAGE_ISVALID(m, p) (m && (p < m->info.num_pages))
 
-#define MEMOREE_DEFAULT_TIMEOUT(m, s) (s / (m->info.speed / 8000))
+#define CACHE_WRITEBACK(m) (m->cache && m->cache->page_cnt)
+#define CACHE_READ(m) (m->cache && m->cache->line_cnt)
+
+#define MEMOREE_DEFAULT_TIMEOUT(m, s) (s / (m->info.speed / 8000) + 1)
+
+#if MEMOREE_STATS
+#define MEMOREE_STATS_NOW() platform_get_time_us()
+#define MEMOREE_STATS_ADD(m, field, n) ((m)->stats.field += (n))
+#else
+#define MEMOREE_STATS_NOW() 0
+#define MEMOREE_STATS_ADD(m, field, n) ((void)(m), (void)(n))
+#endif
+
+#define MEMOREE_93CXX_ERAL_MAX_MS 15          ///< Maximum ERAL and WRAL cycle time of 93CXX parts
+
+#define MEMOREE_25XX_SR_WIP 0x01             ///< Write-In-Progress bit of the 25XX status register
+#define MEMOREE_25XX_PP_MAX_US 5000          ///< Page program time assumed when the SFDP table does not specify one
+#define MEMOREE_25XX_ERASE4K_MAX_MS 400      ///< 4 KB erase time assumed when the SFDP table does not specify one
+#define MEMOREE_25XX_BLOCK_ERASE_MAX_MS 2000 ///< 32 KB and 64 KB block erase time assumed when the SFDP table does not specify one
+#define MEMOREE_25XX_CHIP_ERASE_MAX_MS 400000 ///< Chip erase time assumed when the SFDP table does not specify one
+
+#define MEMOREE_JOB_I2C_CHUNK 256 ///< Bytes read per memoree_job_poll() call on I2C devices, which transfer synchronously
+#define MEMOREE_JOB_DRAIN_MS 1000  ///< Time memoree_job_free() waits for a queued transfer of an unfinished job
+
+#define MEMOREE_VOLUME_BATCH 64 ///< Member writes memoree_volume_write() schedules at once
+
+#define MEMOREE_STREAM_MIN_BUFF 64 ///< Smallest buffer memoree_program_stream() pulls from its source at once
+#define MEMOREE_PIPELINE_CHUNK 1024 ///< Bytes read per chunk by memoree_verify() and memoree_checksum(), two chunks are buffered
+#define MEMOREE_DUMP_MAX_CHUNK 4096 ///< Largest chunk memoree_dump_stream() picks by itself when none is given
 
 /// @brief Generic configuration parameter used to extract common peripheral settings
 typedef struct
@@ -163,354 +202,964 @@ memoree_info_t mem_props[] = {
     },
 };
 
+/// @brief Read instruction used for the memory array of a 25XX part
+typedef struct
+{
+  uint8_t opcode;       ///< Instruction
+  uint8_t addr_lines;   ///< Lines used in the address, mode and dummy phases
+  uint8_t data_lines;   ///< Lines used in the data phase
+  uint8_t mode_clocks;  ///< Mode bit clocks following the address, always sent as zeros
+  uint8_t dummy_cycles; ///< Wait state clocks following the mode bits
+} memoree_read_cmd_t;
+
+/// @brief Page held by the write-back cache
+typedef struct
+{
+  bool dirty;        ///< Whether the slot holds a page that has not been written back yet
+  uint32_t page;     ///< Page number
+  uint64_t dirty_us; ///< Time the page was first modified since it was last written back
+  uint8_t *data;     ///< Full contents of the page
+} memoree_cache_page_t;
+
+/// @brief Line held by the read cache
+typedef struct
+{
+  bool valid;        ///< Whether the slot holds a line
+  bool prefetched;   ///< Whether the line was read ahead and has not been used since
+  uint32_t line;     ///< Line number, i.e. the address of its first byte divided by the line size
+  uint32_t last_use; ///< Value of the cache's use counter when the line was last read
+  uint8_t *data;     ///< Contents of the line
+} memoree_cache_line_t;
+
+/// @brief Write-back and read cache state
+typedef struct
+{
+  uint16_t page_cnt;           ///< Number of slots in \a pages, 0 if there is no write-back cache
+  uint64_t flush_after_us;     ///< Age after which dirty pages are written back, 0 for no deadline
+  memoree_cache_page_t *pages; ///< Page slots
+  uint16_t line_cnt;           ///< Number of slots in \a lines, 0 if there is no read cache
+  uint16_t line_size;          ///< Size of a line in bytes
+  uint8_t prefetch;            ///< Lines read ahead of a sequential reader
+  memoree_cache_line_t *lines; ///< Line slots
+  uint8_t *fill_buff;          ///< Buffer a line and the lines prefetched with it are read into
+  uint32_t use_cnt;            ///< Incremented on every line access to order lines by recent use
+  uint32_t next_addr;          ///< Address following the last cached read, where a sequential reader continues
+  memoree_cache_stats_t stats;
+} memoree_cache_t;
+
+/// @brief Peripheral shared by the memory chips attached to it, see memoree_bus_init()
+struct memoree_bus
+{
+  memoree_type_t type;
+  int port;
+  uint32_t speed;                ///< Bus speed in Hz (I2C only, SPI speeds are set per device)
+  memoree_interface_t interface; ///< Platform bus handle returned by platform_i2c_bus_init() or platform_spi_bus_init()
+  uint32_t refs;                 ///< References held by memoree_bus_init() callers and attached memory chips
+  memoree_mutex_t lock;          ///< Held for the duration of each bus transaction
+  memoree_bus_t next;            ///< Next initialized bus
+#if MEMOREE_STATS
+  memoree_t active;              ///< Chip whose transaction is in progress, charged with the retries of the platform
+#endif
+};
+
+/// @brief Buses initialized so far, looked up by type and port so that each peripheral is only initialized once
+static memoree_bus_t memoree_buses;
+
 /// @brief Holds the properties of the memory chip such as size and address length, as well as a handle to the peripheral interface it is connected to
 struct memoree
 {
   memoree_interface_t interface;
+  memoree_bus_t bus;           ///< Bus the interface is attached to
+  memoree_mutex_t lock;        ///< Held for the duration of every call on the chip, including its write and erase cycles
   memoree_info_t info;
+  sfdp_param_t sfdp;           ///< Parameters read by the last successful memoree_get_sfdp() (25XX only)
+  memoree_read_cmd_t read_cmd; ///< Fastest read instruction supported by both the part and the interface (25XX only)
+  memoree_cache_t *cache;      ///< Write-back cache attached with memoree_cache_attach(), or NULL
+#if MEMOREE_STATS
+  memoree_stats_t stats;
+  uint64_t queued_us;          ///< Time at which the queued transfer in flight was started
+#endif
+};
+
+/// @brief Operations that can be run asynchronously
+typedef enum
+{
+  MEMOREE_JOB_READ,
+  MEMOREE_JOB_WRITE,
+  MEMOREE_JOB_ERASE,
+} memoree_job_op_t;
+
+/// @brief Progress of an asynchronous operation
+typedef enum
+{
+  MEMOREE_JOB_START,   ///< Ready to start the next transfer
+  MEMOREE_JOB_PENDING, ///< Waiting for a transfer queued with platform_spi_queue()
+  MEMOREE_JOB_WAIT,    ///< Waiting for the write or erase cycle started by the last transfer
+  MEMOREE_JOB_DONE,    ///< Finished, \a result holds the outcome
+} memoree_job_state_t;
+
+/// @brief State of an asynchronous read, write or erase, advanced one bus transfer at a time by memoree_job_poll()
+struct memoree_job
+{
+  memoree_t mem;
+  memoree_job_op_t op;
+  memoree_job_state_t state;
+  uint32_t addr;               ///< Start address of the operation
+  uint8_t *data;               ///< Caller's buffer for reads and writes, page of erase values for EEPROM erases
+  uint32_t len;                ///< Length of the operation in bytes
+  uint32_t done;               ///< Bytes completed so far
+  uint32_t chunk;              ///< Bytes covered by the transfer or cycle in progress
+  uint64_t ready_us;           ///< Time before which the device is not polled for the end of the cycle
+  uint64_t deadline_us;        ///< Time after which the cycle is considered to have failed
+  uint32_t poll_interval_ms;   ///< Interval between polls of the device in memoree_job_wait()
+  uint64_t start_us;           ///< Time at which the job was created
+  uint64_t cycle_us;           ///< Time at which the write or erase cycle in progress was started
+  memoree_spi_transaction_t t; ///< Transaction queued with platform_spi_queue(), which must outlive the call
+  uint8_t *readback;           ///< Page buffer each written page is read back into once its cycle completes, or NULL
+  int result;                  ///< Final result, valid once done
+  memoree_job_cb_t cb;
+  void *cb_arg;
+};
+
+struct memoree_volume
+{
+  memoree_volume_info_t info;
+  memoree_mutex_t lock; ///< Held while a mirrored volume picks the replica of a read
+  size_t next_replica;  ///< Member of a mirrored volume the next read tries first
+  struct
+  {
+    memoree_t mem;
+    uint32_t base; ///< Volume address of the first byte of a concatenated member
+    uint32_t size; ///< Size of the member in bytes
+  } members[];
 };
 
 //////////////////////UTILITY FUNCTIONS
 
-/// @brief Returns the number of bits required to address the entire memory array
-/// @return Number of bits, on success
-/// @return \link memoree_err_t \endlink error code, on fail
-static int _get_address_space(memoree_t mem)
+/// The bus of a chip is only locked for each transaction, so that chips sharing it are not held up by each other's
+/// write and erase cycles. Multi-transaction sequences are kept together by the chip's own lock instead.
+
+/// @brief Acquire the bus of \a mem for a transaction
+/// @return Time at which the transaction started
+static uint64_t _memoree_txn_begin(memoree_t mem)
 {
-  if (!mem || !(mem->info.size) || mem->info.size % 2)
-    return MEMOREE_ERR_INVALID_ARG;
+  platform_mutex_lock(mem->bus->lock);
+#if MEMOREE_STATS
+  mem->bus->active = mem;
+#endif
+  return MEMOREE_STATS_NOW();
+}
 
-  uint32_t size = mem->info.size - 1;
-  int bit_width = 0;
-  while ((size >> bit_width++) & 1);
+/// @brief Count the transaction started at \a start_us that ended with \a ret, and release the bus
+/// @param poll The transaction polled the device, which fails or times out while the device is busy. Polls are part of
+///             the wait for a cycle, and are counted there instead.
+static void _memoree_txn_end(memoree_t mem, uint64_t start_us, int ret, bool poll)
+{
+#if MEMOREE_STATS
+  mem->bus->active = NULL;
+  if (!poll)
+  {
+    mem->stats.transactions++;
+    mem->stats.bus_us += platform_get_time_us() - start_us;
+    if (ret == MEMOREE_ERR_TIMEOUT)
+      mem->stats.timeouts++;
+    else if (ret < 0)
+      mem->stats.errors++;
+  }
+#endif
+  platform_mutex_unlock(mem->bus->lock);
+}
 
-  return bit_width;
+static memoree_err_t _memoree_spi_transfer(memoree_t mem, memoree_spi_transaction_t *t)
+{
+  uint64_t start = _memoree_txn_begin(mem);
+  memoree_err_t ret = platform_spi_write_read(mem->interface, t);
+  _memoree_txn_end(mem, start, ret, false);
+  return ret;
 }
 
-/// @brief Sends \a addr in the address phase of communicaton followed by a stream of \a data_len bytes
-/// @note This fuction does not perform any address translation of pages nor does it split data into chunks before sending.
-/// @return Number of bytes written, on success
-/// @return \link memoree_err_t \endlink error code, on failure
-static int _memoree_write_bytes(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
+/// @brief Transfer \a t as a ready poll, which is counted as part of the wait for a cycle
+static memoree_err_t _memoree_spi_poll(memoree_t mem, memoree_spi_transaction_t *t)
 {
-  if (!ADDRESS_ISVALID(mem, addr) || !data)
-    return MEMOREE_ERR_INVALID_ARG;
+  uint64_t start = _memoree_txn_begin(mem);
+  memoree_err_t ret = platform_spi_write_read(mem->interface, t);
+  _memoree_txn_end(mem, start, ret, true);
+  return ret;
+}
 
-  if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
-  {
-    uint8_t write_buffer[data_len + (mem->info.addr_len / 8)];
-    uint8_t *write_p = write_buffer;
-    int8_t addr_space = _get_address_space(mem);
-    if (addr_space <= 0)
-      return MEMOREE_ERR_INVALID_ARG;
+static memoree_err_t _memoree_spi_wait_ready(memoree_t mem, uint32_t timeout_ms)
+{
+  uint64_t start = _memoree_txn_begin(mem);
+  memoree_err_t ret = platform_spi_wait_ready(mem->interface, timeout_ms);
+  _memoree_txn_end(mem, start, ret, true);
+  return ret;
+}
 
-    uint8_t i2c_address;
+/// @brief Queue \a t with platform_spi_queue(), keeping the bus locked until _memoree_spi_queue_result() reports
+///        that the transfer has completed
+static memoree_err_t _memoree_spi_queue(memoree_t mem, memoree_spi_transaction_t *t)
+{
+  uint64_t start = _memoree_txn_begin(mem);
+  memoree_err_t ret = platform_spi_queue(mem->interface, t);
+  if (ret != MEMOREE_ERR_OK)
+    _memoree_txn_end(mem, start, ret, false);
+#if MEMOREE_STATS
+  mem->queued_us = start;
+#endif
+  return ret;
+}
 
-    // Pack the MSB of the address into byte 3:1 of the I2C target address
-    if (addr_space <= mem->info.addr_len)
-      i2c_address = mem->info.addr;
-    else
-      i2c_address = mem->info.addr | (((addr >> mem->info.addr_len) << 1) & 0x0F);
+static memoree_err_t _memoree_spi_queue_result(memoree_t mem, uint32_t timeout_ms)
+{
+  memoree_err_t ret = platform_spi_queue_result(mem->interface, timeout_ms);
+#if MEMOREE_STATS
+  if (ret != MEMOREE_ERR_TIMEOUT)
+    _memoree_txn_end(mem, mem->queued_us, ret, false);
+#else
+  if (ret != MEMOREE_ERR_TIMEOUT)
+    _memoree_txn_end(mem, 0, ret, false);
+#endif
+  return ret;
+}
 
-    int i = mem->info.addr_len;
+static int32_t _memoree_i2c_writev(memoree_t mem, uint8_t addr, const memoree_iovec_t *segs, size_t seg_cnt, size_t timeout_ms)
+{
+  uint64_t start = _memoree_txn_begin(mem);
+  int32_t ret = platform_i2c_writev(mem->interface, addr, segs, seg_cnt, timeout_ms);
+  _memoree_txn_end(mem, start, ret, false);
+  return ret;
+}
 
-    // Prepend the address bytes to the data buffer
-    do
-    {
-      i -= 8;
-      *write_p++ = addr >> i;
-    } while (i);
-    memcpy(write_p, data, data_len);
+static memoree_err_t _memoree_i2c_write_read(memoree_t mem, uint8_t addr, uint8_t *write_buff, size_t write_size,
+                                             uint8_t *read_buff, size_t read_size, size_t timeout_ms)
+{
+  uint64_t start = _memoree_txn_begin(mem);
+  memoree_err_t ret = platform_i2c_write_read(mem->interface, addr, write_buff, write_size, read_buff, read_size, timeout_ms);
+  _memoree_txn_end(mem, start, ret, false);
+  return ret;
+}
 
-    int ret = platform_i2c_write(mem->interface, i2c_address, write_buffer, sizeof(write_buffer), timeout_ms);
-    return (ret > 0) ? ret - (mem->info.addr_len / 8) : ret;
-  }
-  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
-  {
-    memoree_spi_transaction_t t;
-    memset(&t, 0, sizeof(t));
+static memoree_err_t _memoree_i2c_ping(memoree_t mem, uint32_t timeout_ms)
+{
+  uint64_t start = _memoree_txn_begin(mem);
+  memoree_err_t ret = platform_i2c_ping(mem->interface, mem->info.addr, timeout_ms);
+  _memoree_txn_end(mem, start, ret, true);
+  return ret;
+}
 
-    t.cmd_len = 8;
-    t.cmd = MEMOREE_CMD_25XX_PP;
-    t.addr_len = mem->info.addr_len;
-    t.addr = (addr & (mem->info.size - 1));
-    t.write_len = data_len;
-    t.write_buff = data;
-    t.timeout_ms = timeout_ms ? timeout_ms : 0;
+/// @brief Sleep for \a ms while waiting for a cycle of \a mem
+static void _memoree_sleep(memoree_t mem, uint32_t ms)
+{
+  uint64_t start = MEMOREE_STATS_NOW();
+  platform_ms_delay(ms);
+  MEMOREE_STATS_ADD(mem, sleep_us, MEMOREE_STATS_NOW() - start);
+}
 
-    int ret = platform_spi_write_read(mem->interface, &t);
-    return (ret == 0) ? data_len : MEMOREE_ERR_FAIL;
+/// @brief Count an operation of type \a op on \a mem that started at \a start_us and read or wrote \a bytes
+static void _memoree_stats_op(memoree_t mem, memoree_stats_op_t op, uint64_t start_us, int bytes)
+{
+#if MEMOREE_STATS
+  uint64_t us = platform_get_time_us() - start_us;
+  uint8_t bucket = 0;
+  while ((us >>= 1) && bucket < MEMOREE_STATS_BUCKETS - 1)
+    bucket++;
+
+  mem->stats.ops[op]++;
+  mem->stats.latency[op][bucket]++;
+  if (op == MEMOREE_STATS_OP_READ && bytes > 0)
+    mem->stats.bytes_read += bytes;
+  else if (op == MEMOREE_STATS_OP_WRITE && bytes > 0)
+    mem->stats.bytes_written += bytes;
+#else
+  (void)mem, (void)op, (void)start_us, (void)bytes;
+#endif
+}
+
+/// @brief Returns the 7-bit I2C address selecting the block that holds \a addr, for 24XX parts larger than their
+///        address phase whose high address bits are carried in the low bits of the device address
+/// @param block_size Set to the size of the blocks within which the internal address counter rolls over
+static uint8_t _memoree_i2c_address(memoree_t mem, uint32_t addr, uint32_t *block_size)
+{
+  uint32_t addr_space = 1UL << mem->info.addr_len;
+  if (mem->info.size <= addr_space)
+  {
+    *block_size = mem->info.size;
+    return mem->info.addr;
   }
-  else
-    return MEMOREE_ERR_INVALID_ARG;
 
-  return MEMOREE_ERR_FAIL;
+  uint8_t block_mask = (mem->info.size / addr_space) - 1;
+  *block_size = addr_space;
+  return (mem->info.addr & ~block_mask) | ((addr >> mem->info.addr_len) & block_mask);
 }
 
-/// @brief Send a write enable command to an SPI memory device
-static memoree_err_t _memoree_spi_write_enable(memoree_t mem)
+/// @brief Returns the little-endian double word number \a n (counting from 1, as in JESD216) of an SFDP parameter table
+static uint32_t _sfdp_dword(const uint8_t *table, uint8_t n)
 {
-  if (!MEMOREE_ISVALID(mem))
-    return MEMOREE_ERR_INVALID_ARG;
+  const uint8_t *p = &table[(n - 1) * 4];
+  return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
 
-  memoree_spi_transaction_t t;
-  memset(&t, 0, sizeof(t));
+/// @brief Decodes a 16-bit fast read descriptor of the SFDP basic flash parameter table into \a read if \a supported
+static void _sfdp_read_mode(sfdp_read_t *read, bool supported, uint16_t field)
+{
+  if (!supported)
+    return;
 
-  if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
-    return MEMOREE_ERR_INVALID_ARG;
-  else if (mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  read->dummy_cycles = field & 0x1F;
+  read->mode_clocks = (field >> 5) & 0b111;
+  read->opcode = field >> 8;
+}
+
+/// @brief Picks the fastest read instruction advertised in \a mem's SFDP table that its interface can clock out
+/// @note Quad modes are only used when the interface has IO2 and IO3 wired. The Quad Enable bit of parts that require one
+///       must already be set in the status register.
+static void _memoree_select_read(memoree_t mem)
+{
+  const struct
   {
-    t.cmd_len = 5;
-    t.cmd = MEMOREE_CMD_93CXX_WEN;
-    t.addr_len = 5;
+    const sfdp_read_t *read;
+    uint8_t addr_lines;
+    uint8_t data_lines;
+  } modes[] = {
+      {&mem->sfdp.read_144, 4, 4},
+      {&mem->sfdp.read_114, 1, 4},
+      {&mem->sfdp.read_122, 2, 2},
+      {&mem->sfdp.read_112, 1, 2},
+  };
 
-    int8_t ret = platform_spi_write_read(mem->interface, &t);
-    if (ret == 0)
-      return MEMOREE_ERR_OK;
-  }
-  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  uint8_t max_lines = ((memoree_spi_if_t *)mem->interface)->max_lines;
+
+  mem->read_cmd = (memoree_read_cmd_t){
+      .opcode = MEMOREE_CMD_25XX_FAST_READ,
+      .addr_lines = 1,
+      .data_lines = 1,
+      .dummy_cycles = 8,
+  };
+
+  for (uint8_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
   {
-    t.cmd = MEMOREE_CMD_25XX_WREN;
-    t.cmd_len = 8;
-    int ret = platform_spi_write_read(mem->interface, &t);
-    if (ret == 0)
-      return MEMOREE_ERR_OK;
+    const sfdp_read_t *read = modes[i].read;
+
+    // Mode bits are appended to the address, which has to fit the transaction's address field
+    if (!read->opcode || modes[i].data_lines > max_lines ||
+        mem->info.addr_len + read->mode_clocks * modes[i].addr_lines > 32)
+      continue;
+
+    mem->read_cmd = (memoree_read_cmd_t){
+        .opcode = read->opcode,
+        .addr_lines = modes[i].addr_lines,
+        .data_lines = modes[i].data_lines,
+        .mode_clocks = read->mode_clocks,
+        .dummy_cycles = read->dummy_cycles,
+    };
+    return;
   }
-
-  return MEMOREE_ERR_FAIL;
 }
 
-//////////////////////PUBLIC FUNCTIONS
-
-memoree_t memoree_init(memoree_variant_t variant, void *interface_conf)
+/// @brief Decodes a 7-bit erase time field of BFPT DWORD 10 in milliseconds
+static uint32_t _sfdp_erase_time_ms(uint8_t field)
 {
-  if (!interface_conf)
-    return NULL;
+  static const uint32_t erase_units_ms[4] = {1, 16, 128, 1000};
+  return ((field & 0x1F) + 1) * erase_units_ms[(field >> 5) & 0b11];
+}
 
-  if (!VARIANT_ISSTUB(variant))
-    if (!VARIANT_ISVALID(variant))
-      return NULL;
+/// @brief Decodes the \a dwords double words of a basic flash parameter table into \a param
+/// @note Fields added by later revisions of JESD216 are only decoded if the table is long enough to contain them
+static memoree_err_t _sfdp_parse_bfpt(sfdp_param_t *param, const uint8_t *table, uint16_t dwords)
+{
+  uint32_t dword1 = _sfdp_dword(table, 1);
+  uint32_t dword2 = _sfdp_dword(table, 2);
 
-  memoree_interface_t interface = NULL;
-  uint32_t speed = ((memoree_periph_conf_t *)interface_conf)->speed;
+  param->write_size = ((dword1 >> 2) & 0b1) ? 64 : 1;
+  param->wen_opcode = ((dword1 >> 4) & 0b1) ? MEMOREE_CMD_25XX_WREN : MEMOREE_CMD_25XX_EWSR;
+  param->erase4k_opcode = (dword1 & 0b11) == 0b11 ? 0 : (dword1 >> 8) & 0xFF;
+  param->dtr_support = (dword1 >> 19) & 0b1;
 
-  if (variant < MEMOREE_VARIANT_I2C_MAX)
+  // Parts supporting both address modes start up in 3-byte mode
+  switch ((dword1 >> 17) & 0b11)
   {
-    speed = (speed > MEMOREE_I2C_MAX_SPEED) ? MEMOREE_I2C_MAX_SPEED : speed;
-    ((memoree_i2c_conf_t *)interface_conf)->speed = speed;
-
-    interface = platform_i2c_init((memoree_i2c_conf_t *)interface_conf);
-    if (!interface)
-      return NULL;
+  case 0b00:
+  case 0b01:
+    param->addr_bytes = 3;
+    break;
+  case 0b10:
+    param->addr_bytes = 4;
+    break;
+  default:
+    return MEMOREE_ERR_SFDP_INVALID_TABLE;
   }
+
+  // Density is given in bits, either as N - 1 or as 2^N above 2 Gigabits
+  uint32_t density = dword2 & 0x7FFFFFFF;
+  if ((dword2 >> 31) & 0b1)
+    param->size = (density >= 3 && density < 64) ? (1ULL << density) >> 3 : 0;
   else
+    param->size = ((uint64_t)density + 1) >> 3;
+
+  if (!param->size)
+    return MEMOREE_ERR_SFDP_INVALID_TABLE;
+
+  param->page_size = 256;
+
+  if (param->erase4k_opcode)
   {
-    if (variant == MEMOREE_VARIANT_25XX_SFDP || variant == MEMOREE_VARIANT_STUB_SPI)
-      speed = (speed > MEMOREE_SPI_MAX_SPEED) ? MEMOREE_SPI_MAX_SPEED : speed;
-    else if (variant < MEMOREE_VARIANT_93CXX_MAX)
-      speed = (speed > MEMOREE_SPI_93X_MAX_SPEED) ? MEMOREE_SPI_93X_MAX_SPEED : speed;
+    param->min_sector = param->max_sector = 4096;
+    param->min_sec_opcode = param->max_sec_opcode = param->erase4k_opcode;
+  }
 
-    ((memoree_spi_conf_t *)interface_conf)->speed = speed;
+  // Anything shorter than the 9 DWORDs of the original JESD216 table only describes the density
+  if (dwords < 9)
+    return MEMOREE_ERR_OK;
+
+  uint32_t dword3 = _sfdp_dword(table, 3);
+  uint32_t dword4 = _sfdp_dword(table, 4);
+  uint32_t dword5 = _sfdp_dword(table, 5);
+  _sfdp_read_mode(&param->read_112, (dword1 >> 16) & 0b1, dword4 & 0xFFFF);
+  _sfdp_read_mode(&param->read_122, (dword1 >> 20) & 0b1, dword4 >> 16);
+  _sfdp_read_mode(&param->read_144, (dword1 >> 21) & 0b1, dword3 & 0xFFFF);
+  _sfdp_read_mode(&param->read_114, (dword1 >> 22) & 0b1, dword3 >> 16);
+  _sfdp_read_mode(&param->read_222, dword5 & 0b1, _sfdp_dword(table, 6) >> 16);
+  _sfdp_read_mode(&param->read_444, (dword5 >> 4) & 0b1, _sfdp_dword(table, 7) >> 16);
+
+  for (uint8_t i = 0; i < MEMOREE_SFDP_ERASE_TYPES; i++)
+  {
+    const uint8_t *type = &table[7 * 4 + i * 2];
+    if (!type[0] || type[0] > 31)
+      continue;
 
-    interface = platform_spi_init((memoree_spi_conf_t *)interface_conf);
-    if (!interface)
-      return NULL;
+    param->erase[i].size = 1UL << type[0];
+    param->erase[i].opcode = type[1];
+
+    if (!param->min_sector || param->erase[i].size < param->min_sector)
+    {
+      param->min_sector = param->erase[i].size;
+      param->min_sec_opcode = type[1];
+    }
+
+    if (param->erase[i].size > param->max_sector)
+    {
+      param->max_sector = param->erase[i].size;
+      param->max_sec_opcode = type[1];
+    }
   }
 
-  memoree_t mem = malloc(sizeof(struct memoree));
-  if (!mem)
-    return NULL;
+  // Erase, page program and chip erase timing was added to the table in JESD216A (DWORDs 10 and 11)
+  if (dwords >= 11)
+  {
+    static const uint32_t chip_erase_units_ms[4] = {16, 256, 4000, 64000};
 
-  memcpy(&mem->info, &mem_props[variant], sizeof(memoree_info_t));
-  mem->interface = interface;
+    uint32_t dword10 = _sfdp_dword(table, 10);
+    uint32_t dword11 = _sfdp_dword(table, 11);
+    uint32_t erase_multiplier = 2 * ((dword10 & 0x0F) + 1);
+    uint32_t program_multiplier = 2 * ((dword11 & 0x0F) + 1);
 
-  if (mem->info.type == MEMOREE_TYPE_I2C)
-    mem->info.addr = ((memoree_i2c_conf_t *)interface_conf)->addr;
+    for (uint8_t i = 0; i < MEMOREE_SFDP_ERASE_TYPES; i++)
+    {
+      if (!param->erase[i].size)
+        continue;
 
-  if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+      param->erase[i].typ_ms = _sfdp_erase_time_ms(dword10 >> (4 + i * 7));
+      param->erase[i].max_ms = param->erase[i].typ_ms * erase_multiplier;
+
+      if (param->erase[i].size == 4096 && !param->erase4k_typ_ms)
+      {
+        param->erase4k_typ_ms = param->erase[i].typ_ms;
+        param->erase4k_max_ms = param->erase[i].max_ms;
+      }
+    }
+
+    param->page_size = 1 << ((dword11 >> 4) & 0x0F);
+
+    param->pp_typ_us = (((dword11 >> 8) & 0x1F) + 1) * (((dword11 >> 13) & 0b1) ? 64 : 8);
+    param->pp_max_us = param->pp_typ_us * program_multiplier;
+
+    param->chip_erase_typ_ms = (((dword11 >> 24) & 0x1F) + 1) * chip_erase_units_ms[(dword11 >> 29) & 0b11];
+    param->chip_erase_max_ms = param->chip_erase_typ_ms * program_multiplier;
+  }
+
+  // Suspend and resume instructions (DWORDs 12 and 13)
+  if (dwords >= 13)
   {
-    sfdp_param_t param;
+    uint32_t dword13 = _sfdp_dword(table, 13);
 
-    if (memoree_get_sfdp(mem, &param, 100) != MEMOREE_ERR_OK)
+    param->suspend_support = !((_sfdp_dword(table, 12) >> 31) & 0b1);
+    if (param->suspend_support)
     {
-      memoree_deinit(mem, false);
-      return NULL;
+      param->program_resume_opcode = dword13;
+      param->program_suspend_opcode = dword13 >> 8;
+      param->erase_resume_opcode = dword13 >> 16;
+      param->erase_suspend_opcode = dword13 >> 24;
     }
   }
 
-  if (!VARIANT_ISSTUB(mem->info.variant))
+  // Quad enable requirements and 4-byte address mode entry (DWORDs 15 and 16)
+  if (dwords >= 16)
   {
-    mem->info.speed = speed;
-    mem->info.num_pages = mem->info.size / mem->info.page_size;
-    mem->info.protected = false;
+    uint8_t qer = (_sfdp_dword(table, 15) >> 20) & 0b111;
+    param->qe = (qer <= MEMOREE_SFDP_QE_SR2_BIT1_WR31) ? (sfdp_qe_t)qer : MEMOREE_SFDP_QE_NONE;
+    param->addr4_enter = _sfdp_dword(table, 16) >> 24;
   }
-    
-  return mem;
+
+  // Octal reads were added in JESD216C (DWORD 17)
+  if (dwords >= 17)
+  {
+    uint32_t dword17 = _sfdp_dword(table, 17);
+    _sfdp_read_mode(&param->read_118, (dword17 >> 8) & 0xFF, dword17 & 0xFFFF);
+    _sfdp_read_mode(&param->read_188, (dword17 >> 24) & 0xFF, dword17 >> 16);
+  }
+
+  return MEMOREE_ERR_OK;
 }
 
-memoree_err_t memoree_deinit(memoree_t mem, bool if_deinit)
+/// @brief Fill \a t with the SPI transaction reading \a data_len bytes at \a addr of a 93CXX or 25XX device
+static memoree_err_t _memoree_read_transaction(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len,
+                                               size_t timeout_ms, memoree_spi_transaction_t *t)
 {
-  if (!mem || !mem->interface)
-    return MEMOREE_ERR_INVALID_ARG;
-
-  if (mem->info.variant != MEMOREE_VARIANT_STUB_I2C && mem->info.variant != MEMOREE_VARIANT_STUB_SPI)
-    if (!MEMOREE_ISVALID(mem))
-      return MEMOREE_ERR_INVALID_ARG;
+  memset(t, 0, sizeof(memoree_spi_transaction_t));
+  t->addr = addr & (mem->info.size - 1);
+  t->read_len = data_len;
+  t->read_buff = data;
+  t->timeout_ms = timeout_ms;
 
-  if (if_deinit)
+  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
   {
-    switch (mem->info.type)
-    {
-    case MEMOREE_TYPE_I2C:
-      if (platform_i2c_deinit(mem->interface) != 0)
-        return MEMOREE_ERR_FAIL;
-      break;
-    case MEMOREE_TYPE_SPI:
-      if (platform_spi_deinit(mem->interface) != 0)
-        return MEMOREE_ERR_FAIL;
-      break;
-    default:
-      return MEMOREE_ERR_INVALID_ARG;
-      break;
-    }
+    t->cmd_len = 3;
+    t->cmd = MEMOREE_CMD_93CXX_READ;
+    t->addr_len = mem->info.addr_len;
   }
-  free(mem);
-  mem = NULL;
+  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    const memoree_read_cmd_t *r = &mem->read_cmd;
+    uint8_t mode_bits = r->mode_clocks * r->addr_lines;
+
+    // Mode bits are sent as zeros, which keeps the part out of continuous read mode
+    t->cmd_len = 8;
+    t->cmd = r->opcode;
+    t->addr_len = mem->info.addr_len + mode_bits;
+    t->addr <<= mode_bits;
+    t->dummy_len = r->dummy_cycles;
+    t->addr_lines = r->addr_lines;
+    t->data_lines = r->data_lines;
+  }
+  else
+    return MEMOREE_ERR_INVALID_ARG;
+
   return MEMOREE_ERR_OK;
 }
 
-memoree_err_t memoree_ping(memoree_t mem, size_t timeout_ms)
+/// @brief Send a write enable command to an SPI memory device
+static memoree_err_t _memoree_spi_write_enable(memoree_t mem)
 {
   if (!MEMOREE_ISVALID(mem))
     return MEMOREE_ERR_INVALID_ARG;
 
+  memoree_spi_transaction_t t;
+  memset(&t, 0, sizeof(t));
+
   if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
-    return (platform_i2c_ping(mem->interface, mem->info.addr, timeout_ms)) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+    return MEMOREE_ERR_INVALID_ARG;
+  else if (mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  {
+    // The two most significant address bits form part of the 5-bit command
+    t.cmd_len = 5;
+    t.cmd = MEMOREE_CMD_93CXX_WEN;
+    t.addr_len = mem->info.addr_len - 2;
+
+    int8_t ret = _memoree_spi_transfer(mem, &t);
+    if (ret == 0)
+      return MEMOREE_ERR_OK;
+  }
   else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
   {
-    sfdp_param_t param;
-    return memoree_get_sfdp(mem, &param, timeout_ms);
+    t.cmd = MEMOREE_CMD_25XX_WREN;
+    t.cmd_len = 8;
+    int ret = _memoree_spi_transfer(mem, &t);
+    if (ret == 0)
+      return MEMOREE_ERR_OK;
   }
 
-  return MEMOREE_ERR_INVALID_ARG;
+  return MEMOREE_ERR_FAIL;
 }
 
-memoree_err_t memoree_read_byte(memoree_t mem, uint32_t addr, uint8_t *data, size_t timeout_ms)
-{
-  memoree_err_t ret = memoree_read(mem, addr, data, 1, timeout_ms);
-  return (ret == 1) ? MEMOREE_ERR_OK : ret;
-}
-
-memoree_err_t memoree_write_byte(memoree_t mem, uint32_t addr, uint8_t data, size_t timeout_ms)
+/// @brief Sends \a addr in the address phase of communicaton followed by a stream of \a data_len bytes
+/// @note This fuction does not perform any address translation of pages nor does it split data into chunks before sending.
+/// @return Number of bytes written, on success
+/// @return \link memoree_err_t \endlink error code, on failure
+static int _memoree_write_bytes(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
 {
-
-  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr))
+  if (!ADDRESS_ISVALID(mem, addr) || !data)
     return MEMOREE_ERR_INVALID_ARG;
 
-  int ret;
   if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
-    ret = _memoree_write_bytes(mem, addr, &data, 1, timeout_ms);
-  else
   {
+    uint8_t addr_buffer[sizeof(uint16_t)];
+    uint8_t *write_p = addr_buffer;
+    uint32_t block_size;
+    uint8_t i2c_address = _memoree_i2c_address(mem, addr, &block_size);
+
+    int i = mem->info.addr_len;
+
+    do
+    {
+      i -= 8;
+      *write_p++ = addr >> i;
+    } while (i);
+
+    // The address bytes go out ahead of the caller's buffer in the same transaction, without staging a copy of the data
+    memoree_iovec_t segs[] = {
+        {.buff = addr_buffer, .len = write_p - addr_buffer},
+        {.buff = data, .len = data_len},
+    };
+
+    int ret = _memoree_i2c_writev(mem, i2c_address, segs, 2, timeout_ms);
+    return (ret > 0) ? ret - (mem->info.addr_len / 8) : ret;
+  }
+  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    // The write enable latch is cleared at the end of every program cycle
     if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
       return MEMOREE_ERR_FAIL;
 
     memoree_spi_transaction_t t;
     memset(&t, 0, sizeof(t));
 
+    t.cmd_len = 8;
+    t.cmd = MEMOREE_CMD_25XX_PP;
     t.addr_len = mem->info.addr_len;
     t.addr = (addr & (mem->info.size - 1));
-    t.write_len = 1;
-    t.write_buff = &data;
+    t.write_len = data_len;
+    t.write_buff = data;
     t.timeout_ms = timeout_ms ? timeout_ms : 0;
 
-    if (mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
-    {
-      t.cmd_len = 3;
-      t.cmd = MEMOREE_CMD_93CXX_WRITE;
-    }
-    else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+    int ret = _memoree_spi_transfer(mem, &t);
+    return (ret == 0) ? data_len : MEMOREE_ERR_FAIL;
+  }
+  else
+    return MEMOREE_ERR_INVALID_ARG;
+
+  return MEMOREE_ERR_FAIL;
+}
+
+/// @brief Check once whether \a mem has completed its internal write or erase cycle
+/// @param ready Set to whether the device is ready for the next operation
+static memoree_err_t _memoree_poll_ready(memoree_t mem, bool *ready)
+{
+  if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
+  {
+    // The device does not acknowledge its address until the write cycle has completed
+    *ready = _memoree_i2c_ping(mem, 1) == MEMOREE_ERR_OK;
+    MEMOREE_STATS_ADD(mem, polls, !*ready);
+    return MEMOREE_ERR_OK;
+  }
+  else if (mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  {
+    // Sample DO once, the platform reports a timeout while it is still low
+    memoree_err_t err = _memoree_spi_wait_ready(mem, 0);
+    if (err != MEMOREE_ERR_OK && err != MEMOREE_ERR_TIMEOUT)
+      return err;
+
+    *ready = err == MEMOREE_ERR_OK;
+    MEMOREE_STATS_ADD(mem, polls, !*ready);
+    return MEMOREE_ERR_OK;
+  }
+  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    uint8_t status = 0;
+    memoree_spi_transaction_t t = {
+        .cmd_len = 8,
+        .cmd = MEMOREE_CMD_25XX_RDSR,
+        .read_len = 1,
+        .read_buff = &status,
+    };
+
+    if (_memoree_spi_poll(mem, &t) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
+
+    *ready = !(status & MEMOREE_25XX_SR_WIP);
+    MEMOREE_STATS_ADD(mem, polls, !*ready);
+    return MEMOREE_ERR_OK;
+  }
+
+  return MEMOREE_ERR_INVALID_ARG;
+}
+
+/// @brief Wait for the internal write or erase cycle started by the last operation on \a mem to complete
+/// @param typ_us Typical duration of the cycle, used to avoid polling a device that cannot be ready yet
+/// @param max_us Maximum duration of the cycle given in the datasheet or SFDP table
+/// @return MEMOREE_ERR_TIMEOUT if the device is still busy after \a max_us
+static memoree_err_t _memoree_wait_ready(memoree_t mem, uint64_t typ_us, uint64_t max_us)
+{
+  uint64_t start = MEMOREE_STATS_NOW();
+  memoree_err_t err = MEMOREE_ERR_OK;
+
+  if (mem->info.wait_mode == MEMOREE_WAIT_DELAY || VARIANT_ISSTUB(mem->info.variant))
+    _memoree_sleep(mem, (max_us + 999) / 1000);
+  else
+  {
+    // The device is polled with separate transactions, 93CXX parts included, so that the bus is free between polls
+    uint64_t deadline = platform_get_time_us() + max_us;
+
+    // Sleep through most of long cycles, then poll at a fraction of the typical time so as not to hog the bus
+    if (typ_us >= 4000)
+      _memoree_sleep(mem, typ_us * 3 / 4000);
+    uint32_t poll_interval_ms = typ_us / 16000;
+
+    bool ready = false;
+    while (true)
     {
-      t.cmd_len = 8;
-      t.cmd = MEMOREE_CMD_25XX_PP;
+      bool expired = platform_get_time_us() >= deadline;
+
+      if ((err = _memoree_poll_ready(mem, &ready)) != MEMOREE_ERR_OK || ready)
+        break;
+      if (expired)
+      {
+        err = MEMOREE_ERR_TIMEOUT;
+        MEMOREE_STATS_ADD(mem, timeouts, 1);
+        break;
+      }
+
+      if (poll_interval_ms)
+        _memoree_sleep(mem, poll_interval_ms);
     }
+  }
+
+  MEMOREE_STATS_ADD(mem, wait_us, MEMOREE_STATS_NOW() - start);
+  return err;
+}
 
-    ret = platform_spi_write_read(mem->interface, &t);
+/// @brief Returns the typical and maximum duration of a page write or page program cycle of \a mem
+static void _memoree_write_timing(memoree_t mem, uint64_t *typ_us, uint64_t *max_us)
+{
+  if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    *typ_us = mem->sfdp.pp_typ_us;
+    *max_us = mem->sfdp.pp_max_us ? mem->sfdp.pp_max_us : MEMOREE_25XX_PP_MAX_US;
+  }
+  else
+  {
+    *typ_us = 0;
+    *max_us = mem->info.page_write_delay_ms * 1000;
   }
+}
 
-  return ret;
+/// @brief Wait for the page write or page program cycle started by the last write to \a mem to complete
+static memoree_err_t _memoree_wait_write(memoree_t mem)
+{
+  uint64_t typ_us, max_us;
+  _memoree_write_timing(mem, &typ_us, &max_us);
+
+  return _memoree_wait_ready(mem, typ_us, max_us);
 }
 
-int memoree_read(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
+/// @brief Returns the largest erase type of \a mem that is aligned to \a addr and fits in \a len bytes
+/// @note Erase types are powers of two, so repeatedly taking the largest one covers a range in the fewest operations.
+///       Unspecified maximum erase times are replaced by conservative defaults.
+static sfdp_erase_t _memoree_25xx_pick_erase(memoree_t mem, uint32_t addr, uint32_t len)
 {
-  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data)
-    return MEMOREE_ERR_INVALID_ARG;
+  const sfdp_param_t *param = &mem->sfdp;
+  sfdp_erase_t best = {
+      .size = param->min_sector,
+      .opcode = param->min_sec_opcode,
+  };
+
+  for (uint8_t i = 0; i < MEMOREE_SFDP_ERASE_TYPES; i++)
+  {
+    const sfdp_erase_t *type = &param->erase[i];
+    if (type->size && !(addr % type->size) && type->size <= len && type->size >= best.size)
+      best = *type;
+  }
+
+  if (!best.max_ms)
+    best.max_ms = (best.size <= 4096) ? MEMOREE_25XX_ERASE4K_MAX_MS : MEMOREE_25XX_BLOCK_ERASE_MAX_MS;
+
+  return best;
+}
+
+/// @brief Set the write enable latch of a 25XX device and start an erase cycle
+/// @param has_addr Whether \a opcode takes an address, i.e. whether it is a sector or block erase rather than a chip erase
+static memoree_err_t _memoree_25xx_erase_start(memoree_t mem, uint8_t opcode, bool has_addr, uint32_t addr)
+{
+  if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
+    return MEMOREE_ERR_FAIL;
+
+  memoree_spi_transaction_t t = {
+      .cmd_len = 8,
+      .cmd = opcode,
+      .addr_len = has_addr ? mem->info.addr_len : 0,
+      .addr = addr,
+  };
+
+  return _memoree_spi_transfer(mem, &t);
+}
 
+/// @brief Issue a single 25XX erase instruction and wait for it to complete
+static memoree_err_t _memoree_25xx_erase(memoree_t mem, uint8_t opcode, bool has_addr, uint32_t addr, uint32_t typ_ms, uint32_t max_ms)
+{
+  memoree_err_t ret = _memoree_25xx_erase_start(mem, opcode, has_addr, addr);
+  if (ret != MEMOREE_ERR_OK)
+    return ret;
+
+  return _memoree_wait_ready(mem, (uint64_t)typ_ms * 1000, (uint64_t)max_ms * 1000);
+}
+
+/// @brief Reads \a data_len bytes from the device, bypassing the caches
+static int _memoree_read(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
+{
   int ret = MEMOREE_ERR_FAIL;
 
   if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
   {
-    uint8_t write_buffer[mem->info.addr_len / 8];
-    uint8_t *write_p = write_buffer;
-    int16_t addr_space = _get_address_space(mem);
-    if (addr_space <= 0)
-      return MEMOREE_ERR_INVALID_ARG;
-
-    uint8_t i2c_address;
+    // The internal address counter only rolls over within a block, so a read is split where it crosses into the next
+    // block and each part is addressed to the block holding it
+    uint32_t done = 0;
+    ret = MEMOREE_ERR_OK;
+    while (ret == MEMOREE_ERR_OK && done < data_len)
+    {
+      uint8_t write_buffer[mem->info.addr_len / 8];
+      uint8_t *write_p = write_buffer;
+      uint32_t block_size;
+      uint32_t block_addr = (addr + done) & (mem->info.size - 1);
+      uint8_t i2c_address = _memoree_i2c_address(mem, block_addr, &block_size);
+      uint32_t chunk = block_size - (block_addr & (block_size - 1));
+      chunk = (chunk < data_len - done) ? chunk : data_len - done;
 
-    if (addr_space == mem->info.addr_len)
-      i2c_address = mem->info.addr;
-    else
-      i2c_address = mem->info.addr | (((addr >> mem->info.addr_len) << 1) & 0x0F);
+      int i = mem->info.addr_len;
 
-    int i = mem->info.addr_len;
+      do
+      {
+        i -= 8;
+        *write_p++ = block_addr >> i;
+      } while (i > 0);
 
-    do
-    {
-      i -= 8;
-      *write_p++ = addr >> i;
-    } while (i > 0);
+      ret = _memoree_i2c_write_read(mem, i2c_address, write_buffer, sizeof(write_buffer), data + done, chunk, timeout_ms);
+      done += chunk;
+    }
+  }
+  else
+  {
+    memoree_spi_transaction_t t;
+    if (_memoree_read_transaction(mem, addr, data, data_len, timeout_ms, &t) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_INVALID_ARG;
 
-    ret = platform_i2c_write_read(mem->interface, i2c_address, write_buffer, sizeof(write_buffer), data, data_len, timeout_ms);
+    ret = _memoree_spi_transfer(mem, &t);
   }
-  else if (mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+
+  return (ret < 0) ? ret : data_len;
+}
+
+/// @brief Drop the read cache lines overlapping \a len bytes at \a addr, which are about to be modified on the device
+static void _memoree_cache_invalidate(memoree_t mem, uint32_t addr, uint32_t len)
+{
+  if (!CACHE_READ(mem))
+    return;
+
+  memoree_cache_t *cache = mem->cache;
+  for (uint16_t i = 0; i < cache->line_cnt; i++)
   {
-    memoree_spi_transaction_t t =
-        {
-            .cmd_len = 3,
-            .cmd = MEMOREE_CMD_93CXX_READ,
-            .addr_len = mem->info.addr_len,
-            .addr = (addr & (mem->info.size - 1)),
-            .read_len = data_len,
-            .read_buff = data,
-            .timeout_ms = timeout_ms,
-        };
+    memoree_cache_line_t *slot = &cache->lines[i];
+    uint64_t line_addr = (uint64_t)slot->line * cache->line_size;
+    if (slot->valid && line_addr < (uint64_t)addr + len && line_addr + cache->line_size > addr)
+      slot->valid = false;
+  }
+}
 
-    ret = platform_spi_write_read(mem->interface, &t);
+/// @brief Returns the read cache slot holding \a line, or NULL
+static memoree_cache_line_t *_memoree_cache_lookup(memoree_cache_t *cache, uint32_t line)
+{
+  for (uint16_t i = 0; i < cache->line_cnt; i++)
+    if (cache->lines[i].valid && cache->lines[i].line == line)
+      return &cache->lines[i];
+
+  return NULL;
+}
+
+/// @brief Read \a line into the least recently used slot, along with up to \a prefetch of the lines that follow it that
+///        are not cached yet, in a single device read
+static memoree_err_t _memoree_cache_fill(memoree_t mem, uint32_t line, uint8_t prefetch, memoree_cache_line_t **slot)
+{
+  memoree_cache_t *cache = mem->cache;
+  uint32_t last_line = (mem->info.size - 1) / cache->line_size;
+
+  uint32_t cnt = 1;
+  while (cnt <= prefetch && cnt < cache->line_cnt && line + cnt <= last_line && !_memoree_cache_lookup(cache, line + cnt))
+    cnt++;
+
+  uint32_t base = line * cache->line_size;
+  uint32_t len = cnt * cache->line_size;
+  len = (len < mem->info.size - base) ? len : mem->info.size - base;
+
+  int ret = _memoree_read(mem, base, cache->fill_buff, len, MEMOREE_DEFAULT_TIMEOUT(mem, len));
+  if (ret != (int)len)
+    return (ret < 0) ? ret : MEMOREE_ERR_FAIL;
+
+  for (uint32_t n = 0; n < cnt; n++)
+  {
+    memoree_cache_line_t *victim = &cache->lines[0];
+    for (uint16_t i = 1; i < cache->line_cnt && victim->valid; i++)
+      if (!cache->lines[i].valid || cache->lines[i].last_use < victim->last_use)
+        victim = &cache->lines[i];
+
+    uint32_t offset = n * cache->line_size;
+    memcpy(victim->data, cache->fill_buff + offset, (len - offset < cache->line_size) ? len - offset : cache->line_size);
+    victim->valid = true;
+    victim->prefetched = n > 0;
+    victim->line = line + n;
+    victim->last_use = ++cache->use_cnt;
+
+    if (!n)
+      *slot = victim;
   }
-  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+
+  cache->stats.misses++;
+  cache->stats.prefetches += cnt - 1;
+  return MEMOREE_ERR_OK;
+}
+
+/// @brief Serve a read shorter than a line from the read cache, filling the lines it touches on a miss
+static int _memoree_cache_read(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len)
+{
+  memoree_cache_t *cache = mem->cache;
+  bool sequential = addr == cache->next_addr;
+
+  uint32_t done = 0;
+  while (done < data_len)
   {
-    memoree_spi_transaction_t t =
-        {
-            .cmd_len = 8,
-            .cmd = MEMOREE_CMD_25XX_READ,
-            .addr_len = mem->info.addr_len,
-            .addr = (addr & (mem->info.size - 1)),
-            .read_len = data_len,
-            .read_buff = data,
-            .timeout_ms = timeout_ms,
-        };
+    // Reads running past the end of the memory wrap around to the first line
+    uint32_t cur = (addr + done) % mem->info.size;
+    uint32_t line = cur / cache->line_size;
+    uint32_t offset = cur % cache->line_size;
+
+    memoree_cache_line_t *slot = _memoree_cache_lookup(cache, line);
+    if (slot)
+    {
+      cache->stats.hits++;
+      if (slot->prefetched)
+        cache->stats.prefetch_hits++;
+      slot->prefetched = false;
+      slot->last_use = ++cache->use_cnt;
+    }
+    else
+    {
+      memoree_err_t ret = _memoree_cache_fill(mem, line, sequential ? cache->prefetch : 0, &slot);
+      if (ret != MEMOREE_ERR_OK)
+        return ret;
+    }
 
-    ret = platform_spi_write_read(mem->interface, &t);
+    uint32_t chunk = cache->line_size - offset;
+    chunk = (chunk < mem->info.size - cur) ? chunk : mem->info.size - cur;
+    chunk = (chunk < data_len - done) ? chunk : data_len - done;
+    memcpy(data + done, slot->data + offset, chunk);
+    done += chunk;
   }
 
-  return (ret < 0) ? ret : data_len;
+  cache->next_addr = (addr + data_len) % mem->info.size;
+  return data_len;
 }
 
-int memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, bool wrap)
+/// @brief Programs \a data_len bytes one page (or byte, on 93CXX) at a time, bypassing the write-back cache
+static int _memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, bool wrap)
 {
-  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data)
-    return MEMOREE_ERR_INVALID_ARG;
+  _memoree_cache_invalidate(mem, addr, data_len);
 
   int32_t bytes_written = 0;
   int64_t overflow = (int64_t)(addr + data_len) - (int64_t)(mem->info.size);
@@ -535,13 +1184,14 @@ int memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len
     int8_t ret = 0;
     do
     {
-      ret = platform_spi_write_read(mem->interface, &t);
+      ret = _memoree_spi_transfer(mem, &t);
+      if (ret == 0)
+        ret = _memoree_wait_write(mem);
       t.addr++;
       t.write_buff++;
-      platform_ms_delay(mem->info.page_write_delay_ms);
     } while (ret == 0 && --bytes_to_write);
 
-    return (ret == 0) ? data_len : MEMOREE_ERR_FAIL;
+    return (ret == 0) ? data_len : (ret < 0) ? ret : MEMOREE_ERR_FAIL;
   }
   else if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX || mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
   {
@@ -550,10 +1200,10 @@ int memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len
     {
       if (wrap)
       {
-        bytes_written = memoree_write(mem, addr, data, data_len - overflow, timeout_ms, false);
+        bytes_written = _memoree_write(mem, addr, data, data_len - overflow, timeout_ms, false);
         if (bytes_written != data_len - overflow)
           return bytes_written;
-        bytes_written = memoree_write(mem, 0, data + bytes_written,
+        bytes_written = _memoree_write(mem, 0, data + bytes_written,
                                       overflow, timeout_ms, false);
         if (bytes_written != overflow)
           return bytes_written;
@@ -564,268 +1214,2387 @@ int memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len
         data_len -= (addr + data_len) % (mem->info.size);
     }
 
-    uint16_t alignment_bytes = mem->info.page_size - (addr % mem->info.page_size);
-    uint16_t interations = (data_len - alignment_bytes) / mem->info.page_size;
-
-    // Write the first few bytes so that the next address is at the start of a page
-    bytes_written = _memoree_write_bytes(mem, addr, data, alignment_bytes, MEMOREE_DEFAULT_TIMEOUT(mem, alignment_bytes));
-    platform_ms_delay(mem->info.page_write_delay_ms);
-    if (bytes_written < 0)
-      return MEMOREE_ERR_FAIL;
-
-    addr += alignment_bytes;
-    data += alignment_bytes;
-
-    for (uint16_t i = 0; i < interations; i++)
+    // The first chunk only fills up the first page so that every following chunk starts at the beginning of a page
+    uint32_t bytes_left = data_len;
+    while (bytes_left)
     {
-      bytes_written = _memoree_write_bytes(mem, addr + (mem->info.page_size * i), data + (mem->info.page_size * i), mem->info.page_size, MEMOREE_DEFAULT_TIMEOUT(mem, mem->info.page_size));
-      platform_ms_delay(mem->info.page_write_delay_ms * 2);
+      uint32_t chunk = mem->info.page_size - (addr % mem->info.page_size);
+      chunk = (chunk < bytes_left) ? chunk : bytes_left;
+
+      bytes_written = _memoree_write_bytes(mem, addr, data, chunk, MEMOREE_DEFAULT_TIMEOUT(mem, chunk));
       if (bytes_written < 0)
         return MEMOREE_ERR_FAIL;
+
+      memoree_err_t err = _memoree_wait_write(mem);
+      if (err != MEMOREE_ERR_OK)
+        return err;
+
+      addr += chunk;
+      data += chunk;
+      bytes_left -= chunk;
     }
   }
 
   return data_len;
 }
 
-memoree_err_t memoree_erase_page(memoree_t mem, uint32_t page, uint8_t erase_value)
+/// @brief Write the page held in \a slot back to the device
+static memoree_err_t _memoree_cache_flush_page(memoree_t mem, memoree_cache_page_t *slot)
 {
-  if (!PAGE_ISVALID(mem, page))
-    return MEMOREE_ERR_INVALID_ARG;
+  if (!slot->dirty)
+    return MEMOREE_ERR_OK;
 
-  int ret;
+  uint32_t page_size = mem->info.page_size;
+  int ret = _memoree_write(mem, slot->page * page_size, slot->data, page_size, MEMOREE_DEFAULT_TIMEOUT(mem, page_size), false);
+  if (ret != (int)page_size)
+    return (ret < 0) ? ret : MEMOREE_ERR_FAIL;
 
-  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
-  {
-    memoree_spi_transaction_t t = {
-        .cmd_len = 5,
-        .addr_len = 5,
-        .dummy_len = 0,
-        .read_len = 0,
-        .read_buff = NULL,
-        .write_len = 0,
-        .write_buff = NULL,
-        .timeout_ms = 0,
-    };
+  slot->dirty = false;
+  return MEMOREE_ERR_OK;
+}
 
-    if (erase_value == 0xFF)
-      t.cmd = MEMOREE_CMD_93CXX_ERASE;
-    else
-    {
-      t.cmd = MEMOREE_CMD_93CXX_WRITE;
-      t.write_len = 1;
-      t.write_buff = &erase_value;
-    }
+/// @brief Write back the dirty pages that are older than the cache's deadline, or all of them if \a all
+static memoree_err_t _memoree_cache_flush(memoree_t mem, bool all)
+{
+  memoree_cache_t *cache = mem->cache;
+  if (!cache)
+    return MEMOREE_ERR_OK;
 
-    ret = platform_spi_write_read(mem->interface, &t);
-    platform_ms_delay(mem->info.page_write_delay_ms);
+  if (!all && !cache->flush_after_us)
+    return MEMOREE_ERR_OK;
 
-    return ret;
-  }
+  uint64_t now = platform_get_time_us();
+  for (uint16_t i = 0; i < cache->page_cnt; i++)
+  {
+    memoree_cache_page_t *slot = &cache->pages[i];
+    if (!slot->dirty || (!all && now - slot->dirty_us < cache->flush_after_us))
+      continue;
 
-  uint32_t erase_buff_size = mem->info.page_size;
-  uint8_t erase_buff[erase_buff_size];
-  memset(erase_buff, erase_value, sizeof(erase_buff));
-  ret = _memoree_write_bytes(mem, page * erase_buff_size, erase_buff, erase_buff_size, MEMOREE_DEFAULT_TIMEOUT(mem, erase_buff_size));
+    memoree_err_t ret = _memoree_cache_flush_page(mem, slot);
+    if (ret != MEMOREE_ERR_OK)
+      return ret;
+  }
 
-  return (ret == erase_buff_size) ? MEMOREE_ERR_OK : ret;
+  return MEMOREE_ERR_OK;
 }
 
-memoree_err_t memoree_erase(memoree_t mem, uint8_t erase_value)
+/// @brief Drop the dirty pages overlapping \a len bytes at \a addr without writing them back, e.g. when they are erased
+static void _memoree_cache_discard(memoree_t mem, uint32_t addr, uint32_t len)
 {
-  if (!MEMOREE_ISVALID(mem))
-    return MEMOREE_ERR_INVALID_ARG;
-  int ret;
-  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  memoree_cache_t *cache = mem->cache;
+  if (!cache)
+    return;
+
+  _memoree_cache_invalidate(mem, addr, len);
+
+  for (uint16_t i = 0; i < cache->page_cnt; i++)
   {
-    if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
-      return MEMOREE_ERR_FAIL;
+    memoree_cache_page_t *slot = &cache->pages[i];
+    uint64_t page_addr = (uint64_t)slot->page * mem->info.page_size;
+    if (slot->dirty && page_addr < (uint64_t)addr + len && page_addr + mem->info.page_size > addr)
+      slot->dirty = false;
+  }
+}
 
-    memoree_spi_transaction_t t;
-    memset(&t, 0, sizeof(t));
+/// @brief Find the cache slot holding \a page, or claim one for it, writing back the oldest dirty page if none is free
+/// @param load Whether to fill a newly claimed slot with the page's current contents, unnecessary if it is about to be
+///        overwritten in full
+static memoree_err_t _memoree_cache_get(memoree_t mem, uint32_t page, bool load, memoree_cache_page_t **slot)
+{
+  memoree_cache_t *cache = mem->cache;
+  memoree_cache_page_t *victim = NULL;
 
-    if (erase_value == 0xFF)
+  for (uint16_t i = 0; i < cache->page_cnt; i++)
+  {
+    memoree_cache_page_t *candidate = &cache->pages[i];
+    if (candidate->dirty && candidate->page == page)
     {
-      t.cmd_len = 5;
-      t.cmd = MEMOREE_CMD_93CXX_ERAL;
-      t.addr_len = 5;
+      *slot = candidate;
+      return MEMOREE_ERR_OK;
+    }
 
-      ret = platform_spi_write_read(mem->interface, &t);
-      platform_ms_delay(mem->info.page_write_delay_ms);
+    if (!victim || (victim->dirty && (!candidate->dirty || candidate->dirty_us < victim->dirty_us)))
+      victim = candidate;
+  }
 
-      return (ret == 0) ? MEMOREE_ERR_OK : ret;
-    }
+  memoree_err_t ret = _memoree_cache_flush_page(mem, victim);
+  if (ret != MEMOREE_ERR_OK)
+    return ret;
 
-    t.cmd_len = 3;
-    t.cmd = MEMOREE_CMD_93CXX_WRITE;
-    t.addr_len = mem->info.addr_len;
-    t.write_len = 1;
-    t.write_buff = &erase_value;
+  uint32_t page_size = mem->info.page_size;
+  if (load)
+  {
+    int read = _memoree_read(mem, page * page_size, victim->data, page_size, MEMOREE_DEFAULT_TIMEOUT(mem, page_size));
+    if (read != (int)page_size)
+      return (read < 0) ? read : MEMOREE_ERR_FAIL;
+  }
 
-    // Write one byte at a time
-    uint32_t bytes_to_write = mem->info.size;
-    ret = 0;
-    do
+  victim->page = page;
+  victim->dirty = true;
+  victim->dirty_us = platform_get_time_us();
+  *slot = victim;
+  return MEMOREE_ERR_OK;
+}
+
+/// @brief Merge \a data_len bytes at \a addr into the cached pages, with the same overflow handling as memoree_write()
+static int _memoree_cache_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, bool wrap)
+{
+  uint32_t page_size = mem->info.page_size;
+  int64_t overflow = (int64_t)addr + data_len - mem->info.size;
+
+  if (overflow > 0)
+  {
+    if (wrap)
     {
-      ret = platform_spi_write_read(mem->interface, &t);
-      t.addr++;
-      platform_ms_delay(mem->info.page_write_delay_ms);
-    } while (ret == 0 && --bytes_to_write);
+      int ret = _memoree_cache_write(mem, addr, data, data_len - overflow, false);
+      if (ret != data_len - overflow)
+        return ret;
+      ret = _memoree_cache_write(mem, 0, data + ret, overflow, false);
+      return (ret == overflow) ? (int)data_len : ret;
+    }
 
-    return ret;
+    data_len -= overflow;
   }
-  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP && erase_value == 0xFF)
+
+  uint32_t done = 0;
+  while (done < data_len)
   {
-    sfdp_param_t param;
-    if ((ret = memoree_get_sfdp(mem, &param, 100)) != MEMOREE_ERR_OK)
+    uint32_t offset = (addr + done) % page_size;
+    uint32_t chunk = page_size - offset;
+    chunk = (chunk < data_len - done) ? chunk : data_len - done;
+
+    memoree_cache_page_t *slot;
+    memoree_err_t ret = _memoree_cache_get(mem, (addr + done) / page_size, chunk != page_size, &slot);
+    if (ret != MEMOREE_ERR_OK)
       return ret;
 
-    // If 4k sector erase is supported
-    if (param.erase4k_opcode)
+    memcpy(slot->data + offset, data + done, chunk);
+    done += chunk;
+  }
+
+  memoree_err_t ret = _memoree_cache_flush(mem, false);
+  return (ret == MEMOREE_ERR_OK) ? (int)data_len : ret;
+}
+
+/// @brief Copy the dirty cached pages overlapping \a data_len bytes read at \a addr over the data read from the device
+static void _memoree_cache_overlay(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len)
+{
+  memoree_cache_t *cache = mem->cache;
+  uint32_t page_size = mem->info.page_size;
+
+  for (uint16_t i = 0; i < cache->page_cnt; i++)
+  {
+    memoree_cache_page_t *slot = &cache->pages[i];
+    if (!slot->dirty)
+      continue;
+
+    // Reads running past the end of the memory wrap around to the first page
+    for (uint64_t page_addr = (uint64_t)slot->page * page_size; page_addr < (uint64_t)addr + data_len;
+         page_addr += mem->info.size)
     {
-      memoree_spi_transaction_t t = {
-          .cmd_len = 8,
-          .cmd = param.erase4k_opcode,
-          .addr_len = mem->info.addr_len,
-      };
+      uint64_t start = (page_addr > addr) ? page_addr : addr;
+      uint64_t end = (page_addr + page_size < (uint64_t)addr + data_len) ? page_addr + page_size : (uint64_t)addr + data_len;
+      if (start < end)
+        memcpy(data + (start - addr), slot->data + (start - page_addr), end - start);
+    }
+  }
+}
 
-      for (t.addr = 0; t.addr < mem->info.size; t.addr += 4096)
-      {
-        ret = platform_spi_write_read(mem->interface, &t);
-        platform_ms_delay(mem->info.page_write_delay_ms);
+/// @brief Drop a reference to \a bus, deinitializing it when it was the last one
+static memoree_err_t _memoree_bus_release(memoree_bus_t bus)
+{
+  if (--bus->refs)
+    return MEMOREE_ERR_OK;
 
-        return (ret == 0) ? MEMOREE_ERR_OK : ret;
-      }
+  memoree_err_t ret = (bus->type == MEMOREE_TYPE_I2C) ? platform_i2c_bus_deinit(bus->interface)
+                                                      : platform_spi_bus_deinit(bus->interface);
+  if (ret != MEMOREE_ERR_OK)
+  {
+    bus->refs++;
+    return MEMOREE_ERR_FAIL;
+  }
+
+  memoree_bus_t *link = &memoree_buses;
+  while (*link != bus)
+    link = &(*link)->next;
+  *link = bus->next;
+
+  platform_mutex_delete(bus->lock);
+  free(bus);
+  return MEMOREE_ERR_OK;
+}
+
+//////////////////////PUBLIC FUNCTIONS
+
+memoree_bus_t memoree_bus_init(memoree_type_t type, void *bus_conf)
+{
+  if (!bus_conf || (type != MEMOREE_TYPE_I2C && type != MEMOREE_TYPE_SPI))
+    return NULL;
+
+  int port = ((memoree_periph_conf_t *)bus_conf)->port;
+  for (memoree_bus_t bus = memoree_buses; bus; bus = bus->next)
+  {
+    if (bus->type == type && bus->port == port)
+    {
+      bus->refs++;
+      return bus;
     }
   }
 
-  uint32_t erase_buff_size = mem->info.page_size;
-  uint8_t erase_buff[erase_buff_size];
-  memset(erase_buff, erase_value, erase_buff_size);
-  uint16_t page = 0;
-  for (; page < mem->info.num_pages; page++)
+  memoree_bus_t bus = calloc(1, sizeof(struct memoree_bus));
+  if (!bus)
+    return NULL;
+
+  if (!(bus->lock = platform_mutex_create()))
   {
-    int ret = _memoree_write_bytes(mem, page * erase_buff_size, erase_buff, erase_buff_size, MEMOREE_DEFAULT_TIMEOUT(mem, erase_buff_size));
-    platform_ms_delay(mem->info.page_write_delay_ms);
-    if (ret != erase_buff_size)
-      return ret;
+    free(bus);
+    return NULL;
   }
 
-  return (page == mem->info.num_pages) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+  if (type == MEMOREE_TYPE_I2C)
+  {
+    uint32_t speed = ((memoree_i2c_conf_t *)bus_conf)->speed;
+    speed = (speed > MEMOREE_I2C_MAX_SPEED) ? MEMOREE_I2C_MAX_SPEED : speed;
+    ((memoree_i2c_conf_t *)bus_conf)->speed = speed;
+
+    bus->speed = speed;
+    bus->interface = platform_i2c_bus_init((memoree_i2c_conf_t *)bus_conf);
+  }
+  else
+    bus->interface = platform_spi_bus_init((memoree_spi_conf_t *)bus_conf);
+
+  if (!bus->interface)
+  {
+    platform_mutex_delete(bus->lock);
+    free(bus);
+    return NULL;
+  }
+
+  bus->type = type;
+  bus->port = port;
+  bus->refs = 1;
+  bus->next = memoree_buses;
+  memoree_buses = bus;
+  return bus;
 }
 
-memoree_err_t memoree_get_info(memoree_t mem, memoree_info_t *mem_info)
+memoree_err_t memoree_bus_deinit(memoree_bus_t bus)
 {
-  if (!MEMOREE_ISVALID(mem) || !mem_info)
+  if (!bus || !bus->refs)
     return MEMOREE_ERR_INVALID_ARG;
 
-  mem_info->type = mem->info.type;
-  mem_info->variant = mem->info.variant;
-  mem_info->size = mem->info.size;
-  mem_info->speed = mem->info.speed;
-  mem_info->addr_len = mem->info.addr_len;
-  mem_info->addr = mem->info.addr;
-  mem_info->page_size = mem->info.page_size;
-  mem_info->num_pages = mem->info.num_pages;
-  mem_info->page_write_delay_ms = mem->info.page_write_delay_ms;
-  mem_info->protected = mem->info.protected;
+  return _memoree_bus_release(bus);
+}
+
+memoree_t memoree_init(memoree_variant_t variant, void *interface_conf)
+{
+  if (!interface_conf)
+    return NULL;
+
+  if (!VARIANT_ISSTUB(variant))
+    if (!VARIANT_ISVALID(variant))
+      return NULL;
+
+  memoree_type_t type = (variant < MEMOREE_VARIANT_I2C_MAX) ? MEMOREE_TYPE_I2C : MEMOREE_TYPE_SPI;
+  memoree_bus_t bus = (type == MEMOREE_TYPE_I2C) ? ((memoree_i2c_conf_t *)interface_conf)->bus
+                                                 : ((memoree_spi_conf_t *)interface_conf)->bus;
+
+  // Without an explicit bus, the chip shares the bus of its port with any other chip initialized on it
+  if (bus && bus->type == type)
+    bus->refs++;
+  else if (bus || !(bus = memoree_bus_init(type, interface_conf)))
+    return NULL;
+
+  memoree_interface_t interface = NULL;
+  uint32_t speed = ((memoree_periph_conf_t *)interface_conf)->speed;
+
+  if (type == MEMOREE_TYPE_I2C)
+  {
+    speed = bus->speed;
+    interface = platform_i2c_init(bus->interface, (memoree_i2c_conf_t *)interface_conf);
+  }
+  else
+  {
+    if (variant == MEMOREE_VARIANT_25XX_SFDP || variant == MEMOREE_VARIANT_STUB_SPI)
+      speed = (speed > MEMOREE_SPI_MAX_SPEED) ? MEMOREE_SPI_MAX_SPEED : speed;
+    else if (variant < MEMOREE_VARIANT_93CXX_MAX)
+      speed = (speed > MEMOREE_SPI_93X_MAX_SPEED) ? MEMOREE_SPI_93X_MAX_SPEED : speed;
+
+    ((memoree_spi_conf_t *)interface_conf)->speed = speed;
+
+    interface = platform_spi_init(bus->interface, (memoree_spi_conf_t *)interface_conf);
+  }
+
+  if (!interface)
+  {
+    _memoree_bus_release(bus);
+    return NULL;
+  }
+
+  memoree_t mem = calloc(1, sizeof(struct memoree));
+  if (mem && !(mem->lock = platform_mutex_create()))
+  {
+    free(mem);
+    mem = NULL;
+  }
+
+  if (!mem)
+  {
+    if (type == MEMOREE_TYPE_I2C)
+      platform_i2c_deinit(interface);
+    else
+      platform_spi_deinit(interface);
+    _memoree_bus_release(bus);
+    return NULL;
+  }
+
+  memcpy(&mem->info, &mem_props[variant], sizeof(memoree_info_t));
+  mem->interface = interface;
+  mem->bus = bus;
+
+  if (mem->info.type == MEMOREE_TYPE_I2C)
+    mem->info.addr = ((memoree_i2c_conf_t *)interface_conf)->addr;
+
+  if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    sfdp_param_t param;
+
+    if (memoree_get_sfdp(mem, &param, 100) != MEMOREE_ERR_OK)
+    {
+      memoree_deinit(mem, true);
+      return NULL;
+    }
+  }
+
+  if (!VARIANT_ISSTUB(mem->info.variant))
+  {
+    mem->info.speed = speed;
+    mem->info.num_pages = mem->info.size / mem->info.page_size;
+    mem->info.protected = false;
+  }
+    
+  return mem;
+}
+
+memoree_err_t memoree_deinit(memoree_t mem, bool if_deinit)
+{
+  if (!mem || !mem->interface)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  if (mem->info.variant != MEMOREE_VARIANT_STUB_I2C && mem->info.variant != MEMOREE_VARIANT_STUB_SPI)
+    if (!MEMOREE_ISVALID(mem))
+      return MEMOREE_ERR_INVALID_ARG;
+
+  if (mem->cache && memoree_cache_detach(mem) != MEMOREE_ERR_OK)
+    return MEMOREE_ERR_FAIL;
+
+  if (if_deinit)
+  {
+    switch (mem->info.type)
+    {
+    case MEMOREE_TYPE_I2C:
+      if (platform_i2c_deinit(mem->interface) != 0)
+        return MEMOREE_ERR_FAIL;
+      break;
+    case MEMOREE_TYPE_SPI:
+      if (platform_spi_deinit(mem->interface) != 0)
+        return MEMOREE_ERR_FAIL;
+      break;
+    default:
+      return MEMOREE_ERR_INVALID_ARG;
+      break;
+    }
 
+    if (_memoree_bus_release(mem->bus) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
+  }
+  platform_mutex_delete(mem->lock);
+  free(mem);
+  mem = NULL;
   return MEMOREE_ERR_OK;
 }
 
-memoree_err_t memoree_protect(memoree_t mem, memoree_protection_t protection)
+memoree_err_t memoree_ping(memoree_t mem, size_t timeout_ms)
 {
-  if (!MEMOREE_ISVALID(mem) || mem->info.variant != MEMOREE_VARIANT_25XX_SFDP)
+  if (!MEMOREE_ISVALID(mem))
     return MEMOREE_ERR_INVALID_ARG;
 
-  return MEMOREE_ERR_FAIL;
+  memoree_err_t ret = MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
+    ret = _memoree_i2c_ping(mem, timeout_ms);
+  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    // The parsed SFDP parameters are cached, so the signature is read again to find out whether the chip still answers
+    uint8_t signature[4];
+    int read = memoree_read_sfdp(mem, 0, signature, sizeof(signature), timeout_ms);
+    if (read < 0)
+      ret = read;
+    else
+      ret = memcmp(signature, "SFDP", sizeof(signature)) ? MEMOREE_ERR_FAIL : MEMOREE_ERR_OK;
+  }
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
 }
 
-memoree_err_t memoree_get_sfdp(memoree_t mem, sfdp_param_t *param, size_t timeout_ms)
+memoree_err_t memoree_read_byte(memoree_t mem, uint32_t addr, uint8_t *data, size_t timeout_ms)
 {
-  if (!MEMOREE_ISVALID(mem) || !param || mem->info.variant != MEMOREE_VARIANT_25XX_SFDP)
-    return false;
+  memoree_err_t ret = memoree_read(mem, addr, data, 1, timeout_ms);
+  return (ret == 1) ? MEMOREE_ERR_OK : ret;
+}
 
-  int ret = 0;
-  uint8_t read_buff[15];
-  memset(read_buff, 0xFF, sizeof(read_buff));
-  memoree_spi_transaction_t t = {
-      .cmd_len = 8,
-      .cmd = MEMOREE_CMD_25XX_SFDP,
-      .addr_len = 24,
-      .addr = 0,
-      .write_len = sizeof(read_buff),
-      .write_buff = read_buff,
-      .read_len = sizeof(read_buff),
-      .read_buff = read_buff,
-      .dummy_len = 8,
-      .timeout_ms = timeout_ms ? timeout_ms : 0,
-  };
+static memoree_err_t _memoree_write_byte(memoree_t mem, uint32_t addr, uint8_t data, size_t timeout_ms)
+{
 
-  ret = platform_spi_write_read(mem->interface, &t);
-  if (ret != 0)
-    return MEMOREE_ERR_FAIL;
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr))
+    return MEMOREE_ERR_INVALID_ARG;
 
-  if (read_buff[0] != 'S' || read_buff[1] != 'F' || read_buff[2] != 'D' || read_buff[3] != 'P')
-    return MEMOREE_ERR_SFDP_NOT_SUPPORTED;
+  int ret;
+  if (CACHE_WRITEBACK(mem))
+  {
+    ret = _memoree_cache_write(mem, addr, &data, 1, false);
+    return (ret == 1) ? MEMOREE_ERR_OK : ret;
+  }
 
-  // Byte 7 is unused and must be 0xFF && Flash parameter table must at contain the flash memory size (the second double word,bytes 5-8)
-  if (read_buff[7] != 0xFF || read_buff[11] < 2)
-    return MEMOREE_ERR_SFDP_INVALID_HEADER;
+  _memoree_cache_invalidate(mem, addr, 1);
 
-  param->header_ver = (read_buff[5] << 8) | read_buff[4];
-  param->header_cnt = read_buff[6] + 1; // SFDP header count is zero indexed
-  param->fparam_ver = (read_buff[10] << 8) | read_buff[9];
-  param->fparam_size = read_buff[11] * 4;
-  param->fparam_ptr = (read_buff[14] << 16) | (read_buff[13] << 8) | read_buff[12];
+  if (mem->info.variant < MEMOREE_VARIANT_I2C_MAX)
+  {
+    ret = _memoree_write_bytes(mem, addr, &data, 1, timeout_ms);
+    if (ret != 1)
+      return (ret < 0) ? ret : MEMOREE_ERR_FAIL;
 
-  uint8_t sfdp_table[param->fparam_size];
-  memset(sfdp_table, 0xFF, param->fparam_size);
-  t.addr = param->fparam_ptr;
-  t.write_len = t.read_len = sizeof(sfdp_table);
-  t.write_buff = t.read_buff = sfdp_table;
+    return _memoree_wait_write(mem);
+  }
+  else
+  {
+    if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
 
-  ret = platform_spi_write_read(mem->interface, &t);
-  if (ret != 0)
-    return MEMOREE_ERR_FAIL;
+    memoree_spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
 
-  if (((sfdp_table[0] >> 5) & 0b111) != 0b111 || ((sfdp_table[2] >> 7) & 0b1) != 0b1 || sfdp_table[3] != 0xFF)
-    return MEMOREE_ERR_SFDP_INVALID_HEADER;
+    t.addr_len = mem->info.addr_len;
+    t.addr = (addr & (mem->info.size - 1));
+    t.write_len = 1;
+    t.write_buff = &data;
+    t.timeout_ms = timeout_ms ? timeout_ms : 0;
 
-  param->write_size = (sfdp_table[0] >> 2 & 0b1) ? 64 : 1;
-  param->erase4k_opcode = (sfdp_table[0] & 0b11) == 0b11 ? 0 : sfdp_table[1];
-  param->addr_bytes = ((sfdp_table[2] >> 1 & 0b11) == 0b00) ? 3 : ((sfdp_table[2] >> 1 & 0b11) == 0b10) ? 4
-                                                                                                        : 0;
-  param->dtr_support = (sfdp_table[2] >> 3 & 0b1);
-  param->min_sector = ((sfdp_table[0] & 0b11) == 01) ? 4096 : 0;
+    if (mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+    {
+      t.cmd_len = 3;
+      t.cmd = MEMOREE_CMD_93CXX_WRITE;
+    }
+    else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+    {
+      t.cmd_len = 8;
+      t.cmd = MEMOREE_CMD_25XX_PP;
+    }
 
-  uint64_t flash_size = (sfdp_table[7] & 0x7F) << 24 |
-                        sfdp_table[6] << 16 |
-                        sfdp_table[5] << 8 |
-                        sfdp_table[4] << 0;
+    ret = _memoree_spi_transfer(mem, &t);
+    if (ret == MEMOREE_ERR_OK)
+      ret = _memoree_wait_write(mem);
+  }
 
-  param->size = ((sfdp_table[7] >> 7) & 0b1) ? 2 << (flash_size - 1) : flash_size;
-  param->size >>= 3;
+  return ret;
+}
 
-  mem->info.addr_len = param->addr_bytes * 8;
-  mem->info.page_size = param->write_size;
-  mem->info.size = param->size;
+memoree_err_t memoree_write_byte(memoree_t mem, uint32_t addr, uint8_t data, size_t timeout_ms)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
 
-  return MEMOREE_ERR_OK;
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  memoree_err_t ret = _memoree_write_byte(mem, addr, data, timeout_ms);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_WRITE, start, (ret == MEMOREE_ERR_OK) ? 1 : 0);
+  platform_mutex_unlock(mem->lock);
+  return ret;
 }
 
-int memoree_stub_write_read(memoree_t mem, memoree_stub_transaction_t *t)
+int memoree_read(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
 {
-  if (!mem || !mem->interface || !VARIANT_ISSTUB(mem->info.variant) || !t)
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data)
     return MEMOREE_ERR_INVALID_ARG;
 
-  int ret = 0;
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
 
-  if (mem->info.variant == MEMOREE_VARIANT_STUB_I2C)
-    ret = platform_i2c_write_read(mem->interface, (uint8_t)t->addr, t->write_buff,
-                                  t->write_len, t->read_buff, t->read_len, t->timeout_ms);
+  // Reads of a whole line or more gain nothing from the read cache and would only evict it
+  int ret;
+  if (CACHE_READ(mem) && data_len < mem->cache->line_size)
+    ret = _memoree_cache_read(mem, addr, data, data_len);
   else
-    ret = platform_spi_write_read(mem->interface, (memoree_spi_transaction_t *)t);
+    ret = _memoree_read(mem, addr, data, data_len, timeout_ms);
+
+  // Pages past their deadline are left to writes and memoree_cache_poll(), so that a read never waits for a program
+  if (ret >= 0 && CACHE_WRITEBACK(mem))
+    _memoree_cache_overlay(mem, addr, data, data_len);
+
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_READ, start, (ret < 0) ? 0 : data_len);
+  platform_mutex_unlock(mem->lock);
+  return (ret < 0) ? ret : (int)data_len;
+}
+
+int memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, bool wrap)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  int ret;
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  if (CACHE_WRITEBACK(mem))
+    ret = _memoree_cache_write(mem, addr, data, data_len, wrap);
+  else
+    ret = _memoree_write(mem, addr, data, data_len, timeout_ms, wrap);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_WRITE, start, ret);
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
+}
+
+static int _memoree_write_diff(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, uint32_t *programmed)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data || (uint64_t)addr + data_len > mem->info.size)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // Pages are compared against the device itself, so it has to hold everything written through the cache first
+  memoree_err_t err = _memoree_cache_flush(mem, true);
+  if (err != MEMOREE_ERR_OK)
+    return err;
+
+  uint8_t *current = malloc(mem->info.page_size);
+  if (!current)
+    return MEMOREE_ERR_MEM;
+
+  int ret = data_len;
+  uint32_t done = 0;
+  while (done < data_len)
+  {
+    uint32_t chunk = mem->info.page_size - ((addr + done) % mem->info.page_size);
+    chunk = (chunk < data_len - done) ? chunk : data_len - done;
+
+    int read = _memoree_read(mem, addr + done, current, chunk, MEMOREE_DEFAULT_TIMEOUT(mem, chunk));
+    if (read != (int)chunk)
+    {
+      ret = (read < 0) ? read : MEMOREE_ERR_FAIL;
+      break;
+    }
+
+    if (memcmp(current, data + done, chunk))
+    {
+      // Programming flash only clears bits, anything else needs an erase
+      if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+      {
+        uint32_t i = 0;
+        while (i < chunk && (current[i] & data[done + i]) == data[done + i])
+          i++;
+
+        if (i < chunk)
+        {
+          ret = MEMOREE_ERR_FAIL;
+          break;
+        }
+      }
+
+      int written = _memoree_write(mem, addr + done, data + done, chunk, timeout_ms, false);
+      if (written != (int)chunk)
+      {
+        ret = (written < 0) ? written : MEMOREE_ERR_FAIL;
+        break;
+      }
+
+      if (programmed)
+        (*programmed)++;
+    }
+
+    done += chunk;
+  }
+
+  free(current);
+  return ret;
+}
+
+int memoree_write_diff(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, uint32_t *programmed)
+{
+  if (programmed)
+    *programmed = 0;
+
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  int ret = _memoree_write_diff(mem, addr, data, data_len, timeout_ms, programmed);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_WRITE, start, ret);
+  platform_mutex_unlock(mem->lock);
+  return ret;
+}
+
+static memoree_err_t _memoree_erase_page(memoree_t mem, uint32_t page, uint8_t erase_value)
+{
+  if (!PAGE_ISVALID(mem, page))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  int ret;
+  _memoree_cache_discard(mem, page * mem->info.page_size, mem->info.page_size);
+
+  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  {
+    if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
+
+    // Pages are one byte long, so the page number is the address of the byte to erase
+    memoree_spi_transaction_t t = {
+        .cmd_len = 3,
+        .addr_len = mem->info.addr_len,
+        .addr = page,
+        .dummy_len = 0,
+        .read_len = 0,
+        .read_buff = NULL,
+        .write_len = 0,
+        .write_buff = NULL,
+        .timeout_ms = 0,
+    };
+
+    if (erase_value == 0xFF)
+      t.cmd = MEMOREE_CMD_93CXX_ERASE;
+    else
+    {
+      t.cmd = MEMOREE_CMD_93CXX_WRITE;
+      t.write_len = 1;
+      t.write_buff = &erase_value;
+    }
+
+    ret = _memoree_spi_transfer(mem, &t);
+    if (ret != MEMOREE_ERR_OK)
+      return ret;
+
+    return _memoree_wait_write(mem);
+  }
+
+  uint32_t erase_buff_size = mem->info.page_size;
+  uint8_t erase_buff[erase_buff_size];
+  memset(erase_buff, erase_value, sizeof(erase_buff));
+  ret = _memoree_write_bytes(mem, page * erase_buff_size, erase_buff, erase_buff_size, MEMOREE_DEFAULT_TIMEOUT(mem, erase_buff_size));
+  if (ret != erase_buff_size)
+    return (ret < 0) ? ret : MEMOREE_ERR_FAIL;
+
+  return _memoree_wait_write(mem);
+}
+
+memoree_err_t memoree_erase_page(memoree_t mem, uint32_t page, uint8_t erase_value)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  memoree_err_t ret = _memoree_erase_page(mem, page, erase_value);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_ERASE, start, 0);
+  platform_mutex_unlock(mem->lock);
+  return ret;
+}
+
+static memoree_err_t _memoree_erase_range(memoree_t mem, uint32_t addr, uint32_t len)
+{
+  if (!MEMOREE_ISVALID(mem) || mem->info.variant != MEMOREE_VARIANT_25XX_SFDP || !len ||
+      (uint64_t)addr + len > mem->info.size)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  const sfdp_param_t *param = &mem->sfdp;
+  if (!param->min_sector || addr % param->min_sector || len % param->min_sector)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  _memoree_cache_discard(mem, addr, len);
+
+  // A single chip erase is far faster than erasing every block of the device
+  if (addr == 0 && len == mem->info.size)
+    return _memoree_25xx_erase(mem, MEMOREE_CMD_25XX_CE, false, 0, param->chip_erase_typ_ms,
+                               param->chip_erase_max_ms ? param->chip_erase_max_ms : MEMOREE_25XX_CHIP_ERASE_MAX_MS);
+
+  while (len)
+  {
+    sfdp_erase_t best = _memoree_25xx_pick_erase(mem, addr, len);
+
+    memoree_err_t ret = _memoree_25xx_erase(mem, best.opcode, true, addr, best.typ_ms, best.max_ms);
+    if (ret != MEMOREE_ERR_OK)
+      return ret;
+
+    addr += best.size;
+    len -= best.size;
+  }
+
+  return MEMOREE_ERR_OK;
+}
+
+static memoree_err_t _memoree_erase(memoree_t mem, uint8_t erase_value)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+  int ret;
+  _memoree_cache_discard(mem, 0, mem->info.size);
+  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  {
+    if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
+
+    memoree_spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
+
+    // ERAL sets every byte to 0xFF, while WRAL writes any other value to the whole array in a single cycle
+    t.cmd_len = 5;
+    t.addr_len = mem->info.addr_len - 2;
+    if (erase_value == 0xFF)
+      t.cmd = MEMOREE_CMD_93CXX_ERAL;
+    else
+    {
+      t.cmd = MEMOREE_CMD_93CXX_WRAL;
+      t.write_len = 1;
+      t.write_buff = &erase_value;
+    }
+
+    ret = _memoree_spi_transfer(mem, &t);
+    if (ret != MEMOREE_ERR_OK)
+      return ret;
+
+    return _memoree_wait_ready(mem, 0, MEMOREE_93CXX_ERAL_MAX_MS * 1000);
+  }
+  else if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP && erase_value == 0xFF)
+    return _memoree_erase_range(mem, 0, mem->info.size);
+
+  uint32_t erase_buff_size = mem->info.page_size;
+  uint8_t erase_buff[erase_buff_size];
+  memset(erase_buff, erase_value, erase_buff_size);
+  uint16_t page = 0;
+  for (; page < mem->info.num_pages; page++)
+  {
+    int ret = _memoree_write_bytes(mem, page * erase_buff_size, erase_buff, erase_buff_size, MEMOREE_DEFAULT_TIMEOUT(mem, erase_buff_size));
+    if (ret != erase_buff_size)
+      return ret;
+
+    if ((ret = _memoree_wait_write(mem)) != MEMOREE_ERR_OK)
+      return ret;
+  }
+
+  return (page == mem->info.num_pages) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+}
+
+memoree_err_t memoree_erase(memoree_t mem, uint8_t erase_value)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  memoree_err_t ret = _memoree_erase(mem, erase_value);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_ERASE, start, 0);
+  platform_mutex_unlock(mem->lock);
+  return ret;
+}
+
+memoree_err_t memoree_erase_range(memoree_t mem, uint32_t addr, uint32_t len)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  memoree_err_t ret = _memoree_erase_range(mem, addr, len);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_ERASE, start, 0);
+  platform_mutex_unlock(mem->lock);
+  return ret;
+}
+
+memoree_err_t memoree_get_info(memoree_t mem, memoree_info_t *mem_info)
+{
+  if (!MEMOREE_ISVALID(mem) || !mem_info)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // The size, page size and address length are updated when the SFDP table is read
+  platform_mutex_lock(mem->lock);
+  mem_info->type = mem->info.type;
+  mem_info->variant = mem->info.variant;
+  mem_info->size = mem->info.size;
+  mem_info->speed = mem->info.speed;
+  mem_info->addr_len = mem->info.addr_len;
+  mem_info->addr = mem->info.addr;
+  mem_info->page_size = mem->info.page_size;
+  mem_info->num_pages = mem->info.num_pages;
+  mem_info->page_write_delay_ms = mem->info.page_write_delay_ms;
+  mem_info->wait_mode = mem->info.wait_mode;
+  mem_info->protected = mem->info.protected;
+  platform_mutex_unlock(mem->lock);
+
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t memoree_set_wait_mode(memoree_t mem, memoree_wait_mode_t mode)
+{
+  if (!MEMOREE_ISVALID(mem) || (mode != MEMOREE_WAIT_POLL && mode != MEMOREE_WAIT_DELAY))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  mem->info.wait_mode = mode;
+  platform_mutex_unlock(mem->lock);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t memoree_get_stats(memoree_t mem, memoree_stats_t *stats)
+{
+#if MEMOREE_STATS
+  if (!MEMOREE_ISVALID(mem) || !stats)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  memcpy(stats, &mem->stats, sizeof(memoree_stats_t));
+  platform_mutex_unlock(mem->lock);
+
+  return MEMOREE_ERR_OK;
+#else
+  return MEMOREE_ERR_FAIL;
+#endif
+}
+
+memoree_err_t memoree_reset_stats(memoree_t mem)
+{
+#if MEMOREE_STATS
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  memset(&mem->stats, 0, sizeof(memoree_stats_t));
+  platform_mutex_unlock(mem->lock);
+
+  return MEMOREE_ERR_OK;
+#else
+  return MEMOREE_ERR_FAIL;
+#endif
+}
+
+#if MEMOREE_STATS
+void memoree_stats_retry(memoree_interface_t interface)
+{
+  // The platform only knows its interface, which for I2C is the bus handle, so the retry is charged to the chip whose
+  // transaction holds the bus
+  for (memoree_bus_t bus = memoree_buses; bus; bus = bus->next)
+  {
+    if (bus->interface == interface && bus->active)
+      bus->active->stats.retries++;
+  }
+}
+#endif
+
+memoree_err_t memoree_protect(memoree_t mem, memoree_protection_t protection)
+{
+  if (!MEMOREE_ISVALID(mem) || mem->info.variant != MEMOREE_VARIANT_25XX_SFDP)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  return MEMOREE_ERR_FAIL;
+}
+
+static memoree_err_t _memoree_get_sfdp(memoree_t mem, sfdp_param_t *param, size_t timeout_ms)
+{
+  if (!MEMOREE_ISVALID(mem) || !param || mem->info.variant != MEMOREE_VARIANT_25XX_SFDP)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  if (mem->sfdp.header_cnt)
+  {
+    memcpy(param, &mem->sfdp, sizeof(sfdp_param_t));
+    return MEMOREE_ERR_OK;
+  }
+
+  int ret = 0;
+  memset(param, 0, sizeof(sfdp_param_t));
+
+  uint8_t read_buff[8];
+  memset(read_buff, 0xFF, sizeof(read_buff));
+
+  ret = memoree_read_sfdp(mem, 0, read_buff, sizeof(read_buff), timeout_ms);
+  if (ret < 0)
+    return MEMOREE_ERR_FAIL;
+
+  if (read_buff[0] != 'S' || read_buff[1] != 'F' || read_buff[2] != 'D' || read_buff[3] != 'P')
+    return MEMOREE_ERR_SFDP_NOT_SUPPORTED;
+
+  // Byte 7 is unused and must be 0xFF
+  if (read_buff[7] != 0xFF)
+    return MEMOREE_ERR_SFDP_INVALID_HEADER;
+
+  param->header_ver = (read_buff[5] << 8) | read_buff[4];
+  param->header_cnt = read_buff[6] + 1; // SFDP header count is zero indexed
+
+  uint8_t headers[param->header_cnt * 8];
+  memset(headers, 0xFF, sizeof(headers));
+  ret = memoree_read_sfdp(mem, sizeof(read_buff), headers, sizeof(headers), timeout_ms);
+  if (ret < 0)
+    return MEMOREE_ERR_FAIL;
+
+  // Walk all parameter headers, keeping the latest BFPT revision and the 4-byte address instruction table if present
+  sfdp_header_t bfpt = {0};
+  sfdp_header_t bait = {0};
+
+  for (uint16_t i = 0; i < param->header_cnt; i++)
+  {
+    const uint8_t *h = &headers[i * 8];
+    sfdp_header_t header = {
+        .id = (h[7] << 8) | h[0],
+        .ver = (h[2] << 8) | h[1],
+        .size = h[3] * 4,
+        .ptr = (h[6] << 16) | (h[5] << 8) | h[4],
+    };
+
+    if (i < MEMOREE_SFDP_MAX_HEADERS)
+      param->headers[i] = header;
+
+    if (header.id == MEMOREE_SFDP_ID_BFPT && (header.ver >> 8) == 1 && (!bfpt.size || header.ver > bfpt.ver))
+      bfpt = header;
+    else if (header.id == MEMOREE_SFDP_ID_4BAIT && !bait.size)
+      bait = header;
+  }
+
+  // The flash parameter table must at least contain the flash memory size (the second double word)
+  if (bfpt.size < 2 * 4)
+    return MEMOREE_ERR_SFDP_INVALID_HEADER;
+
+  param->fparam_ver = bfpt.ver;
+  param->fparam_size = bfpt.size;
+  param->fparam_ptr = bfpt.ptr;
+
+  uint8_t sfdp_table[param->fparam_size];
+  memset(sfdp_table, 0xFF, param->fparam_size);
+
+  ret = memoree_read_sfdp(mem, param->fparam_ptr, sfdp_table, sizeof(sfdp_table), timeout_ms);
+  if (ret < 0)
+    return MEMOREE_ERR_FAIL;
+
+  if (((sfdp_table[0] >> 5) & 0b111) != 0b111 || ((sfdp_table[2] >> 7) & 0b1) != 0b1 || sfdp_table[3] != 0xFF)
+    return MEMOREE_ERR_SFDP_INVALID_TABLE;
+
+  if (_sfdp_parse_bfpt(param, sfdp_table, param->fparam_size / 4) != MEMOREE_ERR_OK)
+    return MEMOREE_ERR_SFDP_INVALID_TABLE;
+
+  if (bait.size >= 2 * 4)
+  {
+    uint8_t bait_table[bait.size];
+    if (memoree_read_sfdp(mem, bait.ptr, bait_table, sizeof(bait_table), timeout_ms) < 0)
+      return MEMOREE_ERR_FAIL;
+
+    uint32_t instr = _sfdp_dword(bait_table, 1);
+    uint32_t erase_opcodes = _sfdp_dword(bait_table, 2);
+
+    param->addr4_instr = instr;
+    for (uint8_t i = 0; i < MEMOREE_SFDP_ERASE_TYPES; i++)
+      if ((instr >> (9 + i)) & 0b1)
+        param->erase[i].opcode_4b = erase_opcodes >> (i * 8);
+  }
+
+  // Parts larger than 16 MB that start in 3-byte address mode are switched to 4-byte addressing
+  if (param->addr_bytes == 3 && param->size > (1UL << 24))
+  {
+    if (param->addr4_enter & (MEMOREE_SFDP_4B_ENTER_B7 | MEMOREE_SFDP_4B_ENTER_WREN_B7))
+    {
+      memoree_spi_transaction_t t = {
+          .cmd_len = 8,
+          .cmd = MEMOREE_CMD_25XX_WREN,
+          .timeout_ms = timeout_ms,
+      };
+
+      if (param->addr4_enter & MEMOREE_SFDP_4B_ENTER_WREN_B7)
+        if (_memoree_spi_transfer(mem, &t) != MEMOREE_ERR_OK)
+          return MEMOREE_ERR_FAIL;
+
+      t.cmd = MEMOREE_CMD_25XX_EN4B;
+      if (_memoree_spi_transfer(mem, &t) != MEMOREE_ERR_OK)
+        return MEMOREE_ERR_FAIL;
+
+      param->addr_bytes = 4;
+    }
+    else
+      param->size = 1UL << 24;
+  }
+
+  mem->info.addr_len = param->addr_bytes * 8;
+  mem->info.page_size = param->page_size;
+  mem->info.size = param->size;
+  memcpy(&mem->sfdp, param, sizeof(sfdp_param_t));
+  _memoree_select_read(mem);
+
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t memoree_get_sfdp(memoree_t mem, sfdp_param_t *param, size_t timeout_ms)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  memoree_err_t ret = _memoree_get_sfdp(mem, param, timeout_ms);
+  platform_mutex_unlock(mem->lock);
+  return ret;
+}
+
+int memoree_read_sfdp(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
+{
+  if (!MEMOREE_ISVALID(mem) || !data || mem->info.variant != MEMOREE_VARIANT_25XX_SFDP)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // The SFDP area is always addressed with 3 bytes and 8 dummy cycles, regardless of the address mode of the array
+  memoree_spi_transaction_t t = {
+      .cmd_len = 8,
+      .cmd = MEMOREE_CMD_25XX_SFDP,
+      .addr_len = 24,
+      .addr = addr & 0xFFFFFF,
+      .read_len = data_len,
+      .read_buff = data,
+      .dummy_len = 8,
+      .timeout_ms = timeout_ms,
+  };
+
+  // Flash parts ignore the SFDP read while busy with a write cycle, which holding the chip's lock rules out
+  platform_mutex_lock(mem->lock);
+  int ret = _memoree_spi_transfer(mem, &t);
+  platform_mutex_unlock(mem->lock);
+
+  return (ret < 0) ? ret : (int)data_len;
+}
+
+int memoree_stub_write_read(memoree_t mem, memoree_stub_transaction_t *t)
+{
+  if (!mem || !mem->interface || !VARIANT_ISSTUB(mem->info.variant) || !t)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  int ret = 0;
+
+  platform_mutex_lock(mem->lock);
+  if (mem->info.variant == MEMOREE_VARIANT_STUB_I2C)
+    ret = _memoree_i2c_write_read(mem, (uint8_t)t->addr, t->write_buff,
+                                  t->write_len, t->read_buff, t->read_len, t->timeout_ms);
+  else
+    ret = _memoree_spi_transfer(mem, (memoree_spi_transaction_t *)t);
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
+}
+//////////////////////VERIFICATION AND CHECKSUMS
+
+/// @brief Consumer of the chunks read by _memoree_read_pipelined()
+/// @param offset Offset of \a chunk from the start of the range
+/// @return MEMOREE_ERR_OK to continue, any other value stops the read and is returned by _memoree_read_pipelined()
+typedef memoree_err_t (*memoree_chunk_fn_t)(const uint8_t *chunk, uint32_t offset, uint32_t len, void *ctx);
+
+/// @brief Read \a len bytes at \a addr in chunks passed to \a fn. On SPI, each chunk is consumed while the next one is
+///        read into the other buffer by a queued transfer, so the bus is kept busy for as long as \a fn keeps up with it.
+/// @warning \a fn runs with the bus locked and the next transfer in flight, so it must not access the bus
+/// @param chunk_size Largest number of bytes passed to \a fn at once, two chunks are buffered
+static memoree_err_t _memoree_read_pipelined(memoree_t mem, uint32_t addr, uint32_t len, uint32_t chunk_size,
+                                             memoree_chunk_fn_t fn, void *ctx)
+{
+  chunk_size = (len < chunk_size) ? len : chunk_size;
+  uint8_t *buffs = malloc(2 * chunk_size);
+  if (!buffs)
+    return MEMOREE_ERR_MEM;
+
+  bool queued = mem->info.type == MEMOREE_TYPE_SPI;
+  memoree_spi_transaction_t t[2];
+  bool in_flight = false;
+  memoree_err_t ret = MEMOREE_ERR_OK;
+
+  if (queued)
+  {
+    ret = _memoree_read_transaction(mem, addr, buffs, chunk_size, MEMOREE_DEFAULT_TIMEOUT(mem, chunk_size), &t[0]);
+    if (ret == MEMOREE_ERR_OK)
+      ret = _memoree_spi_queue(mem, &t[0]);
+    in_flight = ret == MEMOREE_ERR_OK;
+  }
+
+  uint32_t done = 0;
+  uint8_t cur = 0;
+  while (ret == MEMOREE_ERR_OK && done < len)
+  {
+    uint32_t n = (chunk_size < len - done) ? chunk_size : len - done;
+    uint8_t *buff = buffs + cur * chunk_size;
+
+    if (queued)
+    {
+      // Any result but a timeout ends the transfer and releases the bus, so it is only drained again after a timeout
+      ret = _memoree_spi_queue_result(mem, MEMOREE_JOB_DRAIN_MS);
+      in_flight = ret == MEMOREE_ERR_TIMEOUT;
+      if (ret != MEMOREE_ERR_OK)
+        break;
+
+      // Start reading the next chunk before this one is consumed
+      uint32_t next = done + n;
+      if (next < len)
+      {
+        uint32_t next_n = (chunk_size < len - next) ? chunk_size : len - next;
+        ret = _memoree_read_transaction(mem, addr + next, buffs + (cur ^ 1) * chunk_size, next_n,
+                                        MEMOREE_DEFAULT_TIMEOUT(mem, next_n), &t[cur ^ 1]);
+        if (ret == MEMOREE_ERR_OK)
+          ret = _memoree_spi_queue(mem, &t[cur ^ 1]);
+        if (ret != MEMOREE_ERR_OK)
+          break;
+        in_flight = true;
+      }
+    }
+    else
+    {
+      int read = _memoree_read(mem, addr + done, buff, n, MEMOREE_DEFAULT_TIMEOUT(mem, n));
+      if (read != (int)n)
+      {
+        ret = (read < 0) ? read : MEMOREE_ERR_FAIL;
+        break;
+      }
+    }
+
+    ret = fn(buff, done, n, ctx);
+    done += n;
+    cur ^= 1;
+  }
+
+  // The buffers cannot be released while a transfer into them may still be running, so they are leaked if it hangs
+  if (in_flight && _memoree_spi_queue_result(mem, MEMOREE_JOB_DRAIN_MS) == MEMOREE_ERR_TIMEOUT)
+    return MEMOREE_ERR_TIMEOUT;
+
+  free(buffs);
+  return ret;
+}
+
+/// @brief Expected data and first mismatch of memoree_verify()
+typedef struct
+{
+  const uint8_t *expected;
+  uint32_t mismatch; ///< Offset of the first differing byte
+} memoree_verify_ctx_t;
+
+static memoree_err_t _memoree_verify_chunk(const uint8_t *chunk, uint32_t offset, uint32_t len, void *ctx)
+{
+  memoree_verify_ctx_t *verify = ctx;
+  const uint8_t *expected = verify->expected + offset;
+  if (!memcmp(chunk, expected, len))
+    return MEMOREE_ERR_OK;
+
+  uint32_t i = 0;
+  while (chunk[i] == expected[i])
+    i++;
+
+  verify->mismatch = offset + i;
+  return MEMOREE_ERR_MISMATCH;
+}
+
+/// @brief Update the reflected, not yet inverted, \a crc with \a len bytes
+static uint32_t _memoree_crc_update(memoree_checksum_t algo, uint32_t crc, const uint8_t *p, uint32_t len)
+{
+#if defined(__ARM_FEATURE_CRC32)
+  for (; len >= 8; p += 8, len -= 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    crc = (algo == MEMOREE_CHECKSUM_CRC32C) ? __crc32cd(crc, v) : __crc32d(crc, v);
+  }
+  for (; len; p++, len--)
+    crc = (algo == MEMOREE_CHECKSUM_CRC32C) ? __crc32cb(crc, *p) : __crc32b(crc, *p);
+
+  return crc;
+#else
+#if defined(__SSE4_2__) && defined(__x86_64__)
+  // SSE4.2 only implements the Castagnoli polynomial
+  if (algo == MEMOREE_CHECKSUM_CRC32C)
+  {
+    uint64_t crc64 = crc;
+    for (; len >= 8; p += 8, len -= 8)
+    {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = crc64;
+    for (; len; p++, len--)
+      crc = _mm_crc32_u8(crc, *p);
+
+    return crc;
+  }
+#endif
+  const uint32_t(*table)[256] = crc_tables[algo];
+
+  // Eight bytes are folded in per step with independent table lookups
+  for (; len >= 8; p += 8, len -= 8)
+  {
+    uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+    crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+          table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+  }
+  for (; len; p++, len--)
+    crc = (crc >> 8) ^ table[0][(crc ^ *p) & 0xFF];
+
+  return crc;
+#endif
+}
+
+/// @brief Running checksum of memoree_checksum()
+typedef struct
+{
+  memoree_checksum_t algo;
+  uint32_t crc;
+} memoree_checksum_ctx_t;
+
+static memoree_err_t _memoree_checksum_chunk(const uint8_t *chunk, uint32_t offset, uint32_t len, void *ctx)
+{
+  memoree_checksum_ctx_t *checksum = ctx;
+  checksum->crc = _memoree_crc_update(checksum->algo, checksum->crc, chunk, len);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t memoree_verify(memoree_t mem, uint32_t addr, const uint8_t *expected, uint32_t len, uint32_t *mismatch)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !expected || !len || (uint64_t)addr + len > mem->info.size)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+
+  // The device itself is verified, so it has to hold everything written through the cache first
+  memoree_verify_ctx_t verify = {.expected = expected};
+  memoree_err_t ret = _memoree_cache_flush(mem, true);
+  if (ret == MEMOREE_ERR_OK)
+    ret = _memoree_read_pipelined(mem, addr, len, MEMOREE_PIPELINE_CHUNK, _memoree_verify_chunk, &verify);
+
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_READ, start, (ret == MEMOREE_ERR_OK) ? len : 0);
+  platform_mutex_unlock(mem->lock);
+
+  if (ret == MEMOREE_ERR_MISMATCH && mismatch)
+    *mismatch = addr + verify.mismatch;
+
+  return ret;
+}
+
+memoree_err_t memoree_checksum(memoree_t mem, uint32_t addr, uint32_t len, memoree_checksum_t algo, uint32_t *digest)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !len || (uint64_t)addr + len > mem->info.size || !digest ||
+      (algo != MEMOREE_CHECKSUM_CRC32 && algo != MEMOREE_CHECKSUM_CRC32C))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+
+  memoree_checksum_ctx_t checksum = {.algo = algo, .crc = 0xFFFFFFFF};
+  memoree_err_t ret = _memoree_cache_flush(mem, true);
+  if (ret == MEMOREE_ERR_OK)
+    ret = _memoree_read_pipelined(mem, addr, len, MEMOREE_PIPELINE_CHUNK, _memoree_checksum_chunk, &checksum);
+
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_READ, start, (ret == MEMOREE_ERR_OK) ? len : 0);
+  platform_mutex_unlock(mem->lock);
+
+  if (ret == MEMOREE_ERR_OK)
+    *digest = ~checksum.crc;
+
+  return ret;
+}
+
+//////////////////////STREAMING
+
+/// @brief Pull up to \a len bytes from \a source, calling it until \a buff is full or the source is exhausted
+/// @return Number of bytes placed in \a buff, or the error returned by \a source
+static int _memoree_stream_fill(memoree_source_cb_t source, void *ctx, uint8_t *buff, uint32_t len)
+{
+  uint32_t filled = 0;
+  while (filled < len)
+  {
+    int ret = source(buff + filled, len - filled, ctx);
+    if (ret < 0)
+      return ret;
+    if (!ret)
+      break;
+
+    filled += ((uint32_t)ret < len - filled) ? (uint32_t)ret : len - filled;
+  }
+
+  return filled;
+}
+
+/// @brief Send \a len bytes of a page to the device, starting its write cycle without waiting for it
+static memoree_err_t _memoree_program_start(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t len)
+{
+  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+  {
+    // 93CXX pages are a single byte, and write enable stays set until it is cleared
+    memoree_spi_transaction_t t = {
+        .cmd_len = 3,
+        .cmd = MEMOREE_CMD_93CXX_WRITE,
+        .addr_len = mem->info.addr_len,
+        .addr = addr,
+        .write_len = 1,
+        .write_buff = data,
+    };
+
+    return _memoree_spi_transfer(mem, &t);
+  }
+
+  int ret = _memoree_write_bytes(mem, addr, data, len, MEMOREE_DEFAULT_TIMEOUT(mem, len));
+  return (ret == (int)len) ? MEMOREE_ERR_OK : (ret < 0) ? ret : MEMOREE_ERR_FAIL;
+}
+
+static int _memoree_program_stream(memoree_t mem, uint32_t addr, memoree_source_cb_t source, memoree_progress_cb_t progress, void *ctx)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !source)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // The stream is programmed straight to the device, after anything still held by the cache
+  memoree_err_t err = _memoree_cache_flush(mem, true);
+  if (err != MEMOREE_ERR_OK)
+    return err;
+  _memoree_cache_invalidate(mem, addr, mem->info.size - addr);
+
+  if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX &&
+      _memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
+    return MEMOREE_ERR_FAIL;
+
+  // Buffers hold whole pages so that every buffer after the first starts on a page boundary
+  uint32_t page_size = mem->info.page_size;
+  uint32_t buff_size = (MEMOREE_STREAM_MIN_BUFF + page_size - 1) / page_size * page_size;
+  uint8_t *buffs = malloc(2 * buff_size);
+  if (!buffs)
+    return MEMOREE_ERR_MEM;
+
+  uint32_t left = mem->info.size - addr;
+  uint32_t first = buff_size - (addr % page_size);
+  int ret = _memoree_stream_fill(source, ctx, buffs, (first < left) ? first : left);
+  uint32_t len = (ret > 0) ? ret : 0;
+  uint32_t done = 0;
+  uint8_t cur = 0;
+
+  while (ret >= 0 && len)
+  {
+    uint8_t *buff = buffs + cur * buff_size;
+    uint32_t next_len = 0;
+    uint32_t off = 0;
+
+    while (off < len)
+    {
+      uint32_t chunk = page_size - ((addr + done) % page_size);
+      chunk = (chunk < len - off) ? chunk : len - off;
+
+      if ((err = _memoree_program_start(mem, addr + done, buff + off, chunk)) != MEMOREE_ERR_OK)
+      {
+        ret = err;
+        break;
+      }
+
+      // The next buffer is pulled from the source while the first page of this one is being programmed
+      if (!off)
+      {
+        left -= len;
+        int filled = _memoree_stream_fill(source, ctx, buffs + (cur ^ 1) * buff_size, (buff_size < left) ? buff_size : left);
+        if (filled < 0)
+          ret = filled;
+        else
+          next_len = filled;
+      }
+
+      if ((err = _memoree_wait_write(mem)) != MEMOREE_ERR_OK)
+      {
+        ret = err;
+        break;
+      }
+
+      off += chunk;
+      done += chunk;
+      if (progress)
+        progress(done, ctx);
+
+      if (ret < 0)
+        break;
+    }
+
+    len = next_len;
+    cur ^= 1;
+  }
+
+  free(buffs);
+  return (ret < 0) ? ret : (int)done;
+}
+
+int memoree_program_stream(memoree_t mem, uint32_t addr, memoree_source_cb_t source, memoree_progress_cb_t progress, void *ctx)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+  int ret = _memoree_program_stream(mem, addr, source, progress, ctx);
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_WRITE, start, ret);
+  platform_mutex_unlock(mem->lock);
+  return ret;
+}
+
+/// @brief Sink and its context passed through _memoree_read_pipelined() by memoree_dump_stream()
+typedef struct
+{
+  memoree_sink_cb_t sink;
+  void *ctx;
+} memoree_dump_ctx_t;
+
+static memoree_err_t _memoree_dump_chunk(const uint8_t *chunk, uint32_t offset, uint32_t len, void *ctx)
+{
+  memoree_dump_ctx_t *dump = ctx;
+  int ret = dump->sink(chunk, len, dump->ctx);
+  return (ret < 0) ? ret : MEMOREE_ERR_OK;
+}
+
+int memoree_dump_stream(memoree_t mem, uint32_t addr, uint32_t len, memoree_sink_cb_t sink, void *ctx, uint32_t chunk)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !len || (uint64_t)addr + len > mem->info.size || !sink)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  if (!chunk)
+  {
+    // The longest read the bus can complete in one go: a single SPI transfer, or a whole block of a 24XX part
+    if (mem->info.type == MEMOREE_TYPE_SPI)
+      chunk = ((memoree_spi_if_t *)mem->interface)->max_transfer;
+    else
+      _memoree_i2c_address(mem, addr, &chunk);
+
+    if (!chunk || chunk > MEMOREE_DUMP_MAX_CHUNK)
+      chunk = MEMOREE_DUMP_MAX_CHUNK;
+  }
+
+  platform_mutex_lock(mem->lock);
+  uint64_t start = MEMOREE_STATS_NOW();
+
+  // Dumps are read from the device, so anything still held by the cache is written out first
+  memoree_dump_ctx_t dump = {.sink = sink, .ctx = ctx};
+  memoree_err_t ret = _memoree_cache_flush(mem, true);
+  if (ret == MEMOREE_ERR_OK)
+    ret = _memoree_read_pipelined(mem, addr, len, chunk, _memoree_dump_chunk, &dump);
+
+  _memoree_stats_op(mem, MEMOREE_STATS_OP_READ, start, (ret == MEMOREE_ERR_OK) ? len : 0);
+  platform_mutex_unlock(mem->lock);
+  return (ret == MEMOREE_ERR_OK) ? (int)len : ret;
+}
+
+//////////////////////WRITE-BACK CACHE
+
+/// @brief Release the buffers of \a cache
+static void _memoree_cache_free(memoree_cache_t *cache)
+{
+  free(cache->pages);
+  free(cache->lines);
+  free(cache->fill_buff);
+  free(cache);
+}
+
+memoree_err_t memoree_cache_attach(memoree_t mem, const memoree_cache_conf_t *conf)
+{
+  if (!MEMOREE_ISVALID(mem) || !conf || (!conf->pages && !conf->read_lines) || mem->cache ||
+      (conf->read_lines && (!conf->line_size || conf->line_size > mem->info.size)))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memoree_cache_t *cache = calloc(1, sizeof(memoree_cache_t));
+  if (!cache)
+    return MEMOREE_ERR_MEM;
+
+  // The slots and their buffers are allocated in one block
+  if (conf->pages)
+  {
+    size_t slots_size = conf->pages * sizeof(memoree_cache_page_t);
+    cache->pages = calloc(1, slots_size + (size_t)conf->pages * mem->info.page_size);
+    if (!cache->pages)
+    {
+      _memoree_cache_free(cache);
+      return MEMOREE_ERR_MEM;
+    }
+
+    uint8_t *data = (uint8_t *)cache->pages + slots_size;
+    for (uint16_t i = 0; i < conf->pages; i++)
+      cache->pages[i].data = data + (size_t)i * mem->info.page_size;
+
+    cache->page_cnt = conf->pages;
+    cache->flush_after_us = (uint64_t)conf->flush_after_ms * 1000;
+  }
+
+  if (conf->read_lines)
+  {
+    // A line is filled together with the lines prefetched after it, and never more lines than the cache holds
+    uint32_t fill_lines = (conf->prefetch < conf->read_lines) ? conf->prefetch + 1 : conf->read_lines;
+    size_t slots_size = conf->read_lines * sizeof(memoree_cache_line_t);
+    cache->lines = calloc(1, slots_size + (size_t)conf->read_lines * conf->line_size);
+    cache->fill_buff = malloc((size_t)fill_lines * conf->line_size);
+    if (!cache->lines || !cache->fill_buff)
+    {
+      _memoree_cache_free(cache);
+      return MEMOREE_ERR_MEM;
+    }
+
+    uint8_t *data = (uint8_t *)cache->lines + slots_size;
+    for (uint16_t i = 0; i < conf->read_lines; i++)
+      cache->lines[i].data = data + (size_t)i * conf->line_size;
+
+    cache->line_cnt = conf->read_lines;
+    cache->line_size = conf->line_size;
+    cache->prefetch = conf->prefetch;
+    cache->next_addr = UINT32_MAX;
+  }
+
+  // Another thread may have attached a cache in the meantime
+  platform_mutex_lock(mem->lock);
+  memoree_err_t ret = mem->cache ? MEMOREE_ERR_INVALID_ARG : MEMOREE_ERR_OK;
+  if (ret == MEMOREE_ERR_OK)
+    mem->cache = cache;
+  platform_mutex_unlock(mem->lock);
+
+  if (ret != MEMOREE_ERR_OK)
+    _memoree_cache_free(cache);
+  return ret;
+}
+
+memoree_err_t memoree_cache_get_stats(memoree_t mem, memoree_cache_stats_t *stats)
+{
+  if (!MEMOREE_ISVALID(mem) || !stats)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memoree_err_t ret = MEMOREE_ERR_INVALID_ARG;
+  platform_mutex_lock(mem->lock);
+  if (mem->cache)
+  {
+    memcpy(stats, &mem->cache->stats, sizeof(memoree_cache_stats_t));
+    ret = MEMOREE_ERR_OK;
+  }
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
+}
+
+memoree_err_t memoree_cache_detach(memoree_t mem)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  memoree_err_t ret = mem->cache ? _memoree_cache_flush(mem, true) : MEMOREE_ERR_INVALID_ARG;
+  if (ret == MEMOREE_ERR_OK)
+  {
+    _memoree_cache_free(mem->cache);
+    mem->cache = NULL;
+  }
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
+}
+
+memoree_err_t memoree_flush(memoree_t mem)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  memoree_err_t ret = _memoree_cache_flush(mem, true);
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
+}
+
+memoree_err_t memoree_cache_poll(memoree_t mem)
+{
+  if (!MEMOREE_ISVALID(mem))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(mem->lock);
+  memoree_err_t ret = _memoree_cache_flush(mem, false);
+  platform_mutex_unlock(mem->lock);
+
+  return ret;
+}
+
+//////////////////////ASYNCHRONOUS OPERATIONS
+
+/// @brief Start waiting for a write or erase cycle of \a job lasting \a typ_us typically and \a max_us at most
+static void _memoree_job_wait_cycle(memoree_job_t job, uint64_t typ_us, uint64_t max_us)
+{
+  uint64_t now = platform_get_time_us();
+
+  // Polling mode skips most of long cycles like _memoree_wait_ready() does, delay mode waits for the whole cycle
+  if (job->mem->info.wait_mode == MEMOREE_WAIT_DELAY)
+    job->ready_us = now + max_us;
+  else
+    job->ready_us = now + ((typ_us >= 4000) ? typ_us * 3 / 4 : 0);
+
+  job->deadline_us = now + max_us;
+  job->cycle_us = now;
+  job->poll_interval_ms = typ_us / 16000;
+  job->state = MEMOREE_JOB_WAIT;
+}
+
+/// @brief Start the next transfer of \a job
+/// @return MEMOREE_ERR_IN_PROGRESS once a transfer has been started
+static int _memoree_job_start(memoree_job_t job)
+{
+  memoree_t mem = job->mem;
+  uint32_t addr = job->addr + job->done;
+  uint32_t left = job->len - job->done;
+  memoree_err_t err;
+
+  if (job->op == MEMOREE_JOB_READ)
+  {
+    // I2C has no queued transfers, so reads are split into short synchronous chunks
+    if (mem->info.type == MEMOREE_TYPE_I2C)
+    {
+      job->chunk = (left < MEMOREE_JOB_I2C_CHUNK) ? left : MEMOREE_JOB_I2C_CHUNK;
+      int ret = _memoree_read(mem, addr, job->data + job->done, job->chunk, MEMOREE_DEFAULT_TIMEOUT(mem, job->chunk));
+      if (ret < 0)
+        return ret;
+
+      job->done += job->chunk;
+      return MEMOREE_ERR_IN_PROGRESS;
+    }
+
+    job->chunk = left;
+    if (_memoree_read_transaction(mem, addr, job->data + job->done, left, MEMOREE_DEFAULT_TIMEOUT(mem, left), &job->t) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_INVALID_ARG;
+
+    if ((err = _memoree_spi_queue(mem, &job->t)) != MEMOREE_ERR_OK)
+      return err;
+
+    job->state = MEMOREE_JOB_PENDING;
+    return MEMOREE_ERR_IN_PROGRESS;
+  }
+
+  if (job->op == MEMOREE_JOB_ERASE && mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    const sfdp_param_t *param = &mem->sfdp;
+
+    if (job->addr == 0 && job->len == mem->info.size)
+    {
+      job->chunk = job->len;
+      err = _memoree_25xx_erase_start(mem, MEMOREE_CMD_25XX_CE, false, 0);
+      _memoree_job_wait_cycle(job, (uint64_t)param->chip_erase_typ_ms * 1000,
+                              (uint64_t)(param->chip_erase_max_ms ? param->chip_erase_max_ms : MEMOREE_25XX_CHIP_ERASE_MAX_MS) * 1000);
+    }
+    else
+    {
+      sfdp_erase_t type = _memoree_25xx_pick_erase(mem, addr, left);
+      job->chunk = type.size;
+      err = _memoree_25xx_erase_start(mem, type.opcode, true, addr);
+      _memoree_job_wait_cycle(job, (uint64_t)type.typ_ms * 1000, (uint64_t)type.max_ms * 1000);
+    }
+
+    return (err == MEMOREE_ERR_OK) ? MEMOREE_ERR_IN_PROGRESS : err;
+  }
+
+  // Writes, and erases of EEPROMs, program one page at a time
+  job->chunk = mem->info.page_size - (addr % mem->info.page_size);
+  job->chunk = (job->chunk < left) ? job->chunk : left;
+  uint8_t *src = (job->op == MEMOREE_JOB_ERASE) ? job->data : job->data + job->done;
+
+  uint64_t typ_us, max_us;
+  _memoree_write_timing(mem, &typ_us, &max_us);
+
+  if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    if (_memoree_spi_write_enable(mem) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
+
+    memset(&job->t, 0, sizeof(job->t));
+    job->t.cmd_len = 8;
+    job->t.cmd = MEMOREE_CMD_25XX_PP;
+    job->t.addr_len = mem->info.addr_len;
+    job->t.addr = addr;
+    job->t.write_len = job->chunk;
+    job->t.write_buff = src;
+    job->t.timeout_ms = MEMOREE_DEFAULT_TIMEOUT(mem, job->chunk);
+
+    if ((err = _memoree_spi_queue(mem, &job->t)) != MEMOREE_ERR_OK)
+      return err;
+
+    job->state = MEMOREE_JOB_PENDING;
+    return MEMOREE_ERR_IN_PROGRESS;
+  }
+
+  if (mem->info.type == MEMOREE_TYPE_I2C)
+  {
+    int ret = _memoree_write_bytes(mem, addr, src, job->chunk, MEMOREE_DEFAULT_TIMEOUT(mem, job->chunk));
+    if (ret < 0)
+      return ret;
+  }
+  else
+  {
+    // 93CXX pages are a single byte, and write enable was set when the job was created
+    memoree_spi_transaction_t t = {
+        .cmd_len = 3,
+        .cmd = MEMOREE_CMD_93CXX_WRITE,
+        .addr_len = mem->info.addr_len,
+        .addr = addr,
+        .write_len = 1,
+        .write_buff = src,
+    };
+
+    if ((err = _memoree_spi_transfer(mem, &t)) != MEMOREE_ERR_OK)
+      return err;
+  }
+
+  _memoree_job_wait_cycle(job, typ_us, max_us);
+  return MEMOREE_ERR_IN_PROGRESS;
+}
+
+/// @brief Advance \a job as far as possible without starting more than one transfer
+/// @param block_ms Time a queued transfer may be waited for
+static int _memoree_job_run(memoree_job_t job, uint32_t block_ms)
+{
+  while (job->state != MEMOREE_JOB_DONE)
+  {
+    int ret = MEMOREE_ERR_OK;
+
+    switch (job->state)
+    {
+    case MEMOREE_JOB_START:
+      if (job->done == job->len)
+        ret = (job->op == MEMOREE_JOB_ERASE) ? MEMOREE_ERR_OK : (int)job->len;
+      else
+        ret = _memoree_job_start(job);
+      break;
+
+    case MEMOREE_JOB_PENDING:
+      ret = _memoree_spi_queue_result(job->mem, block_ms);
+      if (ret == MEMOREE_ERR_TIMEOUT)
+        return MEMOREE_ERR_IN_PROGRESS;
+      if (ret != MEMOREE_ERR_OK)
+        break;
+
+      if (job->op == MEMOREE_JOB_READ)
+      {
+        job->done += job->chunk;
+        job->state = MEMOREE_JOB_START;
+      }
+      else
+      {
+        uint64_t typ_us, max_us;
+        _memoree_write_timing(job->mem, &typ_us, &max_us);
+        _memoree_job_wait_cycle(job, typ_us, max_us);
+      }
+      continue;
+
+    case MEMOREE_JOB_WAIT:
+    {
+      uint64_t now = platform_get_time_us();
+      if (now < job->ready_us)
+        return MEMOREE_ERR_IN_PROGRESS;
+
+      bool ready = job->mem->info.wait_mode == MEMOREE_WAIT_DELAY;
+      if (!ready && (ret = _memoree_poll_ready(job->mem, &ready)) != MEMOREE_ERR_OK)
+        break;
+
+      if (!ready)
+      {
+        if (now < job->deadline_us)
+          return MEMOREE_ERR_IN_PROGRESS;
+        ret = MEMOREE_ERR_TIMEOUT;
+        MEMOREE_STATS_ADD(job->mem, timeouts, 1);
+        MEMOREE_STATS_ADD(job->mem, wait_us, now - job->cycle_us);
+        break;
+      }
+
+      MEMOREE_STATS_ADD(job->mem, wait_us, now - job->cycle_us);
+
+      // The page can only be read back once the device has left its write cycle, and before the next one starts
+      if (job->readback && job->op == MEMOREE_JOB_WRITE)
+      {
+        ret = _memoree_read(job->mem, job->addr + job->done, job->readback, job->chunk, MEMOREE_DEFAULT_TIMEOUT(job->mem, job->chunk));
+        if (ret < 0)
+          break;
+        if (memcmp(job->readback, job->data + job->done, job->chunk))
+        {
+          ret = MEMOREE_ERR_MISMATCH;
+          break;
+        }
+      }
+
+      job->done += job->chunk;
+      job->state = MEMOREE_JOB_START;
+      continue;
+    }
+
+    default:
+      break;
+    }
+
+    if (ret == MEMOREE_ERR_IN_PROGRESS)
+      return ret;
+
+    job->result = ret;
+    job->state = MEMOREE_JOB_DONE;
+    memoree_stats_op_t op = (job->op == MEMOREE_JOB_READ)    ? MEMOREE_STATS_OP_READ
+                            : (job->op == MEMOREE_JOB_WRITE) ? MEMOREE_STATS_OP_WRITE
+                                                             : MEMOREE_STATS_OP_ERASE;
+    _memoree_stats_op(job->mem, op, job->start_us, ret);
+    if (job->cb)
+      job->cb(job, job->result, job->cb_arg);
+  }
+
+  return job->result;
+}
+
+/// @brief Allocate a job running \a op on \a mem
+static memoree_job_t _memoree_job_new(memoree_t mem, memoree_job_op_t op, uint32_t addr, uint8_t *data, uint32_t len,
+                                      memoree_job_cb_t cb, void *arg)
+{
+  platform_mutex_lock(mem->lock);
+
+  // Jobs access the device directly, so it has to hold everything written through the cache first
+  memoree_err_t err = _memoree_cache_flush(mem, true);
+  if (err == MEMOREE_ERR_OK && op != MEMOREE_JOB_READ)
+  {
+    _memoree_cache_invalidate(mem, addr, len);
+
+    // 93CXX write enable stays set until it is cleared, so it is set once for the whole job
+    if (mem->info.variant > MEMOREE_VARIANT_I2C_MAX && mem->info.variant < MEMOREE_VARIANT_93CXX_MAX)
+      err = _memoree_spi_write_enable(mem);
+  }
+
+  platform_mutex_unlock(mem->lock);
+  if (err != MEMOREE_ERR_OK)
+    return NULL;
+
+  memoree_job_t job = calloc(1, sizeof(struct memoree_job));
+  if (!job)
+    return NULL;
+
+  job->mem = mem;
+  job->op = op;
+  job->start_us = MEMOREE_STATS_NOW();
+  job->state = MEMOREE_JOB_START;
+  job->addr = addr;
+  job->data = data;
+  job->len = len;
+  job->cb = cb;
+  job->cb_arg = arg;
+
+  return job;
+}
+
+memoree_job_t memoree_read_async(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, memoree_job_cb_t cb, void *arg)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data || !data_len || (uint64_t)addr + data_len > mem->info.size)
+    return NULL;
+
+  return _memoree_job_new(mem, MEMOREE_JOB_READ, addr, data, data_len, cb, arg);
+}
+
+memoree_job_t memoree_write_async(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, memoree_job_cb_t cb, void *arg)
+{
+  if (!MEMOREE_ISVALID(mem) || !ADDRESS_ISVALID(mem, addr) || !data || !data_len || (uint64_t)addr + data_len > mem->info.size)
+    return NULL;
+
+  return _memoree_job_new(mem, MEMOREE_JOB_WRITE, addr, data, data_len, cb, arg);
+}
+
+memoree_job_t memoree_erase_async(memoree_t mem, uint32_t addr, uint32_t len, memoree_job_cb_t cb, void *arg)
+{
+  if (!MEMOREE_ISVALID(mem) || !len || (uint64_t)addr + len > mem->info.size)
+    return NULL;
+
+  if (mem->info.variant == MEMOREE_VARIANT_25XX_SFDP)
+  {
+    if (!mem->sfdp.min_sector || addr % mem->sfdp.min_sector || len % mem->sfdp.min_sector)
+      return NULL;
+
+    return _memoree_job_new(mem, MEMOREE_JOB_ERASE, addr, NULL, len, cb, arg);
+  }
+
+  // EEPROMs are erased by writing pages of 0xFF, kept with the job
+  uint8_t *fill = malloc(mem->info.page_size);
+  if (!fill)
+    return NULL;
+  memset(fill, 0xFF, mem->info.page_size);
+
+  memoree_job_t job = _memoree_job_new(mem, MEMOREE_JOB_ERASE, addr, fill, len, cb, arg);
+  if (!job)
+    free(fill);
+
+  return job;
+}
+
+int memoree_job_poll(memoree_job_t job)
+{
+  if (!job)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_lock(job->mem->lock);
+  int ret = _memoree_job_run(job, 0);
+  platform_mutex_unlock(job->mem->lock);
 
   return ret;
-}
\ No newline at end of file
+}
+
+int memoree_job_wait(memoree_job_t job, size_t timeout_ms)
+{
+  if (!job)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint64_t deadline = platform_get_time_us() + (uint64_t)timeout_ms * 1000;
+
+  while (true)
+  {
+    uint64_t now = platform_get_time_us();
+    uint32_t left_ms = (now < deadline) ? (deadline - now + 999) / 1000 : 0;
+
+    // The chip is only held while the job advances, not while it sleeps
+    platform_mutex_lock(job->mem->lock);
+    int ret = _memoree_job_run(job, left_ms);
+    platform_mutex_unlock(job->mem->lock);
+    if (ret != MEMOREE_ERR_IN_PROGRESS)
+      return ret;
+
+    now = platform_get_time_us();
+    if (now >= deadline)
+      return MEMOREE_ERR_TIMEOUT;
+
+    // Sleep through the part of the cycle in which the device cannot be ready yet, then poll at the job's interval
+    if (job->state == MEMOREE_JOB_WAIT)
+    {
+      uint64_t wake = (now < job->ready_us) ? job->ready_us : now + (uint64_t)job->poll_interval_ms * 1000;
+      wake = (wake < deadline) ? wake : deadline;
+      if (wake > now)
+        platform_ms_delay((wake - now + 999) / 1000);
+    }
+  }
+}
+
+memoree_err_t memoree_job_free(memoree_job_t job)
+{
+  if (!job)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // The queued transaction lives in the job, so it has to complete before the job is released
+  if (job->state == MEMOREE_JOB_PENDING &&
+      _memoree_spi_queue_result(job->mem, MEMOREE_JOB_DRAIN_MS) == MEMOREE_ERR_TIMEOUT)
+    return MEMOREE_ERR_TIMEOUT;
+
+  if (job->op == MEMOREE_JOB_ERASE)
+    free(job->data);
+  free(job->readback);
+  free(job);
+
+  return MEMOREE_ERR_OK;
+}
+
+//////////////////////MULTI-DEVICE WRITES
+
+/// @brief Complete the queued transfers of the jobs in \a jobs other than \a skip that are holding \a bus
+/// @note A queued transfer keeps its chip selected until it completes, so anything sent to another chip on the same bus
+///       in the meantime would be clocked into it
+static void _memoree_schedule_drain(memoree_job_t *jobs, size_t n, size_t skip, memoree_bus_t bus)
+{
+  for (size_t j = 0; j < n; j++)
+  {
+    memoree_job_t job = jobs[j];
+    if (j == skip || !job || job->mem->bus != bus)
+      continue;
+
+    // A job that finds its device ready straight away queues its next page, which is completed as well
+    uint32_t done = UINT32_MAX;
+    platform_mutex_lock(job->mem->lock);
+    while (job->state == MEMOREE_JOB_PENDING && job->done != done)
+    {
+      done = job->done;
+      _memoree_job_run(job, MEMOREE_JOB_DRAIN_MS);
+    }
+    platform_mutex_unlock(job->mem->lock);
+  }
+}
+
+/// @brief Lock every distinct valid device of \a reqs, listed in \a held
+/// @note Devices are locked in address order so that concurrent schedules over overlapping sets of devices cannot deadlock
+/// @return Number of devices locked
+static size_t _memoree_schedule_lock(memoree_write_req_t *reqs, size_t n, memoree_t *held)
+{
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!MEMOREE_ISVALID(reqs[i].mem))
+      continue;
+
+    size_t j = count;
+    while (j && (uintptr_t)held[j - 1] > (uintptr_t)reqs[i].mem)
+      j--;
+    if (j && held[j - 1] == reqs[i].mem)
+      continue;
+
+    memmove(&held[j + 1], &held[j], (count - j) * sizeof(memoree_t));
+    held[j] = reqs[i].mem;
+    count++;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    platform_mutex_lock(held[i]->lock);
+
+  return count;
+}
+
+/// @brief Run the writes in \a reqs as interleaved asynchronous jobs until all of them have completed
+/// @param verify Read back every page once its write cycle has completed
+static int _memoree_write_schedule(memoree_write_req_t *reqs, size_t n, bool verify)
+{
+  memoree_job_t *jobs = calloc(n, sizeof(memoree_job_t));
+  memoree_t *held = calloc(n, sizeof(memoree_t));
+  if (!jobs || !held)
+  {
+    free(jobs);
+    free(held);
+    return MEMOREE_ERR_MEM;
+  }
+
+  // Every device is held for the whole schedule, as for any other call, so that no other thread gets to a device
+  // between the polls of its job. The locks are recursive, so the jobs still take them as usual.
+  size_t locked = _memoree_schedule_lock(reqs, n, held);
+
+  // MEMOREE_ERR_IN_PROGRESS marks the writes that have not completed yet, started or not
+  for (size_t i = 0; i < n; i++)
+    reqs[i].result = MEMOREE_ERR_IN_PROGRESS;
+
+  size_t running = n;
+  while (running)
+  {
+    memoree_job_t pending = NULL;
+    uint64_t now = platform_get_time_us();
+    uint64_t wake = UINT64_MAX;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      if (reqs[i].result != MEMOREE_ERR_IN_PROGRESS)
+        continue;
+
+      if (!jobs[i])
+      {
+        // A device runs one job at a time, so a write waits for the earlier ones to the same device
+        size_t j = 0;
+        while (j < i && (reqs[j].mem != reqs[i].mem || reqs[j].result != MEMOREE_ERR_IN_PROGRESS))
+          j++;
+        if (j < i)
+          continue;
+      }
+
+      // Nothing can be sent on the bus while another chip's transfer is still open on it
+      if (MEMOREE_ISVALID(reqs[i].mem))
+        _memoree_schedule_drain(jobs, n, i, reqs[i].mem->bus);
+
+      if (!jobs[i])
+      {
+        jobs[i] = memoree_write_async(reqs[i].mem, reqs[i].addr, reqs[i].data, reqs[i].len, NULL, NULL);
+        if (!jobs[i])
+          reqs[i].result = MEMOREE_ERR_INVALID_ARG;
+        else if (verify && !(jobs[i]->readback = malloc(reqs[i].mem->info.page_size)))
+          reqs[i].result = MEMOREE_ERR_MEM;
+      }
+
+      int ret = (reqs[i].result == MEMOREE_ERR_IN_PROGRESS) ? memoree_job_poll(jobs[i]) : reqs[i].result;
+      if (ret != MEMOREE_ERR_IN_PROGRESS)
+      {
+        // Finished jobs are released straight away so that the next write to the same device can start
+        reqs[i].result = ret;
+        if (jobs[i])
+          memoree_job_free(jobs[i]);
+        jobs[i] = NULL;
+        running--;
+        continue;
+      }
+
+      if (jobs[i]->state == MEMOREE_JOB_WAIT)
+      {
+        uint64_t next = (now < jobs[i]->ready_us) ? jobs[i]->ready_us : now + (uint64_t)jobs[i]->poll_interval_ms * 1000;
+        wake = (next < wake) ? next : wake;
+      }
+      else
+        wake = now;
+    }
+
+    if (!running)
+      break;
+
+    // Jobs that were pending when polled may since have been drained by a later job on the same bus
+    for (size_t i = 0; i < n && !pending; i++)
+      if (jobs[i] && jobs[i]->state == MEMOREE_JOB_PENDING)
+        pending = jobs[i];
+
+    // Nothing can advance until either a queued transfer or the earliest write cycle completes. Devices that may be
+    // ready already are polled again straight away, as memoree_write() does.
+    if (pending)
+    {
+      platform_mutex_lock(pending->mem->lock);
+      _memoree_job_run(pending, MEMOREE_JOB_DRAIN_MS);
+      platform_mutex_unlock(pending->mem->lock);
+    }
+    else
+    {
+      now = platform_get_time_us();
+      if (wake > now)
+        platform_ms_delay((wake - now + 999) / 1000);
+    }
+  }
+
+  for (size_t i = locked; i > 0; i--)
+    platform_mutex_unlock(held[i - 1]->lock);
+
+  free(jobs);
+  free(held);
+
+  int completed = 0;
+  for (size_t i = 0; i < n; i++)
+    completed += (reqs[i].result >= 0) ? 1 : 0;
+
+  return completed;
+}
+
+int memoree_write_multi(memoree_write_req_t *reqs, size_t n)
+{
+  if (!reqs || !n)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  return _memoree_write_schedule(reqs, n, false);
+}
+
+int memoree_gang_program(memoree_t *devs, size_t n, uint32_t addr, const uint8_t *image, uint32_t len, memoree_err_t *status)
+{
+  if (!devs || !n || !image || !len || !status)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memoree_write_req_t *reqs = calloc(n, sizeof(memoree_write_req_t));
+  if (!reqs)
+    return MEMOREE_ERR_MEM;
+
+  // The image is only read by the jobs, memoree_write_async() just doesn't promise so
+  for (size_t i = 0; i < n; i++)
+    reqs[i] = (memoree_write_req_t){.mem = devs[i], .addr = addr, .data = (uint8_t *)image, .len = len};
+
+  int programmed = _memoree_write_schedule(reqs, n, true);
+  for (size_t i = 0; programmed >= 0 && i < n; i++)
+    status[i] = (reqs[i].result < 0) ? reqs[i].result : MEMOREE_ERR_OK;
+
+  free(reqs);
+  return programmed;
+}
+
+//////////////////////VOLUMES
+
+/// @brief Returns the member of a concatenated or striped \a vol holding volume address \a addr
+/// @param member_addr Set to the address of \a addr on the member
+/// @param run Set to the number of bytes from \a addr on that are held by the member in one piece
+static size_t _memoree_volume_map(memoree_volume_t vol, uint32_t addr, uint32_t *member_addr, uint32_t *run)
+{
+  if (vol->info.layout == MEMOREE_VOLUME_STRIPE)
+  {
+    uint32_t stripe = addr / vol->info.page_size;
+    uint32_t offset = addr % vol->info.page_size;
+
+    *member_addr = (stripe / vol->info.members) * vol->info.page_size + offset;
+    *run = vol->info.page_size - offset;
+    return stripe % vol->info.members;
+  }
+
+  size_t m = 0;
+  while (addr - vol->members[m].base >= vol->members[m].size)
+    m++;
+
+  *member_addr = addr - vol->members[m].base;
+  *run = vol->members[m].size - *member_addr;
+  return m;
+}
+
+/// @brief Run the member writes gathered in \a reqs
+/// @return MEMOREE_ERR_OK if all of them succeeded, or the error code of the first that failed
+static int _memoree_volume_flush(memoree_write_req_t *reqs, size_t cnt)
+{
+  int ret = _memoree_write_schedule(reqs, cnt, false);
+  for (size_t i = 0; ret >= 0 && i < cnt; i++)
+    if (reqs[i].result < 0)
+      return reqs[i].result;
+
+  return (ret < 0) ? ret : MEMOREE_ERR_OK;
+}
+
+memoree_volume_t memoree_volume_init(memoree_volume_layout_t layout, memoree_t *members, size_t n)
+{
+  if (layout > MEMOREE_VOLUME_MIRROR || !members || !n)
+    return NULL;
+
+  memoree_volume_t vol = calloc(1, sizeof(struct memoree_volume) + n * sizeof(vol->members[0]));
+  if (!vol)
+    return NULL;
+
+  vol->lock = platform_mutex_create();
+  if (!vol->lock)
+    goto fail;
+
+  vol->info.layout = layout;
+  vol->info.members = n;
+
+  uint64_t size = 0;
+  uint32_t min_size = UINT32_MAX;
+  for (size_t i = 0; i < n; i++)
+  {
+    memoree_info_t info;
+    if (memoree_get_info(members[i], &info) != MEMOREE_ERR_OK || !info.size || !info.page_size)
+      goto fail;
+
+    // Stripes are one page long, so a page written to any member never spans two of its pages
+    if (layout == MEMOREE_VOLUME_STRIPE && i && info.page_size != vol->info.page_size)
+      goto fail;
+
+    vol->members[i].mem = members[i];
+    vol->members[i].base = (uint32_t)size;
+    vol->members[i].size = info.size;
+
+    size += info.size;
+    min_size = (info.size < min_size) ? info.size : min_size;
+    vol->info.page_size = (info.page_size > vol->info.page_size) ? info.page_size : vol->info.page_size;
+  }
+
+  if (layout == MEMOREE_VOLUME_STRIPE)
+    size = (uint64_t)(min_size - min_size % vol->info.page_size) * n;
+  else if (layout == MEMOREE_VOLUME_MIRROR)
+    size = min_size;
+
+  if (size > UINT32_MAX)
+    goto fail;
+
+  vol->info.size = (uint32_t)size;
+  return vol;
+
+fail:
+  if (vol->lock)
+    platform_mutex_delete(vol->lock);
+  free(vol);
+  return NULL;
+}
+
+memoree_err_t memoree_volume_deinit(memoree_volume_t vol)
+{
+  if (!vol)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  platform_mutex_delete(vol->lock);
+  free(vol);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t memoree_volume_get_info(memoree_volume_t vol, memoree_volume_info_t *info)
+{
+  if (!vol || !info)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memcpy(info, &vol->info, sizeof(memoree_volume_info_t));
+  return MEMOREE_ERR_OK;
+}
+
+int memoree_volume_read(memoree_volume_t vol, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms)
+{
+  if (!vol || !data || !data_len || (uint64_t)addr + data_len > vol->info.size)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  if (vol->info.layout == MEMOREE_VOLUME_MIRROR)
+  {
+    // A replica whose lock is taken is in the middle of another call, e.g. waiting for a write cycle, so the read goes to
+    // the next one that is free, or waits for the first one tried if none is. Writes to the volume hold all replicas
+    // until every one of them has completed its last cycle.
+    platform_mutex_lock(vol->lock);
+    size_t first = vol->next_replica % vol->info.members;
+    size_t m = first;
+    bool locked = false;
+    for (size_t i = 0; i < vol->info.members && !locked; i++)
+    {
+      m = (first + i) % vol->info.members;
+      locked = platform_mutex_trylock(vol->members[m].mem->lock);
+    }
+
+    m = locked ? m : first;
+    vol->next_replica = m + 1;
+    platform_mutex_unlock(vol->lock);
+
+    if (!locked)
+      platform_mutex_lock(vol->members[m].mem->lock);
+
+    int ret = memoree_read(vol->members[m].mem, addr, data, data_len, timeout_ms);
+    platform_mutex_unlock(vol->members[m].mem->lock);
+    return ret;
+  }
+
+  uint32_t done = 0;
+  while (done < data_len)
+  {
+    uint32_t member_addr, run;
+    size_t m = _memoree_volume_map(vol, addr + done, &member_addr, &run);
+    run = (run < data_len - done) ? run : data_len - done;
+
+    int ret = memoree_read(vol->members[m].mem, member_addr, data + done, run, timeout_ms);
+    if (ret < 0)
+      return ret;
+
+    done += run;
+  }
+
+  return data_len;
+}
+
+int memoree_volume_write(memoree_volume_t vol, uint32_t addr, uint8_t *data, uint32_t data_len)
+{
+  if (!vol || !data || !data_len || (uint64_t)addr + data_len > vol->info.size)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memoree_write_req_t reqs[MEMOREE_VOLUME_BATCH];
+  size_t cnt = 0;
+  int ret;
+
+  if (vol->info.layout == MEMOREE_VOLUME_MIRROR)
+  {
+    for (size_t m = 0; m < vol->info.members; m++)
+    {
+      reqs[cnt++] = (memoree_write_req_t){.mem = vol->members[m].mem, .addr = addr, .data = data, .len = data_len};
+      if (cnt == MEMOREE_VOLUME_BATCH || m == vol->info.members - 1)
+      {
+        if ((ret = _memoree_volume_flush(reqs, cnt)) != MEMOREE_ERR_OK)
+          return ret;
+        cnt = 0;
+      }
+    }
+
+    return data_len;
+  }
+
+  // Striped writes are gathered into one request per page, which the scheduler runs in order on each member
+  uint32_t done = 0;
+  while (done < data_len)
+  {
+    uint32_t member_addr, run;
+    size_t m = _memoree_volume_map(vol, addr + done, &member_addr, &run);
+    run = (run < data_len - done) ? run : data_len - done;
+
+    reqs[cnt++] = (memoree_write_req_t){.mem = vol->members[m].mem, .addr = member_addr, .data = data + done, .len = run};
+    done += run;
+
+    if (cnt == MEMOREE_VOLUME_BATCH || done == data_len)
+    {
+      if ((ret = _memoree_volume_flush(reqs, cnt)) != MEMOREE_ERR_OK)
+        return ret;
+      cnt = 0;
+    }
+  }
+
+  return data_len;
+}
+
+memoree_err_t memoree_volume_erase(memoree_volume_t vol, uint8_t erase_value)
+{
+  if (!vol)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  for (size_t m = 0; m < vol->info.members; m++)
+  {
+    memoree_err_t ret = memoree_erase(vol->members[m].mem, erase_value);
+    if (ret != MEMOREE_ERR_OK)
+      return ret;
+  }
+
+  return MEMOREE_ERR_OK;
+}
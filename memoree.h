@@ -5,6 +5,21 @@
  * @file    memoree.h
  * @author  skuodi
  * @date
+ *
+ * @par Thread safety
+ * Every memoree_*() call on a memory object holds that object's lock for its whole duration, write and erase cycles
+ * included, so concurrent calls on the same object run one after the other. The bus the object is attached to is only
+ * locked for each bus transaction, so calls on other objects sharing the bus go ahead while a write or erase cycle is
+ * in progress, and objects on different buses never wait for each other. Callbacks run on the calling thread with the
+ * object's lock held. Completion and progress callbacks are called between transactions and may call back into the same
+ * object. The source of memoree_program_stream() runs while the device is in a write cycle, so it must not access the
+ * object, and the sink of memoree_dump_stream() runs while the transfer of the next chunk holds the bus, so it must not
+ * access the object or any other object on its bus.
+ * @par
+ * memoree_init(), memoree_deinit(), memoree_bus_init() and memoree_bus_deinit() must not be called concurrently with
+ * each other, and an object must not be used by other threads while it is being deinitialized. An asynchronous job
+ * keeps its bus locked while a queued transfer is in flight, so it must be polled, waited for and freed by a single
+ * thread, which must not access other objects on the same bus until the job has completed.
  */
 
 #include <stdint.h>
@@ -14,6 +29,13 @@
 #define MEMOREE_VERSION_MAJOR 0
 #define MEMOREE_VERSION_MINOR 1
 
+/// Set to 0 to compile out the counters and latency histograms reported by memoree_get_stats()
+#ifndef MEMOREE_STATS
+#define MEMOREE_STATS 1
+#endif
+
+#define MEMOREE_STATS_BUCKETS 24 ///< Number of log2 latency buckets, the last one also counts every longer operation
+
 #define MEMOREE_I2C_BASE_ADDRESS ((0b1010 << 3) & 0xFF)
 
 #define MEMOREE_I2C_MAX_SPEED 400000
@@ -36,9 +58,13 @@
 #define MEMOREE_CMD_25XX_RDSR 0x05 ///< Read Status Register
 #define MEMOREE_CMD_25XX_WRSR 0x01 ///< Write Status Register
 #define MEMOREE_CMD_25XX_READ 0x03 ///< Read Data from Memory Array
+#define MEMOREE_CMD_25XX_FAST_READ 0x0B ///< Read Data from Memory Array at higher speed, with 8 dummy cycles
 #define MEMOREE_CMD_25XX_PP 0x02   ///< Program Data Into Memory Array
 #define MEMOREE_CMD_25XX_RDID 0x9F ///< Read Manufacturer and Product ID
 #define MEMOREE_CMD_25XX_SFDP 0x5A ///< Read JEDEC serial flash discovery parameters
+#define MEMOREE_CMD_25XX_EWSR 0x50 ///< Enable Write to the volatile Status Register
+#define MEMOREE_CMD_25XX_EN4B 0xB7 ///< Enter 4-byte address mode
+#define MEMOREE_CMD_25XX_CE 0xC7   ///< Erase the whole memory array
 
 typedef enum
 {
@@ -50,6 +76,8 @@ typedef enum
   MEMOREE_ERR_SFDP_NOT_SUPPORTED = -5,  ///< SPI flash does not support SFDP
   MEMOREE_ERR_SFDP_INVALID_HEADER = -6, ///< SPI flash SFDP header is corrupted
   MEMOREE_ERR_SFDP_INVALID_TABLE = -7,  ///< SPI flash SFDP flash parameter table is corrupted
+  MEMOREE_ERR_IN_PROGRESS = -8,         ///< Asynchronous operation has not completed yet
+  MEMOREE_ERR_MISMATCH = -9,            ///< Memory contents differ from the expected data
 } memoree_err_t;
 
 typedef void *memoree_interface_t;
@@ -82,25 +110,105 @@ typedef enum
   MEMOREE_VARIANT_MAX,
 } memoree_variant_t;
 
-/// @brief Information extracted from the Serial Flash Discovery Parameters table of an SFDP-capable SPI flash memory
+#define MEMOREE_SFDP_MAX_HEADERS 8    ///< Number of parameter headers kept in sfdp_param_t, further headers are ignored
+#define MEMOREE_SFDP_ERASE_TYPES 4    ///< Number of erase types described by the basic flash parameter table
+#define MEMOREE_SFDP_ID_BFPT 0xFF00   ///< Parameter ID of the JEDEC Basic Flash Parameter Table
+#define MEMOREE_SFDP_ID_4BAIT 0xFF84  ///< Parameter ID of the JEDEC 4-Byte Address Instruction Table
+
+#define MEMOREE_SFDP_4BAIT_READ (1 << 0)      ///< 4-byte address Read (13h) supported
+#define MEMOREE_SFDP_4BAIT_FAST_READ (1 << 1) ///< 4-byte address Fast Read (0Ch) supported
+#define MEMOREE_SFDP_4BAIT_READ_112 (1 << 2)  ///< 4-byte address 1-1-2 Fast Read (3Ch) supported
+#define MEMOREE_SFDP_4BAIT_READ_122 (1 << 3)  ///< 4-byte address 1-2-2 Fast Read (BCh) supported
+#define MEMOREE_SFDP_4BAIT_READ_114 (1 << 4)  ///< 4-byte address 1-1-4 Fast Read (6Ch) supported
+#define MEMOREE_SFDP_4BAIT_READ_144 (1 << 5)  ///< 4-byte address 1-4-4 Fast Read (ECh) supported
+#define MEMOREE_SFDP_4BAIT_PP (1 << 6)        ///< 4-byte address Page Program (12h) supported
+
+#define MEMOREE_SFDP_4B_ENTER_B7 (1 << 0)      ///< 4-byte mode is entered with B7h
+#define MEMOREE_SFDP_4B_ENTER_WREN_B7 (1 << 1) ///< 4-byte mode is entered with WREN followed by B7h
+#define MEMOREE_SFDP_4B_ALWAYS (1 << 6)        ///< The part always operates with 4-byte addresses
+
+/// @brief Settings of an SFDP fast read instruction
+typedef struct
+{
+  uint8_t opcode;       ///< Instruction, 0 if the read mode is not supported
+  uint8_t mode_clocks;  ///< Number of mode bit clocks following the address
+  uint8_t dummy_cycles; ///< Number of wait state clocks following the mode bits
+} sfdp_read_t;
+
+/// @brief An erase instruction advertised in the basic flash parameter table
+typedef struct
+{
+  uint32_t size;     ///< Size of the erased region in bytes, 0 if the erase type is not supported
+  uint8_t opcode;    ///< Instruction
+  uint8_t opcode_4b; ///< Instruction taking a 4-byte address from the 4-byte address instruction table, 0 if none
+  uint32_t typ_ms;   ///< Typical erase time (ms), 0 if not specified
+  uint32_t max_ms;   ///< Maximum erase time (ms), 0 if not specified
+} sfdp_erase_t;
+
+/// @brief A parameter header of the SFDP area, describing a JEDEC or vendor parameter table
 typedef struct
 {
-  uint16_t header_ver;    ///< SFDP Header version (MAJOR(15:8) | MINOR(7:0))
-  uint8_t header_cnt;     ///< Number of parameter headers
-  uint16_t fparam_ver;    ///< SFDP Flash parameters version (MAJOR(15:8) | MINOR(7:0))
-  uint16_t fparam_size;   ///< Flash parameter table size in bytes
-  uint32_t fparam_ptr;    ///< Flash parameter table memory location for use with the SFDP read command
-  uint8_t write_size;     ///< Write Granularity
-  uint8_t wen_opcode;     ///< Write Enable Opcode Select for Writing to Volatile Status Register
-  uint8_t erase4k_opcode; ///< 4 Kilobyte Erase Opcode
-  uint8_t addr_bytes;     ///< Number of bytes used in addressing flash array read, write and erase
-  bool dtr_support;       ///< Whether double transfer rate is supported
-  uint8_t min_sector;     ///< Minimum erasable sector size
-  uint8_t min_sec_opcode; ///< Opcode to erase minimum erasable sector
-  uint8_t max_sector;     ///< Maximum erasable sector size
-  uint8_t max_sec_opcode; ///< Opcode to erase maximum erasable sector
-  uint64_t size;          ///< Flash memory size in bytes
+  uint16_t id;   ///< Parameter ID (MSB(15:8) | LSB(7:0)), vendor tables are identified by their JEP106 manufacturer ID
+  uint16_t ver;  ///< Table version (MAJOR(15:8) | MINOR(7:0))
+  uint16_t size; ///< Table size in bytes
+  uint32_t ptr;  ///< Table location for use with the SFDP read command
+} sfdp_header_t;
+
+/// @brief Quad Enable requirements of the basic flash parameter table (DWORD 15 bits 22:20)
+typedef enum
+{
+  MEMOREE_SFDP_QE_NONE,             ///< No Quad Enable bit, or it cannot be described
+  MEMOREE_SFDP_QE_SR2_BIT1,         ///< Bit 1 of status register 2, written along with status register 1 by 01h. Writing one byte to 01h clears it
+  MEMOREE_SFDP_QE_SR1_BIT6,         ///< Bit 6 of status register 1, written by 01h
+  MEMOREE_SFDP_QE_SR2_BIT7,         ///< Bit 7 of status register 2, read by 3Fh and written by 3Eh
+  MEMOREE_SFDP_QE_SR2_BIT1_NOCLEAR, ///< Bit 1 of status register 2, written along with status register 1 by 01h
+  MEMOREE_SFDP_QE_SR2_BIT1_RD35,    ///< Bit 1 of status register 2, read by 35h and written along with status register 1 by 01h
+  MEMOREE_SFDP_QE_SR2_BIT1_WR31,    ///< Bit 1 of status register 2, read by 35h and written by 31h
+} sfdp_qe_t;
 
+/// @brief Information extracted from the Serial Flash Discovery Parameters table of an SFDP-capable SPI flash memory
+typedef struct
+{
+  uint16_t header_ver;                             ///< SFDP Header version (MAJOR(15:8) | MINOR(7:0))
+  uint16_t header_cnt;                             ///< Number of parameter headers
+  sfdp_header_t headers[MEMOREE_SFDP_MAX_HEADERS]; ///< The first header_cnt parameter headers, including vendor tables
+  uint16_t fparam_ver;                             ///< SFDP Flash parameters version (MAJOR(15:8) | MINOR(7:0))
+  uint16_t fparam_size;                            ///< Flash parameter table size in bytes
+  uint32_t fparam_ptr;                             ///< Flash parameter table memory location for use with the SFDP read command
+  uint8_t write_size;                              ///< Write Granularity
+  uint8_t wen_opcode;                              ///< Write Enable Opcode Select for Writing to Volatile Status Register
+  uint8_t erase4k_opcode;                          ///< 4 Kilobyte Erase Opcode
+  uint8_t addr_bytes;                              ///< Number of bytes used in addressing flash array read, write and erase
+  bool dtr_support;                                ///< Whether double transfer rate is supported
+  uint32_t min_sector;                             ///< Minimum erasable sector size in bytes
+  uint8_t min_sec_opcode;                          ///< Opcode to erase minimum erasable sector
+  uint32_t max_sector;                             ///< Maximum erasable sector size in bytes
+  uint8_t max_sec_opcode;                          ///< Opcode to erase maximum erasable sector
+  uint64_t size;                                   ///< Flash memory size in bytes
+  uint16_t page_size;                              ///< Page program size in bytes, 256 if not specified
+  uint32_t pp_typ_us;                              ///< Typical page program time (us), 0 if not specified
+  uint32_t pp_max_us;                              ///< Maximum page program time (us), 0 if not specified
+  uint32_t erase4k_typ_ms;                         ///< Typical 4 Kilobyte erase time (ms), 0 if not specified
+  uint32_t erase4k_max_ms;                         ///< Maximum 4 Kilobyte erase time (ms), 0 if not specified
+  uint32_t chip_erase_typ_ms;                      ///< Typical chip erase time (ms), 0 if not specified
+  uint32_t chip_erase_max_ms;                      ///< Maximum chip erase time (ms), 0 if not specified
+  sfdp_erase_t erase[MEMOREE_SFDP_ERASE_TYPES];    ///< Erase types 1 to 4, in table order
+  sfdp_read_t read_112;                            ///< 1-1-2 Dual Output Fast Read
+  sfdp_read_t read_122;                            ///< 1-2-2 Dual I/O Fast Read
+  sfdp_read_t read_114;                            ///< 1-1-4 Quad Output Fast Read
+  sfdp_read_t read_144;                            ///< 1-4-4 Quad I/O Fast Read
+  sfdp_read_t read_222;                            ///< 2-2-2 Dual Fast Read
+  sfdp_read_t read_444;                            ///< 4-4-4 Quad Fast Read
+  sfdp_read_t read_118;                            ///< 1-1-8 Octal Output Fast Read (JESD216C)
+  sfdp_read_t read_188;                            ///< 1-8-8 Octal I/O Fast Read (JESD216C)
+  bool suspend_support;                            ///< Whether program and erase operations can be suspended
+  uint8_t program_suspend_opcode;                  ///< Program Suspend instruction
+  uint8_t program_resume_opcode;                   ///< Program Resume instruction
+  uint8_t erase_suspend_opcode;                    ///< Erase Suspend instruction
+  uint8_t erase_resume_opcode;                     ///< Erase Resume instruction
+  sfdp_qe_t qe;                                    ///< How the Quad Enable bit is set, for parts that need one for quad reads
+  uint8_t addr4_enter;                             ///< Supported ways of entering 4-byte address mode (MEMOREE_SFDP_4B_* bits)
+  uint32_t addr4_instr;                            ///< Instructions of the 4-byte address instruction table (MEMOREE_SFDP_4BAIT_* bits), 0 if absent
 } sfdp_param_t;
 
 /// @brief Supported peripheral interfaces
@@ -110,26 +218,33 @@ typedef enum
   MEMOREE_TYPE_SPI
 } memoree_type_t;
 
+/// @brief Bus shared by several memory ICs, see memoree_bus_init()
+typedef struct memoree_bus *memoree_bus_t;
+
 typedef struct
 {
-  int port;       ///< Platform-specific identifier for the I2C peripheral used
-  uint32_t speed; ///< Interface speed in Hz
-  int sda_pin;    ///< Data pin
-  int scl_pin;    ///< Clock pin
-  uint8_t addr;   ///< Memory IC I2C 7-bit address
+  int port;          ///< Platform-specific identifier for the I2C peripheral used
+  uint32_t speed;    ///< Interface speed in Hz
+  int sda_pin;       ///< Data pin
+  int scl_pin;       ///< Clock pin
+  uint8_t addr;      ///< Memory IC I2C 7-bit address
+  memoree_bus_t bus; ///< Bus to attach to, or NULL to use the bus of \a port. Only \a addr is used when set.
 } memoree_i2c_conf_t;
 
 typedef struct
 {
-  int port;       ///< Platform-specific identifier for the SPI peripheral used
-  uint32_t speed; ///< Interface speed in Hz
-  int do_pin;     ///< Controller data out pin
-  int sck_pin;    ///< Clock pin
-  int di_pin;     ///< Controller data in pin
-  int cs_pin;     ///< Chip select pin
-  int hd_pin;     ///< Hold pin, used as ORG pin for 93CXX
-  int wp_pin;     ///< Write protect pin
-  int mode;       ///< SPI mode
+  int port;              ///< Platform-specific identifier for the SPI peripheral used
+  uint32_t speed;        ///< Interface speed in Hz
+  int do_pin;            ///< Controller data out pin
+  int sck_pin;           ///< Clock pin
+  int di_pin;            ///< Controller data in pin
+  int cs_pin;            ///< Chip select pin
+  int hd_pin;            ///< Hold pin, used as ORG pin for 93CXX and as IO3 for quad reads on 25XX
+  int wp_pin;            ///< Write protect pin, used as IO2 for quad reads on 25XX
+  int mode;              ///< SPI mode
+  bool dma;              ///< Whether to move data with DMA, on platforms that support it
+  uint32_t max_transfer; ///< Largest single bus transfer in bytes, 0 for the platform default. Longer transactions are split with chip select kept asserted
+  memoree_bus_t bus;     ///< Bus to attach to, or NULL to use the bus of \a port. Only \a cs_pin, \a speed, \a mode and \a max_transfer are used when set.
 } memoree_spi_conf_t;
 
 /// @brief SPI transaction descriptor
@@ -139,12 +254,14 @@ typedef struct
   uint32_t cmd;      ///< Command sent MSB first
   uint8_t addr_len;  ///< Address length in bits
   uint32_t addr;     ///< Address, sent MSB first
-  uint8_t dummy_len; ///< Dummy length in bits
+  uint8_t dummy_len; ///< Dummy length in clock cycles (equal to bits when sent on a single line)
   uint32_t read_len; ///< Read length in bytes
   uint8_t *read_buff;
   uint32_t write_len; ///< Write length in bytes
   uint8_t *write_buff;
   uint32_t timeout_ms; ///< Timeout for the transaction in ms
+  uint8_t addr_lines;  ///< Number of lines (1, 2 or 4) used in the address and dummy phases, 0 is treated as 1
+  uint8_t data_lines;  ///< Number of lines (1, 2 or 4) used in the data phase, 0 is treated as 1
 } memoree_spi_transaction_t;
 
 typedef memoree_spi_transaction_t memoree_stub_transaction_t;
@@ -156,22 +273,136 @@ typedef enum
   MEMOREE_PROTECTION_WRITE,
 } memoree_protection_t;
 
+/// @brief Methods of waiting for the internal write or erase cycle of a memory IC to complete
+typedef enum
+{
+  MEMOREE_WAIT_POLL,  ///< Poll the device (I2C acknowledge, 93CXX ready/busy, 25XX status register) until the cycle completes, bounded by the maximum cycle time
+  MEMOREE_WAIT_DELAY, ///< Sleep for the maximum cycle time given in the datasheet
+} memoree_wait_mode_t;
+
+/// @brief Checksum algorithms supported by memoree_checksum()
+typedef enum
+{
+  MEMOREE_CHECKSUM_CRC32,  ///< CRC-32 as used by Ethernet and zlib, reflected polynomial 0xEDB88320
+  MEMOREE_CHECKSUM_CRC32C, ///< CRC-32C (Castagnoli) as used by iSCSI and ext4, reflected polynomial 0x82F63B78
+} memoree_checksum_t;
+
 /// @brief Memoree object
 typedef struct memoree *memoree_t;
 
+/// @brief Handle of an asynchronous read, write or erase
+typedef struct memoree_job *memoree_job_t;
+
+/// @brief Completion callback of an asynchronous operation, called from memoree_job_poll() or memoree_job_wait()
+/// @param result Number of bytes read or written, MEMOREE_ERR_OK for erases, or \link memoree_err_t \endlink error code
+/// @warning The job must not be freed from within the callback
+typedef void (*memoree_job_cb_t)(memoree_job_t job, int result, void *arg);
+
+/// @brief One of the writes run together by memoree_write_multi()
+typedef struct
+{
+  memoree_t mem;  ///< Device to write to
+  uint32_t addr;  ///< Start address of the write, which does not wrap around the end of the memory
+  uint8_t *data;  ///< Data to write, which must remain valid until memoree_write_multi() returns
+  uint32_t len;   ///< Number of bytes to write
+  int result;     ///< Set to the number of bytes written, or to the \link memoree_err_t \endlink error code of the write
+} memoree_write_req_t;
+
+/// @brief Layouts of a volume composed of several devices
+typedef enum
+{
+  MEMOREE_VOLUME_CONCAT, ///< Members follow each other in the order given
+  MEMOREE_VOLUME_STRIPE, ///< Consecutive pages go to consecutive members, so their write cycles overlap
+  MEMOREE_VOLUME_MIRROR, ///< Every member holds a copy of the volume
+} memoree_volume_layout_t;
+
+/// @brief Volume object
+typedef struct memoree_volume *memoree_volume_t;
+
+/// @brief Geometry of a volume
+typedef struct
+{
+  memoree_volume_layout_t layout; ///< Layout the volume was initialized with
+  size_t members;                 ///< Number of member devices
+  uint32_t size;                  ///< Size of the volume in bytes
+  uint16_t page_size;             ///< Largest page size of the members, and the stripe size of MEMOREE_VOLUME_STRIPE
+} memoree_volume_info_t;
+
+/// @brief Supplies the image programmed by memoree_program_stream(), e.g. from a file, a UART or a decompressor
+/// @warning The source runs while the device is programming a page, so it must not access the device
+/// @return Number of bytes placed in \a buff, at most \a len, 0 at the end of the image, or a negative error code
+typedef int (*memoree_source_cb_t)(uint8_t *buff, uint32_t len, void *ctx);
+
+/// @brief Consumes the data read by memoree_dump_stream(), e.g. by writing it to a file, a socket or a hash engine
+/// @note \a data is only valid until the sink returns
+/// @warning On SPI the sink runs while the transfer of the next chunk holds the bus, so it must not access the device or
+///          any other object on its bus, and a slow sink holds up the other objects on the bus
+/// @return 0 or a positive value to continue, or a negative error code to stop the dump
+typedef int (*memoree_sink_cb_t)(const uint8_t *data, uint32_t len, void *ctx);
+
+/// @brief Reports the number of bytes a streaming operation has completed so far
+typedef void (*memoree_progress_cb_t)(uint32_t done, void *ctx);
+
+/// @brief Configuration of the caches attached with memoree_cache_attach()
+typedef struct
+{
+  uint16_t pages;          ///< Number of dirty pages held by the write-back cache, each \a page_size bytes of memoree_info_t long, 0 to disable it
+  uint32_t flush_after_ms; ///< Age after which a dirty page is written back by the next write or memoree_cache_poll(), 0 to hold it until flushed or evicted
+  uint16_t read_lines;     ///< Number of lines held by the read cache, 0 to disable it
+  uint16_t line_size;      ///< Size of a read cache line in bytes. Reads of a line or more go straight to the device.
+  uint8_t prefetch;        ///< Lines read ahead, in the same transaction, when a miss continues a sequential read
+} memoree_cache_conf_t;
+
+/// @brief Read cache counters, reset by memoree_cache_attach()
+typedef struct
+{
+  uint32_t hits;          ///< Lines read from the cache
+  uint32_t misses;        ///< Lines read from the device on demand
+  uint32_t prefetches;    ///< Lines read ahead of a sequential reader
+  uint32_t prefetch_hits; ///< Prefetched lines later read from the cache
+} memoree_cache_stats_t;
+
+/// @brief Operation types whose latencies are kept by memoree_get_stats()
+typedef enum
+{
+  MEMOREE_STATS_OP_READ,  ///< Reads, verifications, checksums and dumps
+  MEMOREE_STATS_OP_WRITE, ///< Writes, including differential, streaming and asynchronous ones
+  MEMOREE_STATS_OP_ERASE, ///< Page, range and whole memory erases
+  MEMOREE_STATS_OP_MAX,
+} memoree_stats_op_t;
+
+/// @brief Performance counters of a device, reset by memoree_reset_stats()
+typedef struct
+{
+  uint64_t bytes_read;        ///< Bytes returned by reads, verifications, checksums and dumps
+  uint64_t bytes_written;     ///< Bytes passed to writes that succeeded
+  uint32_t transactions;      ///< Bus transactions, not counting ready polls
+  uint64_t bus_us;            ///< Time spent in those transactions, counted from the moment the bus was acquired
+  uint64_t wait_us;           ///< Time spent waiting for write and erase cycles to complete, including polls and sleeps
+  uint64_t sleep_us;          ///< Part of \a wait_us spent sleeping in platform_ms_delay()
+  uint32_t polls;             ///< Ready polls that found the device still busy
+  uint32_t retries;           ///< Transactions repeated by the platform because the device did not acknowledge them
+  uint32_t timeouts;          ///< Transactions and write or erase cycles that timed out
+  uint32_t errors;            ///< Transactions that failed other than by timing out
+  uint32_t ops[MEMOREE_STATS_OP_MAX]; ///< Operations of each type run, failed ones included
+  uint32_t latency[MEMOREE_STATS_OP_MAX][MEMOREE_STATS_BUCKETS]; ///< Operations of each type that took from 2^i up to
+                                                                  ///< 2^(i+1) microseconds, in bucket i
+} memoree_stats_t;
+
 /// @brief Configuration information for a \link memoree_t \endlink object
 typedef struct
 {
-  memoree_type_t type;         ///< Serial interface type
-  memoree_variant_t variant;   ///< Part number
-  uint32_t size;               ///< Size in bytes, must be a power of 2
-  uint32_t speed;              ///< Interface speed
-  uint8_t addr_len;            ///< Number of bits used in the address phase of a read/write operation
-  uint8_t addr;                ///< 7-bit address (for I2C ICs)
-  uint16_t page_size;          ///< Page size in bytes
-  uint16_t num_pages;          ///< Number of pages
-  uint8_t page_write_delay_ms; ///< Maximum page write time (ms)
-  bool protected;              ///< Whether write protection is enabled
+  memoree_type_t type;           ///< Serial interface type
+  memoree_variant_t variant;     ///< Part number
+  uint32_t size;                 ///< Size in bytes, must be a power of 2
+  uint32_t speed;                ///< Interface speed
+  uint8_t addr_len;              ///< Number of bits used in the address phase of a read/write operation
+  uint8_t addr;                  ///< 7-bit address (for I2C ICs)
+  uint16_t page_size;            ///< Page size in bytes
+  uint16_t num_pages;            ///< Number of pages
+  uint8_t page_write_delay_ms;   ///< Maximum page write time (ms)
+  memoree_wait_mode_t wait_mode; ///< How write and erase operations wait for the internal write cycle to complete
+  bool protected;                ///< Whether write protection is enabled
 } memoree_info_t;
 
 // FUNCTIONS
@@ -185,11 +416,27 @@ typedef struct
 memoree_t memoree_init(memoree_variant_t variant, void *interface_conf);
 
 /// @brief  Frees dynamically allocated resources and optionally deinitializes the interface attached to the memory object
-/// @param  deinit Whether to deinitialize the peripheral interface that the memory device is attached to
+/// @param  deinit Whether to detach the memory IC from its bus. The bus itself is only deinitialized once nothing else uses it.
 memoree_err_t memoree_deinit(memoree_t mem, bool deinit);
 
+/// @brief Initialize a bus that several memory ICs are then attached to with the \a bus member of their configuration,
+///        each with its own chip select or address
+/// @note Buses are reference counted. Calling this function for a port that is already initialized returns the
+///       existing bus, and memoree_init() with a NULL \a bus attaches to the bus of its port the same way. A bus is
+///       deinitialized once memoree_bus_deinit() has been called for every memoree_bus_init() and every memory IC
+///       attached to it has been deinitialized.
+/// @param type MEMOREE_TYPE_I2C or MEMOREE_TYPE_SPI
+/// @param bus_conf memoree_i2c_conf_t or memoree_spi_conf_t object containing the port and pin settings. For SPI, the
+///        speed, mode and chip select are those of each memory IC and are ignored here.
+/// @return Bus object on success
+/// @return NULL on failure
+memoree_bus_t memoree_bus_init(memoree_type_t type, void *bus_conf);
+
+/// @brief Release the reference taken by memoree_bus_init()
+memoree_err_t memoree_bus_deinit(memoree_bus_t bus);
+
 /// @brief Detect the presence of a functional chip connected to the initialized interface.
-/// @brief For I2C chips, checks for acknowledgement. For SFDP ICs, checks for a valid SFDP table.
+/// @brief For I2C chips, checks for acknowledgement. For SFDP ICs, reads back the signature of the SFDP header.
 memoree_err_t memoree_ping(memoree_t mem, size_t timeout_ms);
 
 /// @brief Reads one byte from the memory location specified by \a addr
@@ -209,6 +456,35 @@ int memoree_read(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len,
 /// @return \link memoree_err_t \endlink error code, on fail
 int memoree_write(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, bool wrap);
 
+/// @brief Write \a data_len bytes starting at \a addr like memoree_write(), but read each page back first and only
+///        program the pages whose contents differ
+/// @note A 25XX page can only be programmed without an erase if the update clears bits and never sets any. The write
+///       stops with MEMOREE_ERR_FAIL at the first differing page that would need to be erased first.
+/// @param programmed Optional, set to the number of pages actually programmed, also on failure
+/// @return Number of bytes written or found already up to date, on success
+/// @return \link memoree_err_t \endlink error code, on fail
+int memoree_write_diff(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms, uint32_t *programmed);
+
+/// @brief Program an image pulled from \a source starting at \a addr, one page per write cycle, until \a source reports
+///        its end or the end of the memory is reached
+/// @note Data is staged in two page-aligned buffers, and the next buffer is pulled from \a source while the device is
+///       busy programming the current one, so the time spent in \a source is hidden behind the write cycles
+/// @param progress Optional, called after every page with the number of bytes programmed so far
+/// @param ctx Passed to \a source and \a progress
+/// @return Number of bytes programmed, on success
+/// @return \link memoree_err_t \endlink error code, or the error returned by \a source, on fail
+int memoree_program_stream(memoree_t mem, uint32_t addr, memoree_source_cb_t source, memoree_progress_cb_t progress, void *ctx);
+
+/// @brief Read \a len bytes starting at \a addr and pass them to \a sink in chunks of up to \a chunk bytes
+/// @note Chunks are read into two buffers. On SPI, the next chunk is read by a queued transfer while \a sink consumes the
+///       current one, so the bus is kept busy for as long as \a sink keeps up with it. See memoree_sink_cb_t for what
+///       \a sink must not do.
+/// @param chunk Chunk size in bytes, or 0 to use the longest read the bus completes in a single transfer
+/// @param ctx Passed to \a sink
+/// @return Number of bytes passed to \a sink, on success
+/// @return \link memoree_err_t \endlink error code, or the error returned by \a sink, on fail
+int memoree_dump_stream(memoree_t mem, uint32_t addr, uint32_t len, memoree_sink_cb_t sink, void *ctx, uint32_t chunk);
+
 /// @brief Provides transparent access to transfer data directly over the underlying protocol.
 /// @note mem must have been memoree_init() 'd as a MEMOREE_VARIANT_STUB_SPI or MEMOREE_VARIANT_STUB_I2C.
 /// @note For I2C, the device address is extracted from the LSByte of the \a addr member of memoree_stub_transaction_t,
@@ -221,15 +497,165 @@ memoree_err_t memoree_erase_page(memoree_t mem, uint32_t page, uint8_t erase_val
 /// @brief Write \a erase_value to all bytes in memory
 memoree_err_t memoree_erase(memoree_t mem, uint8_t erase_value);
 
+/// @brief Erase \a len bytes starting at \a addr with the fewest erase instructions advertised by the device's SFDP table
+/// @note Only supported by MEMOREE_VARIANT_25XX_SFDP. \a addr and \a len must be multiples of the smallest erase type
+///       (\a min_sector of sfdp_param_t). Erasing the whole array uses a single chip erase.
+memoree_err_t memoree_erase_range(memoree_t mem, uint32_t addr, uint32_t len);
+
+/// @brief Compare \a len bytes starting at \a addr against \a expected, stopping at the first difference
+/// @note The device is read in chunks and, on SPI, the next chunk is read while the current one is compared
+/// @param mismatch Optional, set to the address of the first differing byte
+/// @return MEMOREE_ERR_OK if the contents match, MEMOREE_ERR_MISMATCH if they do not
+memoree_err_t memoree_verify(memoree_t mem, uint32_t addr, const uint8_t *expected, uint32_t len, uint32_t *mismatch);
+
+/// @brief Compute the \a algo checksum of \a len bytes starting at \a addr into \a digest
+/// @note The device is read in chunks and, on SPI, the next chunk is read while the current one is hashed. The CPU's
+///       CRC instructions are used when the compiler targets them (ARMv8 CRC32, x86 SSE4.2 for CRC-32C), and slicing-by-8
+///       tables otherwise.
+memoree_err_t memoree_checksum(memoree_t mem, uint32_t addr, uint32_t len, memoree_checksum_t algo, uint32_t *digest);
+
 /// @brief Returns the current configuration information of the memory object
 memoree_err_t memoree_get_info(memoree_t mem, memoree_info_t *mem_info);
 
+/// @brief Selects how write and erase operations on \a mem wait for the internal write cycle to complete
+/// @note Devices are initialized with MEMOREE_WAIT_POLL
+memoree_err_t memoree_set_wait_mode(memoree_t mem, memoree_wait_mode_t mode);
+
 /// @brief Enables memory protection if the \link memoree_variant_t \endlink supports it
 /// @warning NOT YET IMPLEMENTED.
 /// @param protect Type of memory protection to enforce
 memoree_err_t memoree_protect(memoree_t mem, memoree_protection_t protect);
 
 /// @brief  Read serial flash description parameter information and populate the properties of the corresponding memoree object
+/// @note The parameters are read once by memoree_init() and later calls return that copy without accessing the bus
 memoree_err_t memoree_get_sfdp(memoree_t mem, sfdp_param_t *param, size_t timeout_ms);
 
-#endif
\ No newline at end of file
+/// @brief Reads \a data_len bytes of the SFDP area starting at \a addr, e.g. a vendor table listed in sfdp_param_t
+/// @return Number of bytes read, on success
+/// @return \link memoree_err_t \endlink error code, on fail
+int memoree_read_sfdp(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms);
+
+/// @brief Start reading \a data_len bytes at \a addr into \a data without blocking
+/// @note Asynchronous operations advance one bus transfer per memoree_job_poll() call. SPI transfers are queued with
+///       platform_spi_queue() so the CPU is free while they run, I2C reads are split into short synchronous chunks.
+///       No other operation may be run on \a mem until the job has completed, see the thread safety notes above.
+/// @param cb Optional completion callback
+/// @return Job handle to be freed with memoree_job_free(), on success
+/// @return NULL, on failure
+memoree_job_t memoree_read_async(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, memoree_job_cb_t cb, void *arg);
+
+/// @brief Start writing \a data_len bytes from \a data at \a addr without blocking, one page per write cycle
+/// @note The write does not wrap around the end of the memory. \a data must remain valid until the job has completed.
+/// @return Job handle to be freed with memoree_job_free(), on success
+/// @return NULL, on failure
+memoree_job_t memoree_write_async(memoree_t mem, uint32_t addr, uint8_t *data, uint32_t data_len, memoree_job_cb_t cb, void *arg);
+
+/// @brief Start erasing \a len bytes at \a addr without blocking
+/// @note SFDP flash is erased as in memoree_erase_range(), EEPROMs are written with 0xFF one page at a time
+/// @return Job handle to be freed with memoree_job_free(), on success
+/// @return NULL, on failure
+memoree_job_t memoree_erase_async(memoree_t mem, uint32_t addr, uint32_t len, memoree_job_cb_t cb, void *arg);
+
+/// @brief Advance \a job without blocking on the device's write or erase cycles
+/// @return MEMOREE_ERR_IN_PROGRESS while the job is running, the job's result once it has completed
+int memoree_job_poll(memoree_job_t job);
+
+/// @brief Run \a job until it completes or \a timeout_ms elapses, sleeping while the device is busy
+/// @return MEMOREE_ERR_TIMEOUT if the job is still running, the job's result otherwise
+int memoree_job_wait(memoree_job_t job, size_t timeout_ms);
+
+/// @brief Release \a job, waiting for a queued transfer of an unfinished job to complete first
+memoree_err_t memoree_job_free(memoree_job_t job);
+
+/// @brief Run the \a n writes in \a reqs together, sending the next page to whichever device has finished its last one
+/// @note Every write is run as an asynchronous write advanced from the calling thread, and every device is polled for the
+///       end of its write cycle, so while one device is in its cycle the bus carries the pages of the others. Up to eight
+///       24XX parts sharing an I2C bus through their A0-A2 pins are written at close to the bus bandwidth instead of one
+///       page per write cycle. Writes to the same device are run one after the other, in the order given.
+/// @note Every device in \a reqs is locked for the whole call, so calls on them from other threads wait until all the
+///       writes have completed.
+/// @return Number of writes completed, on success
+/// @return \link memoree_err_t \endlink error code, on fail
+int memoree_write_multi(memoree_write_req_t *reqs, size_t n);
+
+/// @brief Write the same \a len bytes of \a image at \a addr of each of the \a n devices in \a devs, reading back every page
+/// @note The devices are programmed as in memoree_write_multi(), so the transfers to one device run while the others are
+///       in their write cycles, and each page is read back once its cycle completes. Synchronous I2C transfers are not
+///       overlapped with each other, so with many I2C devices the total time is bound by their combined transfer time
+///       instead of the write cycles. As with memoree_write(), flash has to be erased beforehand.
+/// @param status Array of \a n entries, set to MEMOREE_ERR_OK for every device that was programmed and verified, and to
+///               the \link memoree_err_t \endlink error code of the write or MEMOREE_ERR_MISMATCH otherwise
+/// @return Number of devices programmed and verified, on success
+/// @return \link memoree_err_t \endlink error code, on fail
+int memoree_gang_program(memoree_t *devs, size_t n, uint32_t addr, const uint8_t *image, uint32_t len, memoree_err_t *status);
+
+/// @brief Compose the \a n devices in \a members into a single address space laid out as \a layout
+/// @note The geometry of every member is taken from memoree_get_info(). Concatenated volumes are as large as all their
+///       members, striped volumes are as large as their smallest member times \a n, and mirrored volumes are as large as
+///       their smallest member. Striped members must all have the same page size.
+/// @note The members stay usable on their own and are not deinitialized with the volume. A volume is as thread safe as
+///       its members, but writes to it are not atomic across members. Reads of a mirrored volume go to a replica that
+///       is not in use by another call, so asynchronous jobs, which do not hold their device between polls, must not be
+///       run directly on its members while it is read.
+/// @return Volume object, on success
+/// @return NULL, on failure
+memoree_volume_t memoree_volume_init(memoree_volume_layout_t layout, memoree_t *members, size_t n);
+
+/// @brief Release \a vol, leaving its members initialized
+memoree_err_t memoree_volume_deinit(memoree_volume_t vol);
+
+/// @brief Returns the geometry of \a vol
+memoree_err_t memoree_volume_get_info(memoree_volume_t vol, memoree_volume_info_t *info);
+
+/// @brief Read \a data_len bytes at \a addr of \a vol into \a data
+/// @note Mirrored volumes are read from the first member, starting from the one after the member used by the previous
+///       read, that no other thread is using at the moment
+/// @return Number of bytes read, on success
+/// @return \link memoree_err_t \endlink error code, on fail
+int memoree_volume_read(memoree_volume_t vol, uint32_t addr, uint8_t *data, uint32_t data_len, size_t timeout_ms);
+
+/// @brief Write \a data_len bytes from \a data at \a addr of \a vol, without wrapping around the end of the volume
+/// @note The parts of the write that fall on different members are run together as in memoree_write_multi(), so each
+///       member is sent its next page while the others are in their write cycles
+/// @return Number of bytes written, on success
+/// @return \link memoree_err_t \endlink error code of the first failed part, on fail
+int memoree_volume_write(memoree_volume_t vol, uint32_t addr, uint8_t *data, uint32_t data_len);
+
+/// @brief Write \a erase_value to all bytes of every member of \a vol, as memoree_erase() does
+memoree_err_t memoree_volume_erase(memoree_volume_t vol, uint8_t erase_value);
+
+/// @brief Returns the performance counters of \a mem
+/// @note Operations are timed from the moment they acquire the device, asynchronous ones until they complete
+/// @return MEMOREE_ERR_FAIL if the library was built with MEMOREE_STATS set to 0
+memoree_err_t memoree_get_stats(memoree_t mem, memoree_stats_t *stats);
+
+/// @brief Clear the performance counters of \a mem
+/// @return MEMOREE_ERR_FAIL if the library was built with MEMOREE_STATS set to 0
+memoree_err_t memoree_reset_stats(memoree_t mem);
+
+/// @brief Attach a write-back cache, a read cache, or both to \a mem
+/// @note With the write-back cache, memoree_write() and memoree_write_byte() modify pages held in RAM and each dirty page
+///       is programmed once, in full, instead of on every call. Dirty pages are written back by memoree_flush(), when
+///       their slot is needed for another page, and by the next write or memoree_cache_poll() once they are older than
+///       \a flush_after_ms of \a conf. Reads return the cached contents of dirty pages and never write any back.
+///       Erases discard the dirty pages they cover, and asynchronous operations flush the cache before they start.
+/// @note The read cache keeps the least recently used lines of reads shorter than a line. Writes and erases invalidate
+///       the lines they cover.
+/// @warning Data held in the write-back cache is lost if power fails before it is flushed
+memoree_err_t memoree_cache_attach(memoree_t mem, const memoree_cache_conf_t *conf);
+
+/// @brief Returns the read cache counters of \a mem
+memoree_err_t memoree_cache_get_stats(memoree_t mem, memoree_cache_stats_t *stats);
+
+/// @brief Flush and release the caches of \a mem
+/// @note The cache stays attached if the flush fails
+memoree_err_t memoree_cache_detach(memoree_t mem);
+
+/// @brief Program every dirty page held in the write-back cache of \a mem
+memoree_err_t memoree_flush(memoree_t mem);
+
+/// @brief Program the dirty pages of \a mem that are older than the cache's \a flush_after_ms
+/// @note Call periodically, e.g. from an idle loop, so that pages are written back on time while the device is not used
+memoree_err_t memoree_cache_poll(memoree_t mem);
+
+#endif
@@ -6,16 +6,20 @@
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "driver/spi_master.h"
+#include "soc/soc_caps.h"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "memoree_platform.h"
 #include "../memoree.h"
 
 #define MAX(x, y) ((x > y) ? x : y)
+#define MIN(x, y) ((x < y) ? x : y)
 
 #define MEMOREE_PLATFORM_I2C_MAX_SPEED 1000000
 #define MEMOREE_PLATFORM_SPI_MAX_SPEED 40000000
+#define MEMOREE_PLATFORM_SPI_DMA_TRANSFER 4092 ///< Default largest DMA transfer, the size of a single DMA descriptor
 
 #define I2C_RW_READ 0x01   ///< I2C RW bit read mode
 #define I2C_RW_WRITE 0x00  ///< I2C RW bit write mode
@@ -24,60 +28,132 @@
 #define I2C_ACK 0x00       ///< I2C ack value
 #define I2C_NACK 0x01      ///< I2C nack value
 
+/// @brief SPI bus state returned by platform_spi_bus_init()
+typedef struct
+{
+  spi_host_device_t port;
+  uint32_t max_transfer; ///< Largest transfer the bus was initialized for
+  bool quad;             ///< Whether the WP and HD pins are routed to the bus as IO2 and IO3
+  bool owned;            ///< Whether the bus was initialized here, rather than by the application beforehand
+} espidf_spi_bus_t;
+
+/// @brief SPI device state stored in the \a dev_handle member of memoree_spi_if_t
+typedef struct
+{
+  spi_device_handle_t handle;          ///< Full duplex device used for single line transactions
+  spi_device_handle_t hd_handle;       ///< Half duplex device used for dual and quad transactions, NULL if unavailable
+  spi_transaction_ext_t queued;        ///< Bus transfer in flight for platform_spi_queue(), which must outlive the call
+  spi_device_handle_t queued_handle;   ///< Device \a queued was queued on, NULL if none is pending
+  memoree_spi_transaction_t *queued_t; ///< Transaction passed to platform_spi_queue()
+  uint32_t queued_off;                 ///< Offset of the data phase of \a queued_t sent by \a queued
+  uint32_t queued_len;                 ///< Length of the data phase of \a queued_t sent by \a queued
+} espidf_spi_dev_t;
+
 void platform_ms_delay(uint32_t ms)
 {
   vTaskDelay(pdMS_TO_TICKS(ms));
 }
 
+uint64_t platform_get_time_us(void)
+{
+  return esp_timer_get_time();
+}
+
+memoree_mutex_t platform_mutex_create(void)
+{
+  return xSemaphoreCreateRecursiveMutex();
+}
+
+void platform_mutex_delete(memoree_mutex_t mutex)
+{
+  if (mutex)
+    vSemaphoreDelete(mutex);
+}
+
+void platform_mutex_lock(memoree_mutex_t mutex)
+{
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+}
+
+bool platform_mutex_trylock(memoree_mutex_t mutex)
+{
+  return xSemaphoreTakeRecursive(mutex, 0) == pdTRUE;
+}
+
+void platform_mutex_unlock(memoree_mutex_t mutex)
+{
+  xSemaphoreGiveRecursive(mutex);
+}
+
 /// I2C functions
-memoree_interface_t platform_i2c_init(memoree_i2c_conf_t *i2c_conf)
+memoree_interface_t platform_i2c_bus_init(memoree_i2c_conf_t *bus_conf)
 {
-  if (!i2c_conf || i2c_conf->port >= SOC_I2C_NUM || i2c_conf->speed > MEMOREE_PLATFORM_I2C_MAX_SPEED)
+  if (!bus_conf || bus_conf->port >= SOC_I2C_NUM || bus_conf->speed > MEMOREE_PLATFORM_I2C_MAX_SPEED)
     return NULL;
 
   i2c_config_t config = {
       .mode = I2C_MODE_MASTER,
-      .sda_io_num = i2c_conf->sda_pin,
+      .sda_io_num = bus_conf->sda_pin,
       .sda_pullup_en = GPIO_PULLUP_ENABLE,
-      .scl_io_num = i2c_conf->scl_pin,
+      .scl_io_num = bus_conf->scl_pin,
       .scl_pullup_en = GPIO_PULLUP_ENABLE,
-      .master.clk_speed = i2c_conf->speed,
+      .master.clk_speed = bus_conf->speed,
       .clk_flags = 0,
   };
 
-  int err = i2c_param_config(i2c_conf->port, &config);
+  int err = i2c_param_config(bus_conf->port, &config);
   if (err != 0)
     return NULL;
 
-  err = i2c_driver_install(i2c_conf->port, I2C_MODE_MASTER, 0, 0, 0);
+  err = i2c_driver_install(bus_conf->port, I2C_MODE_MASTER, 0, 0, 0);
   if (err != 0)
     return NULL;
 
   /// Adjust the I2C clock duty cycle so that it is closer to 50%
-  err = i2c_set_period(i2c_conf->port, 250, 200);
+  err = i2c_set_period(bus_conf->port, 250, 200);
   if (err != 0)
+  {
+    i2c_driver_delete(bus_conf->port);
     return NULL;
+  }
 
-  memoree_interface_t interface = malloc(sizeof(int));
-  if (interface)
-    *((int *)interface) = i2c_conf->port;
+  memoree_interface_t bus = malloc(sizeof(int));
+  if (bus)
+    *((int *)bus) = bus_conf->port;
   else
-    i2c_driver_delete(i2c_conf->port);
+    i2c_driver_delete(bus_conf->port);
 
-  return interface;
+  return bus;
 }
 
-memoree_err_t platform_i2c_deinit(memoree_interface_t interface)
+memoree_err_t platform_i2c_bus_deinit(memoree_interface_t bus)
 {
-  if (!interface)
+  if (!bus)
     return MEMOREE_ERR_INVALID_ARG;
 
-  int i2c_port = *((int *)interface);
+  int i2c_port = *((int *)bus);
 
   if (i2c_driver_delete(i2c_port) != ESP_OK)
     return MEMOREE_ERR_FAIL;
 
-  free(interface);
+  free(bus);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_i2c_init(memoree_interface_t bus, memoree_i2c_conf_t *i2c_conf)
+{
+  if (!bus || !i2c_conf)
+    return NULL;
+
+  /// Devices are told apart by the address passed with every transfer, so they all use the port of the bus
+  return bus;
+}
+
+memoree_err_t platform_i2c_deinit(memoree_interface_t interface)
+{
+  if (!interface)
+    return MEMOREE_ERR_INVALID_ARG;
+
   return MEMOREE_ERR_OK;
 }
 
@@ -105,8 +181,11 @@ int32_t platform_i2c_write(memoree_interface_t interface, uint8_t addr, uint8_t
 
   /// Retry as long as a timeout has not occured
   int64_t now = esp_timer_get_time();
+  uint32_t attempts = 0;
   do
   {
+    if (attempts++)
+      PLATFORM_STATS_RETRY(interface);
     ret = i2c_master_write_to_device(i2c_num, addr, write_buff, write_size, pdMS_TO_TICKS(timeout_ms));
   } while (ret != ESP_OK && (esp_timer_get_time() < now + timeout_ms * 1000));
 
@@ -114,6 +193,54 @@ int32_t platform_i2c_write(memoree_interface_t interface, uint8_t addr, uint8_t
                                                                                          : MEMOREE_ERR_FAIL;
 }
 
+int32_t platform_i2c_writev(memoree_interface_t interface, uint8_t addr, const memoree_iovec_t *segs,
+                            size_t seg_cnt, size_t timeout_ms)
+{
+  if (!interface || (seg_cnt && !segs))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  i2c_port_t i2c_num = *(int *)interface;
+  size_t write_size = 0;
+
+  // The command link only keeps pointers to the segments, so the payload is clocked out straight from them
+  i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+  if (!cmd)
+    return MEMOREE_ERR_FAIL;
+
+  int ret = i2c_master_start(cmd);
+  if (ret == ESP_OK)
+    ret = i2c_master_write_byte(cmd, (addr << 1) | I2C_RW_WRITE, I2C_CHECK_ACK);
+  for (size_t s = 0; ret == ESP_OK && s < seg_cnt; s++)
+  {
+    if (segs[s].len)
+      ret = i2c_master_write(cmd, segs[s].buff, segs[s].len, I2C_CHECK_ACK);
+    write_size += segs[s].len;
+  }
+  if (ret == ESP_OK)
+    ret = i2c_master_stop(cmd);
+
+  if (ret != ESP_OK)
+  {
+    i2c_cmd_link_delete(cmd);
+    return MEMOREE_ERR_FAIL;
+  }
+
+  /// Retry as long as a timeout has not occured
+  int64_t now = esp_timer_get_time();
+  uint32_t attempts = 0;
+  do
+  {
+    if (attempts++)
+      PLATFORM_STATS_RETRY(interface);
+    ret = i2c_master_cmd_begin(i2c_num, cmd, pdMS_TO_TICKS(timeout_ms));
+  } while (ret != ESP_OK && (esp_timer_get_time() < now + timeout_ms * 1000));
+
+  i2c_cmd_link_delete(cmd);
+
+  return (ret == ESP_OK) ? write_size : (esp_timer_get_time() > now + timeout_ms * 1000) ? MEMOREE_ERR_TIMEOUT
+                                                                                         : MEMOREE_ERR_FAIL;
+}
+
 memoree_err_t platform_i2c_write_read(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff, size_t write_size,
                                       uint8_t *read_buff, size_t read_size, size_t timeout_ms)
 {
@@ -144,49 +271,102 @@ memoree_err_t platform_i2c_ping(memoree_interface_t interface, uint8_t addr, uin
 
 ///////////////////////////////SPI FUNCTIONS
 
-memoree_interface_t platform_spi_init(memoree_spi_conf_t *spi_conf)
+memoree_interface_t platform_spi_bus_init(memoree_spi_conf_t *bus_conf)
 {
-  if (!spi_conf || spi_conf->port >= SPI_HOST_MAX)
+  if (!bus_conf || bus_conf->port >= SPI_HOST_MAX)
     return NULL;
 
-  spi_bus_config_t bus_conf = {
-      .mosi_io_num = spi_conf->do_pin,
-      .miso_io_num = spi_conf->di_pin,
-      .sclk_io_num = spi_conf->sck_pin,
-      .quadhd_io_num = spi_conf->hd_pin,
-      .quadwp_io_num = spi_conf->wp_pin,
-      .max_transfer_sz = 4096,
+  spi_bus_config_t bus_cfg = {
+      .mosi_io_num = bus_conf->do_pin,
+      .miso_io_num = bus_conf->di_pin,
+      .sclk_io_num = bus_conf->sck_pin,
+      .quadhd_io_num = bus_conf->hd_pin,
+      .quadwp_io_num = bus_conf->wp_pin,
       .flags = 0,
   };
 
-  esp_err_t err = spi_bus_initialize(spi_conf->port, &bus_conf, SPI_DMA_DISABLED);
+  /// Without DMA every transfer has to fit in the peripheral's data buffer
+  uint32_t max_transfer = bus_conf->dma ? (bus_conf->max_transfer ? bus_conf->max_transfer : MEMOREE_PLATFORM_SPI_DMA_TRANSFER)
+                                        : SOC_SPI_MAXIMUM_BUFFER_SIZE;
+  if (!bus_conf->dma && bus_conf->max_transfer)
+    max_transfer = MIN(max_transfer, bus_conf->max_transfer);
+  bus_cfg.max_transfer_sz = max_transfer;
+
+  esp_err_t err = spi_bus_initialize(bus_conf->port, &bus_cfg, bus_conf->dma ? SPI_DMA_CH_AUTO : SPI_DMA_DISABLED);
 
   // neither is initialization successful nor is the port already initialized
   if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
     return NULL;
 
+  espidf_spi_bus_t *bus = malloc(sizeof(espidf_spi_bus_t));
+  if (!bus)
+  {
+    if (err == ESP_OK)
+      spi_bus_free(bus_conf->port);
+    return NULL;
+  }
+
+  bus->port = bus_conf->port;
+  bus->max_transfer = max_transfer;
+  bus->quad = bus_conf->wp_pin >= 0 && bus_conf->hd_pin >= 0;
+  bus->owned = err == ESP_OK;
+  return bus;
+}
+
+memoree_err_t platform_spi_bus_deinit(memoree_interface_t bus)
+{
+  if (!bus)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  espidf_spi_bus_t *spi_bus = bus;
+  if (spi_bus->owned && spi_bus_free(spi_bus->port) != ESP_OK)
+    return MEMOREE_ERR_FAIL;
+
+  free(spi_bus);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_spi_init(memoree_interface_t bus, memoree_spi_conf_t *spi_conf)
+{
+  if (!bus || !spi_conf)
+    return NULL;
+
+  espidf_spi_bus_t *spi_bus = bus;
   memoree_interface_t interface = NULL;
 
-  spi_device_handle_t dev_handle;
+  espidf_spi_dev_t *dev = calloc(1, sizeof(espidf_spi_dev_t));
+  if (!dev)
+    return NULL;
+
   spi_device_interface_config_t mem_device;
   memset(&mem_device, 0, sizeof(spi_device_interface_config_t));
 
+  /// Each device keeps its own clock and mode, which the driver switches to when it selects the device
   mem_device.mode = spi_conf->mode;
   mem_device.clock_speed_hz = spi_conf->speed;
   mem_device.spics_io_num = spi_conf->cs_pin;
   mem_device.queue_size = 5;
 
-  if (spi_bus_add_device(spi_conf->port, &mem_device, &dev_handle) != ESP_OK)
+  if (spi_bus_add_device(spi_bus->port, &mem_device, &dev->handle) != ESP_OK)
   {
-    spi_bus_free(spi_conf->port);
+    free(dev);
     return NULL;
   }
 
+  /// esp-idf only allows dual and quad transactions on half duplex devices, so add a second device on the same
+  /// (manually driven) chip select for them
+  mem_device.flags = SPI_DEVICE_HALFDUPLEX;
+  mem_device.spics_io_num = -1;
+  if (spi_bus_add_device(spi_bus->port, &mem_device, &dev->hd_handle) != ESP_OK)
+    dev->hd_handle = NULL;
+
   interface = malloc(sizeof(memoree_spi_if_t));
   if (!interface)
   {
-    spi_bus_remove_device(dev_handle);
-    spi_bus_free(spi_conf->port);
+    if (dev->hd_handle)
+      spi_bus_remove_device(dev->hd_handle);
+    spi_bus_remove_device(dev->handle);
+    free(dev);
     return NULL;
   }
   gpio_set_level(spi_conf->cs_pin, 1);
@@ -196,9 +376,17 @@ memoree_interface_t platform_spi_init(memoree_spi_conf_t *spi_conf)
   };
   gpio_config(&en_cfg);
 
-  ((memoree_spi_if_t *)interface)->port = spi_conf->port;
+  ((memoree_spi_if_t *)interface)->port = spi_bus->port;
   ((memoree_spi_if_t *)interface)->cs_pin = spi_conf->cs_pin;
-  ((memoree_spi_if_t *)interface)->dev_handle = (void *)dev_handle;
+  ((memoree_spi_if_t *)interface)->dev_handle = dev;
+  ((memoree_spi_if_t *)interface)->max_transfer = spi_conf->max_transfer ? MIN(spi_bus->max_transfer, spi_conf->max_transfer)
+                                                                         : spi_bus->max_transfer;
+
+  /// Quad transfers need the WP and HD pins routed to the bus as IO2 and IO3
+  if (!dev->hd_handle)
+    ((memoree_spi_if_t *)interface)->max_lines = 1;
+  else
+    ((memoree_spi_if_t *)interface)->max_lines = spi_bus->quad ? 4 : 2;
 
   return interface;
 }
@@ -208,45 +396,197 @@ memoree_err_t platform_spi_deinit(memoree_spi_if_t *interface)
   if (!interface || !interface->dev_handle)
     return MEMOREE_ERR_INVALID_ARG;
 
-  esp_err_t err = spi_bus_remove_device(interface->dev_handle);
-  if (err != ESP_OK)
+  espidf_spi_dev_t *dev = interface->dev_handle;
+
+  if (dev->hd_handle && spi_bus_remove_device(dev->hd_handle) != ESP_OK)
     return MEMOREE_ERR_FAIL;
+  dev->hd_handle = NULL;
 
-  err = spi_bus_free(interface->port);
+  esp_err_t err = spi_bus_remove_device(dev->handle);
   if (err != ESP_OK)
     return MEMOREE_ERR_FAIL;
+  free(dev);
 
   free(interface);
   return MEMOREE_ERR_OK;
 }
 
-memoree_err_t platform_spi_write_read(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+/// @brief Translate the bus transfer of \a spi_t starting at offset \a off of its data phase into an esp-idf transaction
+///        descriptor and select the device it has to be sent on
+/// @note Only the first transfer carries the command, address and dummy phases. The following ones continue the data
+///       phase while chip select stays asserted.
+/// @param len Set to the number of data bytes covered by the transfer
+static memoree_err_t _spi_build_trans(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t, uint32_t off,
+                                      spi_transaction_ext_t *trans_desc, spi_device_handle_t *handle, uint32_t *len)
 {
   if (!interface || !spi_t || (spi_t->write_len && !spi_t->write_buff) || (spi_t->read_len && !spi_t->read_buff))
     return MEMOREE_ERR_INVALID_ARG;
 
-  if (!spi_t->write_len && spi_t->read_len)
-    memset(spi_t->read_buff, 0, spi_t->read_len);
+  espidf_spi_dev_t *dev = interface->dev_handle;
+  bool multiline = spi_t->addr_lines > 1 || spi_t->data_lines > 1;
 
-  int ret;
+  if (multiline && (!dev->hd_handle || (spi_t->write_len && spi_t->read_len)))
+    return MEMOREE_ERR_INVALID_ARG;
 
-  /// esp-idf requires that the write length is set to whichever is longer between the read and write lengths, even in a read-only operation
-  spi_transaction_ext_t trans_desc = {
+  /// A transfer never runs past the end of the write buffer, the rest of a longer read is clocked without a TX phase
+  uint32_t n = MIN(interface->max_transfer, MAX(spi_t->write_len, spi_t->read_len) - off);
+  if (off < spi_t->write_len)
+    n = MIN(n, spi_t->write_len - off);
+  uint32_t tx_n = (off < spi_t->write_len) ? n : 0;
+  uint32_t rx_n = (off < spi_t->read_len) ? MIN(n, spi_t->read_len - off) : 0;
+
+  /// Full duplex transactions clock the longer of the two phases, half duplex ones clock them separately
+  *trans_desc = (spi_transaction_ext_t){
       .base.addr = spi_t->addr,
       .base.cmd = spi_t->cmd,
       .base.flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY,
-      .base.length = MAX(spi_t->write_len, spi_t->read_len) * 8,
-      .base.rxlength = spi_t->read_len * 8,
-      .base.tx_buffer = (spi_t->read_len > spi_t->write_len) && !spi_t->write_buff ? spi_t->read_buff : spi_t->write_buff,
-      .base.rx_buffer = spi_t->read_buff,
-      .command_bits = spi_t->cmd_len,
-      .address_bits = spi_t->addr_len,
-      .dummy_bits = spi_t->dummy_len,
+      .base.length = (multiline ? tx_n : n) * 8,
+      .base.rxlength = rx_n * 8,
+      .base.tx_buffer = tx_n ? spi_t->write_buff + off : NULL,
+      .base.rx_buffer = rx_n ? spi_t->read_buff + off : NULL,
+      .command_bits = off ? 0 : spi_t->cmd_len,
+      .address_bits = off ? 0 : spi_t->addr_len,
+      .dummy_bits = off ? 0 : spi_t->dummy_len,
   };
 
+  if (multiline)
+  {
+    trans_desc->base.flags |= (spi_t->data_lines == 4) ? SPI_TRANS_MODE_QIO : (spi_t->data_lines == 2) ? SPI_TRANS_MODE_DIO
+                                                                                                       : 0;
+    if (spi_t->addr_lines > 1)
+      trans_desc->base.flags |= SPI_TRANS_MULTILINE_ADDR;
+  }
+
+  *handle = multiline ? dev->hd_handle : dev->handle;
+  *len = n;
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t platform_spi_write_read(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+{
+  if (!interface || !interface->dev_handle || !spi_t)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  spi_transaction_ext_t trans_desc;
+  spi_device_handle_t handle;
+  uint32_t total = MAX(spi_t->write_len, spi_t->read_len);
+  uint32_t off = 0;
+  uint32_t len = 0;
+  int ret = ESP_OK;
+
   gpio_set_level(interface->cs_pin, 0);
-  ret = spi_device_transmit((spi_device_handle_t)interface->dev_handle, (spi_transaction_t *)&trans_desc);
+  do
+  {
+    memoree_err_t err = _spi_build_trans(interface, spi_t, off, &trans_desc, &handle, &len);
+    if (err != MEMOREE_ERR_OK)
+    {
+      gpio_set_level(interface->cs_pin, 1);
+      return err;
+    }
+
+    ret = spi_device_transmit(handle, (spi_transaction_t *)&trans_desc);
+    off += len;
+  } while (ret == ESP_OK && off < total);
   gpio_set_level(interface->cs_pin, 1);
 
   return (ret == 0) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
 }
+
+memoree_err_t platform_spi_queue(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+{
+  if (!interface || !interface->dev_handle || ((espidf_spi_dev_t *)interface->dev_handle)->queued_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  espidf_spi_dev_t *dev = interface->dev_handle;
+  spi_device_handle_t handle;
+
+  memoree_err_t err = _spi_build_trans(interface, spi_t, 0, &dev->queued, &handle, &dev->queued_len);
+  if (err != MEMOREE_ERR_OK)
+    return err;
+
+  /// Chip select stays asserted until platform_spi_queue_result() has collected the last transfer
+  gpio_set_level(interface->cs_pin, 0);
+  if (spi_device_queue_trans(handle, (spi_transaction_t *)&dev->queued, portMAX_DELAY) != ESP_OK)
+  {
+    gpio_set_level(interface->cs_pin, 1);
+    return MEMOREE_ERR_FAIL;
+  }
+
+  dev->queued_handle = handle;
+  dev->queued_t = spi_t;
+  dev->queued_off = 0;
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t platform_spi_queue_result(memoree_spi_if_t *interface, uint32_t timeout_ms)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  espidf_spi_dev_t *dev = interface->dev_handle;
+  int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+  esp_err_t ret = ESP_OK;
+
+  /// Transactions longer than max_transfer are sent as a chain of transfers, each queued as the previous one completes
+  while (dev->queued_handle)
+  {
+    int64_t left_us = deadline - esp_timer_get_time();
+    spi_transaction_t *done;
+    ret = spi_device_get_trans_result(dev->queued_handle, &done, (left_us > 0) ? pdMS_TO_TICKS(left_us / 1000) : 0);
+    if (ret == ESP_ERR_TIMEOUT)
+      return MEMOREE_ERR_TIMEOUT;
+
+    memoree_spi_transaction_t *spi_t = dev->queued_t;
+    dev->queued_off += dev->queued_len;
+
+    spi_device_handle_t handle = dev->queued_handle;
+    dev->queued_handle = NULL;
+    if (ret != ESP_OK || dev->queued_off >= MAX(spi_t->write_len, spi_t->read_len))
+      break;
+
+    if (_spi_build_trans(interface, spi_t, dev->queued_off, &dev->queued, &handle, &dev->queued_len) != MEMOREE_ERR_OK)
+    {
+      ret = ESP_FAIL;
+      break;
+    }
+
+    if ((ret = spi_device_queue_trans(handle, (spi_transaction_t *)&dev->queued, portMAX_DELAY)) != ESP_OK)
+      break;
+
+    dev->queued_handle = handle;
+  }
+
+  gpio_set_level(interface->cs_pin, 1);
+
+  return (ret == ESP_OK) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+}
+
+memoree_err_t platform_spi_wait_ready(memoree_spi_if_t *interface, uint32_t timeout_ms)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint8_t status = 0;
+  spi_transaction_t trans_desc = {
+      .length = 8,
+      .rxlength = 8,
+      .tx_buffer = NULL,
+      .rx_buffer = &status,
+  };
+
+  int ret;
+  int64_t deadline = esp_timer_get_time() + timeout_ms * 1000;
+
+  /// DO reads back as all ones once the cycle has completed, so keep CS asserted and sample it one byte at a time
+  gpio_set_level(interface->cs_pin, 0);
+  do
+  {
+    ret = spi_device_polling_transmit(((espidf_spi_dev_t *)interface->dev_handle)->handle, &trans_desc);
+  } while (ret == ESP_OK && !status && esp_timer_get_time() < deadline);
+  gpio_set_level(interface->cs_pin, 1);
+
+  if (ret != ESP_OK)
+    return MEMOREE_ERR_FAIL;
+
+  return status ? MEMOREE_ERR_OK : MEMOREE_ERR_TIMEOUT;
+}
@@ -0,0 +1,686 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <linux/spi/spidev.h>
+
+#include "memoree_platform.h"
+#include "../memoree.h"
+
+#define MIN(x, y) ((x < y) ? x : y)
+#define MAX(x, y) ((x > y) ? x : y)
+
+#define LINUX_I2C_DEV_PATH "/dev/i2c-%d"       ///< I2C adapter character device, formatted with the port number
+#define LINUX_SPI_DEV_PATH "/dev/spidev%d.%d"  ///< SPI device character device, formatted with the bus number and chip select
+#define LINUX_I2C_MAX_MSG_LEN 8192             ///< Largest message accepted by the i2c-dev driver
+#define LINUX_I2C_MAX_MSGS I2C_RDWR_IOCTL_MAX_MSGS
+#define LINUX_SPI_MAX_HEADER_LEN 12            ///< Command, address and dummy phases packed into bytes
+#define LINUX_SPI_MAX_XFERS 4                  ///< Command, multi-line address, full duplex data and remaining half duplex data
+#define LINUX_SPI_BUFSIZ_PATH "/sys/module/spidev/parameters/bufsiz" ///< Largest message spidev accepts in each direction
+#define LINUX_SPI_DEFAULT_BUFSIZ 4096          ///< spidev's default buffer size, used when the parameter cannot be read
+
+/// @brief I2C adapter handle, shared by every device on the adapter
+typedef struct
+{
+  int port;              ///< Adapter number N of /dev/i2c-N
+  int fd;                ///< Open file descriptor of the adapter
+  unsigned long funcs;   ///< Adapter functionality reported by I2C_FUNCS
+  uint32_t timeout_ms;   ///< Adapter timeout currently programmed with I2C_TIMEOUT
+} linux_i2c_if_t;
+
+/// @brief SPI bus handle returned by platform_spi_bus_init()
+typedef struct
+{
+  int port;        ///< Bus number B of /dev/spidevB.C
+  uint32_t bufsiz; ///< spidev buffer size, read once for all devices on the bus
+} linux_spi_bus_t;
+
+/// @brief SPI device state stored in the \a dev_handle member of memoree_spi_if_t
+typedef struct
+{
+  int fd;                   ///< Open file descriptor of the spidev device
+  uint32_t speed;           ///< Clock speed in Hz used for every transfer
+  memoree_err_t queued_ret; ///< Result of the transaction passed to platform_spi_queue()
+} linux_spi_dev_t;
+
+static uint64_t _get_time_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void platform_ms_delay(uint32_t ms)
+{
+  struct timespec req = {
+      .tv_sec = ms / 1000,
+      .tv_nsec = (ms % 1000) * 1000000L,
+  };
+
+  // Resume the remaining sleep if interrupted by a signal
+  while (nanosleep(&req, &req) != 0 && errno == EINTR);
+}
+
+uint64_t platform_get_time_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+memoree_mutex_t platform_mutex_create(void)
+{
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0)
+    return NULL;
+
+  pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+  if (mutex && (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0 || pthread_mutex_init(mutex, &attr) != 0))
+  {
+    free(mutex);
+    mutex = NULL;
+  }
+
+  pthread_mutexattr_destroy(&attr);
+  return mutex;
+}
+
+void platform_mutex_delete(memoree_mutex_t mutex)
+{
+  if (!mutex)
+    return;
+
+  pthread_mutex_destroy(mutex);
+  free(mutex);
+}
+
+void platform_mutex_lock(memoree_mutex_t mutex)
+{
+  pthread_mutex_lock(mutex);
+}
+
+bool platform_mutex_trylock(memoree_mutex_t mutex)
+{
+  return pthread_mutex_trylock(mutex) == 0;
+}
+
+void platform_mutex_unlock(memoree_mutex_t mutex)
+{
+  pthread_mutex_unlock(mutex);
+}
+
+/// I2C functions
+
+/// @brief Program the adapter timeout, skipping the syscall when it is unchanged since the last transfer
+static void _i2c_set_timeout(linux_i2c_if_t *i2c, size_t timeout_ms)
+{
+  if (!timeout_ms || timeout_ms == i2c->timeout_ms)
+    return;
+
+  // I2C_TIMEOUT is expressed in units of 10ms
+  if (ioctl(i2c->fd, I2C_TIMEOUT, (timeout_ms + 9) / 10) == 0)
+    i2c->timeout_ms = timeout_ms;
+}
+
+/// @brief Issue all \a msg_cnt messages as one combined transaction separated by repeated starts
+static memoree_err_t _i2c_transfer(linux_i2c_if_t *i2c, struct i2c_msg *msgs, uint32_t msg_cnt)
+{
+  struct i2c_rdwr_ioctl_data rdwr = {
+      .msgs = msgs,
+      .nmsgs = msg_cnt,
+  };
+
+  return (ioctl(i2c->fd, I2C_RDWR, &rdwr) == (int)msg_cnt) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+}
+
+/// @brief Append read messages to \a msgs so that reads larger than the i2c-dev message limit continue from the
+///        target's internal address counter, and issue them in as few I2C_RDWR calls as possible
+/// @param msg_cnt Number of messages already placed at the start of \a msgs
+static memoree_err_t _i2c_read_msgs(linux_i2c_if_t *i2c, uint8_t addr, struct i2c_msg *msgs, uint32_t msg_cnt,
+                                    uint8_t *read_buff, size_t read_size)
+{
+  do
+  {
+    while (read_size && msg_cnt < LINUX_I2C_MAX_MSGS)
+    {
+      uint16_t len = MIN(read_size, LINUX_I2C_MAX_MSG_LEN);
+      msgs[msg_cnt].addr = addr;
+      msgs[msg_cnt].flags = I2C_M_RD;
+      msgs[msg_cnt].len = len;
+      msgs[msg_cnt].buf = read_buff;
+      msg_cnt++;
+      read_buff += len;
+      read_size -= len;
+    }
+
+    if (msg_cnt && _i2c_transfer(i2c, msgs, msg_cnt) != MEMOREE_ERR_OK)
+      return MEMOREE_ERR_FAIL;
+
+    msg_cnt = 0;
+  } while (read_size);
+
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_i2c_bus_init(memoree_i2c_conf_t *bus_conf)
+{
+  if (!bus_conf || bus_conf->port < 0)
+    return NULL;
+
+  // The bus speed of an i2c-dev adapter is fixed by the kernel (device tree or module parameter)
+  char path[32];
+  snprintf(path, sizeof(path), LINUX_I2C_DEV_PATH, bus_conf->port);
+
+  int fd = open(path, O_RDWR);
+  if (fd < 0)
+    return NULL;
+
+  unsigned long funcs = 0;
+  if (ioctl(fd, I2C_FUNCS, &funcs) != 0 || !(funcs & I2C_FUNC_I2C))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  linux_i2c_if_t *bus = malloc(sizeof(linux_i2c_if_t));
+  if (!bus)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  bus->port = bus_conf->port;
+  bus->fd = fd;
+  bus->funcs = funcs;
+  bus->timeout_ms = 0;
+
+  return bus;
+}
+
+memoree_err_t platform_i2c_bus_deinit(memoree_interface_t bus)
+{
+  if (!bus)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  if (close(((linux_i2c_if_t *)bus)->fd) != 0)
+    return MEMOREE_ERR_FAIL;
+
+  free(bus);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_i2c_init(memoree_interface_t bus, memoree_i2c_conf_t *i2c_conf)
+{
+  if (!bus || !i2c_conf)
+    return NULL;
+
+  // Every message carries its target address, so all devices on an adapter share its file descriptor
+  return bus;
+}
+
+memoree_err_t platform_i2c_deinit(memoree_interface_t interface)
+{
+  if (!interface)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  return MEMOREE_ERR_OK;
+}
+
+int32_t platform_i2c_read(memoree_interface_t interface, uint8_t addr, uint8_t *read_buff,
+                          size_t read_size, size_t timeout_ms)
+{
+  if (!interface || (read_size && !read_buff))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_i2c_if_t *i2c = interface;
+  struct i2c_msg msgs[LINUX_I2C_MAX_MSGS];
+
+  _i2c_set_timeout(i2c, timeout_ms);
+  int ret = _i2c_read_msgs(i2c, addr, msgs, 0, read_buff, read_size);
+
+  return (ret == MEMOREE_ERR_OK) ? (int32_t)read_size : MEMOREE_ERR_FAIL;
+}
+
+int32_t platform_i2c_writev(memoree_interface_t interface, uint8_t addr, const memoree_iovec_t *segs,
+                            size_t seg_cnt, size_t timeout_ms)
+{
+  if (!interface || (seg_cnt && !segs) || seg_cnt > LINUX_I2C_MAX_MSGS)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  size_t write_size = 0;
+  for (size_t s = 0; s < seg_cnt; s++)
+  {
+    if (segs[s].len && !segs[s].buff)
+      return MEMOREE_ERR_INVALID_ARG;
+    write_size += segs[s].len;
+  }
+
+  if (write_size > LINUX_I2C_MAX_MSG_LEN)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_i2c_if_t *i2c = interface;
+  struct i2c_msg msgs[LINUX_I2C_MAX_MSGS];
+  uint32_t msg_cnt = 0;
+  uint8_t *staging = NULL;
+
+  if (seg_cnt <= 1 || (i2c->funcs & I2C_FUNC_NOSTART))
+  {
+    // Each segment continues the same write in place, I2C_M_NOSTART suppressing the start condition and address byte
+    for (size_t s = 0; s < seg_cnt; s++)
+    {
+      if (!segs[s].len && msg_cnt)
+        continue;
+
+      msgs[msg_cnt].addr = addr;
+      msgs[msg_cnt].flags = msg_cnt ? I2C_M_NOSTART : 0;
+      msgs[msg_cnt].len = segs[s].len;
+      msgs[msg_cnt].buf = (uint8_t *)segs[s].buff;
+      msg_cnt++;
+    }
+  }
+  else
+  {
+    // Adapters without I2C_M_NOSTART only take a write as one contiguous message
+    staging = malloc(write_size ? write_size : 1);
+    if (!staging)
+      return MEMOREE_ERR_FAIL;
+
+    size_t off = 0;
+    for (size_t s = 0; s < seg_cnt; s++)
+    {
+      if (segs[s].len)
+        memcpy(staging + off, segs[s].buff, segs[s].len);
+      off += segs[s].len;
+    }
+  }
+
+  if (!msg_cnt)
+  {
+    msgs[0].addr = addr;
+    msgs[0].flags = 0;
+    msgs[0].len = write_size;
+    msgs[0].buf = staging;
+    msg_cnt = 1;
+  }
+
+  _i2c_set_timeout(i2c, timeout_ms);
+
+  int ret;
+
+  /// Retry as long as a timeout has not occured
+  uint64_t now = _get_time_ms();
+  uint32_t attempts = 0;
+  do
+  {
+    if (attempts++)
+      PLATFORM_STATS_RETRY(interface);
+    ret = _i2c_transfer(i2c, msgs, msg_cnt);
+  } while (ret != MEMOREE_ERR_OK && (_get_time_ms() < now + timeout_ms));
+
+  free(staging);
+
+  return (ret == MEMOREE_ERR_OK) ? (int32_t)write_size : (_get_time_ms() >= now + timeout_ms) ? MEMOREE_ERR_TIMEOUT
+                                                                                               : MEMOREE_ERR_FAIL;
+}
+
+int32_t platform_i2c_write(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff,
+                           size_t write_size, size_t timeout_ms)
+{
+  if (!write_buff)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memoree_iovec_t seg = {.buff = write_buff, .len = write_size};
+  return platform_i2c_writev(interface, addr, &seg, 1, timeout_ms);
+}
+
+memoree_err_t platform_i2c_write_read(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff, size_t write_size,
+                                      uint8_t *read_buff, size_t read_size, size_t timeout_ms)
+{
+  if (!interface || (write_size && !write_buff) || (read_size && !read_buff) || write_size > LINUX_I2C_MAX_MSG_LEN)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_i2c_if_t *i2c = interface;
+  struct i2c_msg msgs[LINUX_I2C_MAX_MSGS];
+  uint32_t msg_cnt = 0;
+
+  if (write_size)
+  {
+    msgs[msg_cnt].addr = addr;
+    msgs[msg_cnt].flags = 0;
+    msgs[msg_cnt].len = write_size;
+    msgs[msg_cnt].buf = write_buff;
+    msg_cnt++;
+  }
+
+  _i2c_set_timeout(i2c, timeout_ms);
+
+  // The address write and every read chunk go out in a single I2C_RDWR call joined by repeated starts
+  return _i2c_read_msgs(i2c, addr, msgs, msg_cnt, read_buff, read_size);
+}
+
+memoree_err_t platform_i2c_ping(memoree_interface_t interface, uint8_t addr, uint32_t timeout_ms)
+{
+  if (!interface)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_i2c_if_t *i2c = interface;
+  _i2c_set_timeout(i2c, timeout_ms);
+
+  // Prefer an SMBus quick write, which some adapters support even though they reject zero-length I2C_RDWR messages
+  if (i2c->funcs & I2C_FUNC_SMBUS_QUICK)
+  {
+    struct i2c_smbus_ioctl_data args = {
+        .read_write = I2C_SMBUS_WRITE,
+        .command = 0,
+        .size = I2C_SMBUS_QUICK,
+        .data = NULL,
+    };
+
+    // I2C_SLAVE fails with EBUSY while a kernel driver such as at24 is bound to the address, which I2C_RDWR, used by
+    // every other transfer, does not check for
+    if (ioctl(i2c->fd, I2C_SLAVE_FORCE, addr) != 0)
+      return MEMOREE_ERR_FAIL;
+
+    return (ioctl(i2c->fd, I2C_SMBUS, &args) == 0) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+  }
+
+  struct i2c_msg msg = {
+      .addr = addr,
+      .flags = 0,
+      .len = 0,
+      .buf = NULL,
+  };
+
+  return _i2c_transfer(i2c, &msg, 1);
+}
+
+///////////////////////////////SPI FUNCTIONS
+
+/// @brief Append the \a bit_cnt least significant bits of \a value to \a buff, MSB first
+static void _spi_pack_bits(uint8_t *buff, uint32_t *bit_pos, uint32_t value, uint8_t bit_cnt)
+{
+  while (bit_cnt--)
+  {
+    if ((value >> bit_cnt) & 1)
+      buff[*bit_pos / 8] |= 0x80 >> (*bit_pos % 8);
+    (*bit_pos)++;
+  }
+}
+
+/// @brief Returns the size of the buffer spidev allocates for each direction of a message
+static uint32_t _spi_bufsiz(void)
+{
+  unsigned long bufsiz = 0;
+  FILE *f = fopen(LINUX_SPI_BUFSIZ_PATH, "r");
+  if (f)
+  {
+    if (fscanf(f, "%lu", &bufsiz) != 1)
+      bufsiz = 0;
+    fclose(f);
+  }
+
+  return (bufsiz > LINUX_SPI_MAX_HEADER_LEN) ? bufsiz : LINUX_SPI_DEFAULT_BUFSIZ;
+}
+
+memoree_interface_t platform_spi_bus_init(memoree_spi_conf_t *bus_conf)
+{
+  if (!bus_conf || bus_conf->port < 0)
+    return NULL;
+
+  // Pins and DMA are set up by the controller driver, so the bus only caches what is common to its devices
+  linux_spi_bus_t *bus = malloc(sizeof(linux_spi_bus_t));
+  if (!bus)
+    return NULL;
+
+  bus->port = bus_conf->port;
+  bus->bufsiz = _spi_bufsiz();
+  return bus;
+}
+
+memoree_err_t platform_spi_bus_deinit(memoree_interface_t bus)
+{
+  if (!bus)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  free(bus);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_spi_init(memoree_interface_t bus, memoree_spi_conf_t *spi_conf)
+{
+  if (!bus || !spi_conf || spi_conf->cs_pin < 0)
+    return NULL;
+
+  linux_spi_bus_t *spi_bus = bus;
+
+  // The spidev chip select number takes the place of the CS pin, e.g. port 1 and cs_pin 0 open /dev/spidev1.0
+  char path[32];
+  snprintf(path, sizeof(path), LINUX_SPI_DEV_PATH, spi_bus->port, spi_conf->cs_pin);
+
+  int fd = open(path, O_RDWR);
+  if (fd < 0)
+    return NULL;
+
+  // The mode is passed through as-is so that spidev flags such as SPI_CS_HIGH (required by 93CXX parts) can be OR'd in
+  uint32_t mode = spi_conf->mode;
+  uint8_t bits = 8;
+  uint32_t speed = spi_conf->speed;
+
+  if (ioctl(fd, SPI_IOC_WR_MODE32, &mode) != 0 ||
+      ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) != 0 ||
+      ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) != 0 ||
+      ioctl(fd, SPI_IOC_RD_MODE32, &mode) != 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  memoree_spi_if_t *interface = malloc(sizeof(memoree_spi_if_t));
+  linux_spi_dev_t *dev = malloc(sizeof(linux_spi_dev_t));
+  if (!interface || !dev)
+  {
+    free(interface);
+    free(dev);
+    close(fd);
+    return NULL;
+  }
+
+  dev->fd = fd;
+  dev->speed = speed;
+  dev->queued_ret = MEMOREE_ERR_OK;
+
+  interface->port = spi_bus->port;
+  interface->cs_pin = spi_conf->cs_pin;
+  interface->dev_handle = dev;
+
+  // Each message has to fit in spidev's buffer along with the packed header. DMA is up to the controller driver.
+  uint32_t max_transfer = spi_bus->bufsiz - LINUX_SPI_MAX_HEADER_LEN;
+  if (spi_conf->max_transfer && spi_conf->max_transfer < max_transfer)
+    max_transfer = spi_conf->max_transfer;
+  interface->max_transfer = max_transfer;
+
+  // Dual and quad transfers are only accepted when both directions are enabled in the mode (or device tree)
+  if ((mode & SPI_TX_QUAD) && (mode & SPI_RX_QUAD))
+    interface->max_lines = 4;
+  else if ((mode & (SPI_TX_DUAL | SPI_TX_QUAD)) && (mode & (SPI_RX_DUAL | SPI_RX_QUAD)))
+    interface->max_lines = 2;
+  else
+    interface->max_lines = 1;
+
+  return interface;
+}
+
+memoree_err_t platform_spi_deinit(memoree_spi_if_t *interface)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_spi_dev_t *dev = interface->dev_handle;
+
+  if (close(dev->fd) != 0)
+    return MEMOREE_ERR_FAIL;
+
+  free(dev);
+  free(interface);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t platform_spi_write_read(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+{
+  if (!interface || !interface->dev_handle || !spi_t || (spi_t->write_len && !spi_t->write_buff) ||
+      (spi_t->read_len && !spi_t->read_buff))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint8_t addr_lines = spi_t->addr_lines ? spi_t->addr_lines : 1;
+  uint8_t data_lines = spi_t->data_lines ? spi_t->data_lines : 1;
+
+  if ((addr_lines > 1 || data_lines > 1) && spi_t->write_len && spi_t->read_len)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // On a single line the address and dummy phases join the command. Otherwise they are sent as a separate transfer
+  // with each dummy cycle clocking addr_lines bits
+  uint32_t cmd_bits = spi_t->cmd_len + ((addr_lines == 1) ? spi_t->addr_len + spi_t->dummy_len : 0);
+  uint32_t addr_bits = (addr_lines == 1) ? 0 : spi_t->addr_len + spi_t->dummy_len * addr_lines;
+  if (cmd_bits + addr_bits > LINUX_SPI_MAX_HEADER_LEN * 8 || addr_bits % 8)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_spi_dev_t *dev = interface->dev_handle;
+
+  // Headers that are not a whole number of bytes are left-padded with zeros, which 93CXX parts ignore while waiting for their start bit
+  uint8_t header[LINUX_SPI_MAX_HEADER_LEN];
+  uint32_t cmd_len = (cmd_bits + 7) / 8;
+  uint32_t bit_pos = cmd_len * 8 - cmd_bits;
+  memset(header, 0, sizeof(header));
+  _spi_pack_bits(header, &bit_pos, spi_t->cmd, spi_t->cmd_len);
+  _spi_pack_bits(header, &bit_pos, spi_t->addr, spi_t->addr_len);
+
+  struct spi_ioc_transfer xfers[LINUX_SPI_MAX_XFERS];
+  uint32_t total = MAX(spi_t->write_len, spi_t->read_len);
+  uint32_t duplex_len = MIN(spi_t->write_len, spi_t->read_len);
+  uint32_t off = 0;
+  int ret = 0;
+
+  // Data phases longer than max_transfer are split into several messages. cs_change on the last transfer of a message
+  // asks the controller to keep chip select asserted until the next one, so the device sees a single transaction.
+  do
+  {
+    uint32_t end = off + MIN(interface->max_transfer, total - off);
+    uint32_t xfer_cnt = 0;
+    memset(xfers, 0, sizeof(xfers));
+
+    if (off == 0 && cmd_len)
+    {
+      xfers[xfer_cnt].tx_buf = (uintptr_t)header;
+      xfers[xfer_cnt].len = cmd_len;
+      xfer_cnt++;
+    }
+
+    if (off == 0 && addr_bits)
+    {
+      xfers[xfer_cnt].tx_buf = (uintptr_t)(header + cmd_len);
+      xfers[xfer_cnt].len = addr_bits / 8;
+      xfers[xfer_cnt].tx_nbits = addr_lines;
+      xfer_cnt++;
+    }
+
+    uint32_t data_xfer = xfer_cnt;
+
+    // Full duplex phase for the bytes that are both written and read, then whichever direction is longer
+    if (off < duplex_len)
+    {
+      xfers[xfer_cnt].tx_buf = (uintptr_t)(spi_t->write_buff + off);
+      xfers[xfer_cnt].rx_buf = (uintptr_t)(spi_t->read_buff + off);
+      xfers[xfer_cnt].len = MIN(end, duplex_len) - off;
+      xfer_cnt++;
+    }
+
+    uint32_t half_off = MAX(off, duplex_len);
+    if (end > half_off)
+    {
+      // A NULL tx_buf makes spidev shift out zeros without a transmit buffer
+      if (spi_t->write_len > duplex_len)
+        xfers[xfer_cnt].tx_buf = (uintptr_t)(spi_t->write_buff + half_off);
+      else
+        xfers[xfer_cnt].rx_buf = (uintptr_t)(spi_t->read_buff + half_off);
+      xfers[xfer_cnt].len = end - half_off;
+      xfer_cnt++;
+    }
+
+    if (!xfer_cnt)
+      return MEMOREE_ERR_OK;
+
+    for (uint32_t i = 0; i < xfer_cnt; i++)
+    {
+      xfers[i].speed_hz = dev->speed;
+      xfers[i].bits_per_word = 8;
+      if (i >= data_xfer)
+        xfers[i].tx_nbits = xfers[i].rx_nbits = data_lines;
+    }
+
+    if (end < total)
+      xfers[xfer_cnt - 1].cs_change = 1;
+
+    // All phases of a message are clocked out with one syscall
+    ret = ioctl(dev->fd, SPI_IOC_MESSAGE(xfer_cnt), xfers);
+    off = end;
+  } while (ret >= 0 && off < total);
+
+  return (ret >= 0) ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+}
+
+memoree_err_t platform_spi_wait_ready(memoree_spi_if_t *interface, uint32_t timeout_ms)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  linux_spi_dev_t *dev = interface->dev_handle;
+  uint8_t status = 0;
+  struct spi_ioc_transfer xfer = {
+      .rx_buf = (uintptr_t)&status,
+      .len = 1,
+      .speed_hz = dev->speed,
+      .bits_per_word = 8,
+  };
+
+  // DO reads back as all ones while CS is asserted once the cycle has completed
+  uint64_t deadline = _get_time_ms() + timeout_ms;
+  do
+  {
+    if (ioctl(dev->fd, SPI_IOC_MESSAGE(1), &xfer) < 0)
+      return MEMOREE_ERR_FAIL;
+  } while (!status && _get_time_ms() < deadline);
+
+  return status ? MEMOREE_ERR_OK : MEMOREE_ERR_TIMEOUT;
+}
+
+memoree_err_t platform_spi_queue(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // spidev has no asynchronous interface, so the transaction completes before returning
+  linux_spi_dev_t *dev = interface->dev_handle;
+  dev->queued_ret = platform_spi_write_read(interface, spi_t);
+
+  return (dev->queued_ret == MEMOREE_ERR_INVALID_ARG) ? MEMOREE_ERR_INVALID_ARG : MEMOREE_ERR_OK;
+}
+
+memoree_err_t platform_spi_queue_result(memoree_spi_if_t *interface, uint32_t timeout_ms)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // The result is only reported once, as there is nothing queued any more after it has been collected
+  linux_spi_dev_t *dev = interface->dev_handle;
+  memoree_err_t ret = dev->queued_ret;
+  dev->queued_ret = MEMOREE_ERR_OK;
+  return ret;
+}
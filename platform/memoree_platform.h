@@ -6,18 +6,36 @@
 /// @brief SPI interface handle
 typedef struct 
 {
-  int port;         ///< Platform-specific peripheral identifier
-  int cs_pin;       ///< SPI chip select pin
-  void *dev_handle; ///< Memory device handle, optionally use as peripheral handle 
+  int port;              ///< Platform-specific peripheral identifier
+  int cs_pin;            ///< SPI chip select pin
+  void *dev_handle;      ///< Memory device handle, optionally use as peripheral handle 
+  uint8_t max_lines;     ///< Widest data path (1, 2 or 4 lines) that platform_spi_write_read() can use with this device
+  uint32_t max_transfer; ///< Largest data phase sent as a single bus transfer, longer ones are split with chip select kept asserted
 }memoree_spi_if_t;
 
-/// @brief Initialize an I2C peripheral
-/// @param i2c_conf Interface configuration
+/// @brief One segment of a vectored write, sent back to back with the segments around it
+typedef struct
+{
+  const uint8_t *buff; ///< Start of the segment
+  size_t len;          ///< Length of the segment in bytes
+} memoree_iovec_t;
+
+/// @brief Initialize an I2C peripheral that devices are then attached to with platform_i2c_init()
+/// @param bus_conf Port, pin and speed settings, the device address is ignored
+/// @return Platform-specific bus handle on success
+/// @return NULL on fail
+memoree_interface_t platform_i2c_bus_init(memoree_i2c_conf_t *bus_conf);
+
+/// @brief Deinitialize an I2C peripheral once every device attached to it has been deinitialized
+memoree_err_t platform_i2c_bus_deinit(memoree_interface_t bus);
+
+/// @brief Attach a device to an I2C bus initialized with platform_i2c_bus_init()
+/// @param i2c_conf Device configuration, only the address is used
 /// @return memoree_interface_t object on success
 /// @return NULL on fail
-memoree_interface_t platform_i2c_init(memoree_i2c_conf_t *i2c_conf);
+memoree_interface_t platform_i2c_init(memoree_interface_t bus, memoree_i2c_conf_t *i2c_conf);
 
-/// @brief Deinitialize an I2C peripheral and free allocated resources
+/// @brief Detach a device from its I2C bus and free allocated resources
 /// @param port Platform-specific I2C port identifier
 memoree_err_t platform_i2c_deinit(memoree_interface_t port);
 
@@ -42,26 +60,94 @@ int32_t platform_i2c_read(memoree_interface_t interface, uint8_t addr, uint8_t *
 int32_t platform_i2c_write(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff,
                            size_t write_size, size_t timeout_ms);
 
+/// @brief Write the \a seg_cnt segments of \a segs in order as the payload of a single I2C transaction, so a header
+///        such as a memory address can be sent ahead of the caller's buffer without first copying both into one buffer
+/// @param port Platform-specific I2C port identifier
+/// @param addr 7-bit I2C address
+/// @return Number of bytes written across all segments, on success
+/// @return memoree_err_t error code, on failure
+int32_t platform_i2c_writev(memoree_interface_t interface, uint8_t addr, const memoree_iovec_t *segs,
+                            size_t seg_cnt, size_t timeout_ms);
+
 /// @brief Writes \a write_size bytes, performs an I2C repeated start, then reads \a read_size bytes
 /// @param port Platform-specific I2C port identifier
 /// @param addr 7-bit I2C address
 memoree_err_t platform_i2c_write_read(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff, size_t write_size,
                                 uint8_t *read_buff, size_t read_size, size_t timeout_ms);
 
-/// @brief Initialize an SPI peripheral
-/// @param spi_conf Platform-specific SPI configuration
+/// @brief Initialize an SPI peripheral that devices are then attached to with platform_spi_init()
+/// @param bus_conf Port, pin and transfer settings, the device chip select, speed and mode are ignored
+/// @return Platform-specific bus handle on success
+/// @return NULL on fail
+memoree_interface_t platform_spi_bus_init(memoree_spi_conf_t *bus_conf);
+
+/// @brief Deinitialize an SPI peripheral once every device attached to it has been deinitialized
+memoree_err_t platform_spi_bus_deinit(memoree_interface_t bus);
+
+/// @brief Attach a device to an SPI bus initialized with platform_spi_bus_init()
+/// @param spi_conf Device configuration, only the chip select, speed, mode and max_transfer are used
 /// @return memoree_interface_t interface object, on success
 /// @return NULL, on failure
-memoree_interface_t platform_spi_init(memoree_spi_conf_t *spi_conf);
+memoree_interface_t platform_spi_init(memoree_interface_t bus, memoree_spi_conf_t *spi_conf);
 
-/// @brief Deinitialize an SPI peripheral and free allocated resources
+/// @brief Detach a device from its SPI bus and free allocated resources
 memoree_err_t platform_spi_deinit(memoree_spi_if_t *interface);
 
 /// @brief Write or read data on the SPI bus depending on transaction settings.
+/// @note The command phase is always sent on a single line. Transactions using more than one line must not both write and read data.
+/// @note Data phases longer than the interface's \a max_transfer are split into several bus transfers under a single
+///       chip select assertion, so the device sees one continuous transaction.
 /// @param spi_t SPI transaction information
 memoree_err_t platform_spi_write_read(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t);
 
+/// @brief Assert chip select and wait for the device to drive its data output high, signalling the end of a 93CXX
+///        write or erase cycle
+/// @return MEMOREE_ERR_TIMEOUT if the device is still busy after \a timeout_ms
+memoree_err_t platform_spi_wait_ready(memoree_spi_if_t *interface, uint32_t timeout_ms);
+
+/// @brief Start an SPI transaction without waiting for it to complete, keeping chip select asserted until it has
+/// @note Only one transaction can be queued per interface. \a spi_t and its buffers must remain valid until
+///       platform_spi_queue_result() reports completion. Platforms without queued transfers may complete it immediately.
+memoree_err_t platform_spi_queue(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t);
+
+/// @brief Wait up to \a timeout_ms for the transaction started by platform_spi_queue() to complete
+/// @return MEMOREE_ERR_TIMEOUT if the transaction is still in progress, the transaction's result otherwise
+memoree_err_t platform_spi_queue_result(memoree_spi_if_t *interface, uint32_t timeout_ms);
+
+#if MEMOREE_STATS
+/// @brief Count a transaction on \a interface that the platform repeats because the device did not acknowledge it
+/// @note Implemented by the library, to be called by platforms through PLATFORM_STATS_RETRY() on every repeated attempt
+void memoree_stats_retry(memoree_interface_t interface);
+#define PLATFORM_STATS_RETRY(interface) memoree_stats_retry(interface)
+#else
+#define PLATFORM_STATS_RETRY(interface) ((void)0)
+#endif
+
+/// @brief Mutex handle
+typedef void *memoree_mutex_t;
+
+/// @brief Create a recursive mutex, which the thread holding it can lock again
+/// @return Mutex handle on success
+/// @return NULL on fail
+memoree_mutex_t platform_mutex_create(void);
+
+/// @brief Delete a mutex created with platform_mutex_create(), which must not be locked
+void platform_mutex_delete(memoree_mutex_t mutex);
+
+/// @brief Lock \a mutex, blocking until it is available
+void platform_mutex_lock(memoree_mutex_t mutex);
+
+/// @brief Lock \a mutex if it is available, without blocking
+/// @return true if \a mutex has been locked
+bool platform_mutex_trylock(memoree_mutex_t mutex);
+
+/// @brief Unlock \a mutex, which must be held by the calling thread
+void platform_mutex_unlock(memoree_mutex_t mutex);
+
 /// @brief Millisecond delay implementation
 void platform_ms_delay(uint32_t ms);
 
+/// @brief Returns a monotonic timestamp in microseconds
+uint64_t platform_get_time_us(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,967 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "memoree_platform.h"
+#include "memoree_sim.h"
+#include "../memoree.h"
+
+#define MIN(x, y) ((x < y) ? x : y)
+#define MAX(x, y) ((x > y) ? x : y)
+
+#define SIM_I2C_START_STOP_BITS 2 ///< Start or repeated start and stop conditions, each costing about one bit time
+#define SIM_I2C_BYTE_BITS 9       ///< 8 data bits followed by an acknowledge bit
+#define SIM_SPI_CS_OVERHEAD_NS 50 ///< Chip select setup and hold time around an SPI transaction
+#define SIM_SPI_CHUNK_GAP_NS 2000 ///< Time to set up each further chunk of a transaction split at max_transfer
+#define SIM_SPI_MAX_TRANSFER 4096 ///< Largest data phase moved in one chunk when memoree_spi_conf_t leaves it at 0
+
+#define SIM_25XX_SR_WIP 0x01 ///< Status register Write-In-Progress bit
+#define SIM_25XX_SR_WEL 0x02 ///< Status register Write Enable Latch bit
+
+/// 25XX opcodes understood by the simulation in addition to those defined in memoree.h
+#define SIM_25XX_CMD_FAST_READ 0x0B ///< 1-1-1 Fast Read
+#define SIM_25XX_CMD_READ_112 0x3B  ///< 1-1-2 Dual Output Fast Read
+#define SIM_25XX_CMD_READ_122 0xBB  ///< 1-2-2 Dual I/O Fast Read
+#define SIM_25XX_CMD_READ_114 0x6B  ///< 1-1-4 Quad Output Fast Read
+#define SIM_25XX_CMD_READ_144 0xEB  ///< 1-4-4 Quad I/O Fast Read
+#define SIM_25XX_CMD_SE 0x20        ///< 4 KB Sector Erase
+#define SIM_25XX_CMD_BE32 0x52      ///< 32 KB Block Erase
+#define SIM_25XX_CMD_BE64 0xD8      ///< 64 KB Block Erase
+#define SIM_25XX_CMD_CE 0xC7        ///< Chip Erase
+#define SIM_25XX_CMD_CE_ALT 0x60    ///< Chip Erase, alternate opcode
+
+#define SIM_SFDP_BFPT_PTR 0x30   ///< Location of the generated Basic Flash Parameter Table
+#define SIM_SFDP_BFPT_DWORDS 16  ///< Length of the generated Basic Flash Parameter Table (JESD216B)
+#define SIM_JEDEC_MANUFACTURER 0xEF
+
+/// @brief State of a simulated chip
+typedef struct
+{
+  bool attached;
+  memoree_sim_conf_t conf;
+  uint8_t *data;                     ///< Memory array
+  uint8_t sfdp[MEMOREE_SIM_SFDP_SIZE]; ///< SFDP area (25XX only)
+  uint64_t busy_until_ns;            ///< Virtual time at which the current write or erase cycle completes
+  bool clear_wel;                    ///< Whether the write enable latch is reset when the current cycle completes (25XX only)
+  bool write_enabled;                ///< EWEN state (93CXX) or write enable latch (25XX)
+  uint32_t addr_ptr;                 ///< Internal address counter (24XX only)
+  memoree_sim_counters_t counters;
+} sim_chip_t;
+
+/// @brief I2C interface handle
+typedef struct
+{
+  int port;
+  uint32_t speed;
+} sim_i2c_if_t;
+
+/// @brief SPI bus handle
+typedef struct
+{
+  int port;
+  uint8_t max_lines;     ///< 4 when the HD and WP pins are given, 2 otherwise
+  uint32_t max_transfer; ///< Largest single transfer, see memoree_spi_conf_t
+} sim_spi_bus_t;
+
+/// @brief SPI device handle
+typedef struct
+{
+  uint32_t speed;
+  uint64_t queued_until_ns; ///< Virtual time at which the transaction passed to platform_spi_queue() completes
+} sim_spi_dev_t;
+
+static sim_chip_t sim_chips[MEMOREE_SIM_MAX_CHIPS];
+static uint64_t sim_time_ns;
+
+//////////////////////UTILITY FUNCTIONS
+
+/// @brief Advance the virtual clock by \a bits clock cycles at \a speed Hz
+static void _sim_clock(uint64_t bits, uint32_t speed)
+{
+  if (speed)
+    sim_time_ns += (bits * 1000000000ULL) / speed;
+}
+
+/// @brief Returns whether \a chip is in an internal cycle, completing the cycle if its time has elapsed
+static bool _sim_busy(sim_chip_t *chip)
+{
+  if (sim_time_ns < chip->busy_until_ns)
+    return true;
+
+  if (chip->clear_wel)
+  {
+    chip->write_enabled = false;
+    chip->clear_wel = false;
+  }
+
+  return false;
+}
+
+/// @brief Start an internal cycle that completes \a time_us from now
+static void _sim_start_cycle(sim_chip_t *chip, uint32_t time_us)
+{
+  chip->busy_until_ns = sim_time_ns + (uint64_t)time_us * 1000;
+  chip->clear_wel = (chip->conf.chip == MEMOREE_SIM_CHIP_25XX);
+}
+
+/// @brief Fill the read phase of \a t with the level the data line floats or is driven to
+static void _sim_fill(memoree_spi_transaction_t *t, uint8_t value)
+{
+  if (t->read_len)
+    memset(t->read_buff, value, t->read_len);
+}
+
+static uint8_t _sim_log2(uint64_t value)
+{
+  uint8_t n = 0;
+  while (value >>= 1)
+    n++;
+  return n;
+}
+
+/// @brief Encode \a time_us as a 5-bit count and 2-bit unit field, selecting the smallest of \a units that fits
+/// @return count(4:0) | units(6:5)
+static uint32_t _sim_encode_time(uint32_t time_us, const uint32_t units[4])
+{
+  uint8_t unit = 0;
+  while (unit < 3 && (time_us + units[unit] - 1) / units[unit] > 32)
+    unit++;
+
+  uint32_t count = (time_us + units[unit] - 1) / units[unit];
+  count = count ? MIN(count, 32) : 1;
+  return (count - 1) | (unit << 5);
+}
+
+static void _sim_put_dword(uint8_t *p, uint32_t dword)
+{
+  p[0] = dword;
+  p[1] = dword >> 8;
+  p[2] = dword >> 16;
+  p[3] = dword >> 24;
+}
+
+/// @brief Generate a JESD216B SFDP area matching the geometry and timing of \a chip
+static void _sim_build_sfdp(sim_chip_t *chip)
+{
+  static const uint32_t erase_units[4] = {1000, 16000, 128000, 1000000};
+  static const uint32_t chip_erase_units[4] = {16000, 256000, 4000000, 64000000};
+
+  memoree_sim_conf_t *c = &chip->conf;
+  uint8_t *s = chip->sfdp;
+  uint64_t bits = (uint64_t)c->size * 8;
+  bool addr_4byte = c->size > (1UL << 24);
+  uint32_t bfpt[SIM_SFDP_BFPT_DWORDS];
+
+  memset(s, 0xFF, MEMOREE_SIM_SFDP_SIZE);
+
+  // SFDP header followed by a single parameter header pointing to the BFPT
+  memcpy(s, "SFDP", 4);
+  s[4] = 0x06;
+  s[5] = 0x01;
+  s[6] = 0x00;
+  s[7] = 0xFF;
+  s[8] = 0x00;
+  s[9] = 0x06;
+  s[10] = 0x01;
+  s[11] = SIM_SFDP_BFPT_DWORDS;
+  s[12] = SIM_SFDP_BFPT_PTR;
+  s[13] = 0x00;
+  s[14] = 0x00;
+  s[15] = 0xFF;
+
+  // 4 KB erase, 64 byte write granularity, 1-1-2, 1-2-2, 1-4-4 and 1-1-4 reads
+  bfpt[0] = 0xFF800000 | (1 << 22) | (1 << 21) | (1 << 20) | ((addr_4byte ? 0b10 : 0b00) << 17) | (1 << 16) |
+            (SIM_25XX_CMD_SE << 8) | (0b111 << 5) | (1 << 2) | 0b01;
+  bfpt[1] = (bits > (1ULL << 31)) ? (0x80000000 | _sim_log2(bits)) : (uint32_t)(bits - 1);
+  bfpt[2] = ((uint32_t)SIM_25XX_CMD_READ_114 << 24) | (8 << 16) | (SIM_25XX_CMD_READ_144 << 8) | (2 << 5) | 4;
+  bfpt[3] = ((uint32_t)SIM_25XX_CMD_READ_122 << 24) | (4 << 21) | (SIM_25XX_CMD_READ_112 << 8) | 8;
+  bfpt[4] = 0xFFFFFFEE;
+  bfpt[5] = 0x0000FFFF;
+  bfpt[6] = 0x0000FFFF;
+  bfpt[7] = ((uint32_t)SIM_25XX_CMD_BE32 << 24) | (15 << 16) | (SIM_25XX_CMD_SE << 8) | 12;
+  bfpt[8] = (SIM_25XX_CMD_BE64 << 8) | 16;
+
+  // Typical erase times with a maximum of 2 * (2 + 1) = 6 times the typical time
+  bfpt[9] = (_sim_encode_time(c->block_erase_time_us, erase_units) << 18) |
+            (_sim_encode_time(c->block_erase_time_us, erase_units) << 11) |
+            (_sim_encode_time(c->erase_time_us, erase_units) << 4) | 2;
+
+  // Page program time in units of 8us or 64us
+  uint32_t pp_time = (c->write_time_us + 7) / 8;
+  uint32_t pp_field = (pp_time <= 32) ? (MAX(pp_time, 1) - 1) : ((1 << 5) | (MIN((c->write_time_us + 63) / 64, 32) - 1));
+  bfpt[10] = (_sim_encode_time(c->chip_erase_time_us, chip_erase_units) << 24) | (pp_field << 8) |
+             (_sim_log2(c->page_size) << 4) | 2;
+
+  bfpt[11] = 0x80000000; // Suspend/resume not supported
+  bfpt[12] = 0xFFFFFFFF;
+  bfpt[13] = 0x80000000; // Deep power down not supported
+  bfpt[14] = 0x00000000; // No quad enable bit
+  bfpt[15] = addr_4byte ? (1 << 30) : 0;
+
+  for (int i = 0; i < SIM_SFDP_BFPT_DWORDS; i++)
+    _sim_put_dword(&s[SIM_SFDP_BFPT_PTR + i * 4], bfpt[i]);
+}
+
+/// @brief Find the 24XX chip that answers to the 7-bit I2C address \a addr on \a port
+/// @param block Set to the block selected by the low bits of \a addr
+static sim_chip_t *_sim_find_i2c(int port, uint8_t addr, uint32_t *block)
+{
+  for (int i = 0; i < MEMOREE_SIM_MAX_CHIPS; i++)
+  {
+    sim_chip_t *chip = &sim_chips[i];
+    if (!chip->attached || chip->conf.chip != MEMOREE_SIM_CHIP_24XX || chip->conf.port != port)
+      continue;
+
+    // High address bits of parts larger than their address phase are taken from the low bits of the I2C address
+    uint32_t block_size = MIN(chip->conf.size, 1UL << chip->conf.addr_len);
+    uint8_t block_mask = (chip->conf.size / block_size) - 1;
+
+    if ((addr & ~block_mask) == chip->conf.addr)
+    {
+      *block = addr & block_mask;
+      return chip;
+    }
+  }
+
+  return NULL;
+}
+
+static sim_chip_t *_sim_find_spi(int port, int cs_pin)
+{
+  for (int i = 0; i < MEMOREE_SIM_MAX_CHIPS; i++)
+  {
+    sim_chip_t *chip = &sim_chips[i];
+    if (chip->attached && chip->conf.chip != MEMOREE_SIM_CHIP_24XX && chip->conf.port == port &&
+        chip->conf.cs_pin == cs_pin)
+      return chip;
+  }
+
+  return NULL;
+}
+
+/// @brief Move the 24XX address counter forward, rolling over within the current block
+static void _sim_24xx_next(sim_chip_t *chip)
+{
+  uint32_t block_size = MIN(chip->conf.size, 1UL << chip->conf.addr_len);
+  uint32_t block_base = chip->addr_ptr & ~(block_size - 1);
+  chip->addr_ptr = block_base + ((chip->addr_ptr + 1) & (block_size - 1));
+}
+
+static void _sim_24xx_read(sim_chip_t *chip, uint8_t *read_buff, size_t read_size)
+{
+  for (size_t i = 0; i < read_size; i++)
+  {
+    read_buff[i] = chip->data[chip->addr_ptr];
+    _sim_24xx_next(chip);
+  }
+
+  chip->counters.bytes += read_size;
+}
+
+/// @brief Handle an addressed 24XX write: set the address counter and program any data that follows it
+static void _sim_24xx_write(sim_chip_t *chip, uint32_t block, const memoree_iovec_t *segs, size_t seg_cnt)
+{
+  uint8_t addr_bytes = chip->conf.addr_len / 8;
+  uint32_t addr = 0;
+  size_t pos = 0;
+  uint32_t page_base = 0;
+  uint32_t offset = 0;
+
+  for (size_t s = 0; s < seg_cnt; s++)
+  {
+    for (size_t i = 0; i < segs[s].len; i++, pos++)
+    {
+      if (pos < addr_bytes)
+      {
+        addr = (addr << 8) | segs[s].buff[i];
+        if (pos + 1 == addr_bytes)
+        {
+          chip->addr_ptr = ((block << chip->conf.addr_len) | addr) & (chip->conf.size - 1);
+          page_base = chip->addr_ptr & ~(uint32_t)(chip->conf.page_size - 1);
+          offset = chip->addr_ptr - page_base;
+        }
+        continue;
+      }
+
+      // Data rolls over within the addressed page
+      chip->data[page_base + offset] = segs[s].buff[i];
+      offset = (offset + 1) % chip->conf.page_size;
+    }
+  }
+
+  if (pos <= addr_bytes)
+    return;
+
+  chip->addr_ptr = page_base + offset;
+  chip->counters.bytes += pos - addr_bytes;
+  chip->counters.programs++;
+  _sim_start_cycle(chip, chip->conf.write_time_us);
+}
+
+/// @brief Handle a Microwire transaction: start bit, 2 opcode bits and the address, followed by data
+static void _sim_93cxx_transfer(sim_chip_t *chip, memoree_spi_transaction_t *t)
+{
+  uint8_t addr_len = chip->conf.addr_len;
+  uint8_t bit_cnt = t->cmd_len + t->addr_len;
+  uint64_t bits = ((uint64_t)t->cmd << t->addr_len) | (t->addr & ((1ULL << t->addr_len) - 1));
+
+  // Leading zeros are clocked in while the part waits for its start bit
+  while (bit_cnt && !((bits >> (bit_cnt - 1)) & 1))
+    bit_cnt--;
+
+  // Without a start bit, DO reports ready (high) or busy (low) while CS is asserted
+  if (!bit_cnt)
+  {
+    _sim_fill(t, _sim_busy(chip) ? 0x00 : 0xFF);
+    return;
+  }
+
+  if (_sim_busy(chip) || bit_cnt < 3 + addr_len)
+  {
+    chip->counters.busy_rejects += _sim_busy(chip);
+    _sim_fill(t, 0xFF);
+    return;
+  }
+
+  bit_cnt--;
+  uint8_t opcode = (bits >> (bit_cnt - 2)) & 0b11;
+  bit_cnt -= 2;
+  uint32_t addr = (bits >> (bit_cnt - addr_len)) & ((1UL << addr_len) - 1);
+  addr &= chip->conf.size - 1;
+
+  switch (opcode)
+  {
+  case MEMOREE_CMD_93CXX_READ & 0b11:
+    for (uint32_t i = 0; i < t->read_len; i++)
+      t->read_buff[i] = chip->data[(addr + i) & (chip->conf.size - 1)];
+    chip->counters.bytes += t->read_len;
+    break;
+
+  case MEMOREE_CMD_93CXX_WRITE & 0b11:
+    if (!chip->write_enabled || !t->write_len)
+      break;
+    chip->data[addr] = t->write_buff[0];
+    chip->counters.bytes++;
+    chip->counters.programs++;
+    _sim_start_cycle(chip, chip->conf.write_time_us);
+    break;
+
+  case MEMOREE_CMD_93CXX_ERASE & 0b11:
+    if (!chip->write_enabled)
+      break;
+    chip->data[addr] = 0xFF;
+    chip->counters.erases++;
+    _sim_start_cycle(chip, chip->conf.erase_time_us);
+    break;
+
+  default:
+    // The two most significant address bits extend the opcode
+    switch ((addr >> (addr_len - 2)) & 0b11)
+    {
+    case MEMOREE_CMD_93CXX_WEN & 0b11:
+      chip->write_enabled = true;
+      break;
+    case MEMOREE_CMD_93CXX_WDS & 0b11:
+      chip->write_enabled = false;
+      break;
+    case MEMOREE_CMD_93CXX_ERAL & 0b11:
+      if (!chip->write_enabled)
+        break;
+      memset(chip->data, 0xFF, chip->conf.size);
+      chip->counters.erases++;
+      _sim_start_cycle(chip, chip->conf.chip_erase_time_us);
+      break;
+    case MEMOREE_CMD_93CXX_WRAL & 0b11:
+      if (!chip->write_enabled || !t->write_len)
+        break;
+      memset(chip->data, t->write_buff[0], chip->conf.size);
+      chip->counters.bytes++;
+      chip->counters.programs++;
+      _sim_start_cycle(chip, chip->conf.chip_erase_time_us);
+      break;
+    }
+    break;
+  }
+}
+
+/// @brief Erase the \a size byte region containing \a addr if the write enable latch is set
+static void _sim_25xx_erase(sim_chip_t *chip, uint32_t addr, uint32_t size, uint32_t time_us)
+{
+  if (!chip->write_enabled)
+    return;
+
+  size = MIN(size, chip->conf.size);
+  memset(&chip->data[addr & ~(size - 1)], 0xFF, size);
+  chip->counters.erases++;
+  _sim_start_cycle(chip, time_us);
+}
+
+static void _sim_25xx_transfer(sim_chip_t *chip, memoree_spi_transaction_t *t)
+{
+  uint8_t cmd = t->cmd;
+  // Simulated parts use 3-byte addresses up to 16 MB and 4-byte addresses above, as advertised by their SFDP table.
+  // Anything clocked in after the address are mode bits.
+  uint8_t addr_bits = (chip->conf.size > (1UL << 24)) ? 32 : 24;
+  uint32_t addr = ((t->addr_len > addr_bits) ? t->addr >> (t->addr_len - addr_bits) : t->addr) & (chip->conf.size - 1);
+
+  if (_sim_busy(chip) && cmd != MEMOREE_CMD_25XX_RDSR)
+  {
+    chip->counters.busy_rejects++;
+    _sim_fill(t, 0xFF);
+    return;
+  }
+
+  switch (cmd)
+  {
+  case MEMOREE_CMD_25XX_WREN:
+    chip->write_enabled = true;
+    break;
+
+  case MEMOREE_CMD_25XX_WRDI:
+    chip->write_enabled = false;
+    break;
+
+  case MEMOREE_CMD_25XX_RDSR:
+    _sim_fill(t, (_sim_busy(chip) ? SIM_25XX_SR_WIP : 0) | (chip->write_enabled ? SIM_25XX_SR_WEL : 0));
+    break;
+
+  case MEMOREE_CMD_25XX_READ:
+  case SIM_25XX_CMD_FAST_READ:
+  case SIM_25XX_CMD_READ_112:
+  case SIM_25XX_CMD_READ_122:
+  case SIM_25XX_CMD_READ_114:
+  case SIM_25XX_CMD_READ_144:
+    for (uint32_t i = 0; i < t->read_len; i++)
+      t->read_buff[i] = chip->data[(addr + i) & (chip->conf.size - 1)];
+    chip->counters.bytes += t->read_len;
+    break;
+
+  case MEMOREE_CMD_25XX_SFDP:
+    for (uint32_t i = 0; i < t->read_len; i++)
+      t->read_buff[i] = (t->addr + i < MEMOREE_SIM_SFDP_SIZE) ? chip->sfdp[t->addr + i] : 0xFF;
+    break;
+
+  case MEMOREE_CMD_25XX_RDID:
+  {
+    uint8_t id[3] = {SIM_JEDEC_MANUFACTURER, 0x40, _sim_log2(chip->conf.size)};
+    for (uint32_t i = 0; i < t->read_len; i++)
+      t->read_buff[i] = (i < sizeof(id)) ? id[i] : 0xFF;
+    break;
+  }
+
+  case MEMOREE_CMD_25XX_PP:
+  {
+    if (!chip->write_enabled)
+      break;
+
+    // Programming can only clear bits and rolls over within the addressed page
+    uint32_t page_base = addr & ~(uint32_t)(chip->conf.page_size - 1);
+    uint32_t offset = addr - page_base;
+    for (uint32_t i = 0; i < t->write_len; i++)
+    {
+      chip->data[page_base + offset] &= t->write_buff[i];
+      offset = (offset + 1) % chip->conf.page_size;
+    }
+    chip->counters.bytes += t->write_len;
+    chip->counters.programs++;
+    _sim_start_cycle(chip, chip->conf.write_time_us);
+    break;
+  }
+
+  case SIM_25XX_CMD_SE:
+    _sim_25xx_erase(chip, addr, 4096, chip->conf.erase_time_us);
+    break;
+
+  case SIM_25XX_CMD_BE32:
+    _sim_25xx_erase(chip, addr, 32768, chip->conf.block_erase_time_us);
+    break;
+
+  case SIM_25XX_CMD_BE64:
+    _sim_25xx_erase(chip, addr, 65536, chip->conf.block_erase_time_us);
+    break;
+
+  case SIM_25XX_CMD_CE:
+  case SIM_25XX_CMD_CE_ALT:
+    _sim_25xx_erase(chip, 0, chip->conf.size, chip->conf.chip_erase_time_us);
+    break;
+
+  default:
+    _sim_fill(t, 0xFF);
+    break;
+  }
+}
+
+//////////////////////SIMULATION CONTROL
+
+int memoree_sim_add(const memoree_sim_conf_t *conf)
+{
+  if (!conf || !conf->size || (conf->size & (conf->size - 1)) || !conf->page_size ||
+      (conf->page_size & (conf->page_size - 1)) || conf->sfdp_len > MEMOREE_SIM_SFDP_SIZE)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  if (conf->chip != MEMOREE_SIM_CHIP_25XX && (!conf->addr_len || conf->addr_len > 24))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  for (int i = 0; i < MEMOREE_SIM_MAX_CHIPS; i++)
+  {
+    sim_chip_t *chip = &sim_chips[i];
+    if (chip->attached)
+      continue;
+
+    memset(chip, 0, sizeof(sim_chip_t));
+    chip->data = malloc(conf->size);
+    if (!chip->data)
+      return MEMOREE_ERR_MEM;
+
+    memset(chip->data, 0xFF, conf->size);
+    memcpy(&chip->conf, conf, sizeof(memoree_sim_conf_t));
+
+    if (conf->chip == MEMOREE_SIM_CHIP_25XX)
+    {
+      if (conf->sfdp)
+      {
+        memset(chip->sfdp, 0xFF, sizeof(chip->sfdp));
+        memcpy(chip->sfdp, conf->sfdp, conf->sfdp_len);
+      }
+      else
+        _sim_build_sfdp(chip);
+    }
+
+    chip->conf.sfdp = NULL;
+    chip->attached = true;
+    return i;
+  }
+
+  return MEMOREE_ERR_MEM;
+}
+
+void memoree_sim_reset(void)
+{
+  for (int i = 0; i < MEMOREE_SIM_MAX_CHIPS; i++)
+  {
+    free(sim_chips[i].data);
+    memset(&sim_chips[i], 0, sizeof(sim_chip_t));
+  }
+
+  sim_time_ns = 0;
+}
+
+uint8_t *memoree_sim_data(int chip)
+{
+  if (chip < 0 || chip >= MEMOREE_SIM_MAX_CHIPS || !sim_chips[chip].attached)
+    return NULL;
+
+  return sim_chips[chip].data;
+}
+
+bool memoree_sim_busy(int chip)
+{
+  if (chip < 0 || chip >= MEMOREE_SIM_MAX_CHIPS || !sim_chips[chip].attached)
+    return false;
+
+  return _sim_busy(&sim_chips[chip]);
+}
+
+memoree_err_t memoree_sim_get_counters(int chip, memoree_sim_counters_t *counters)
+{
+  if (chip < 0 || chip >= MEMOREE_SIM_MAX_CHIPS || !sim_chips[chip].attached || !counters)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memcpy(counters, &sim_chips[chip].counters, sizeof(memoree_sim_counters_t));
+  return MEMOREE_ERR_OK;
+}
+
+uint64_t memoree_sim_time_us(void)
+{
+  return sim_time_ns / 1000;
+}
+
+//////////////////////PLATFORM FUNCTIONS
+
+void platform_ms_delay(uint32_t ms)
+{
+  sim_time_ns += (uint64_t)ms * 1000000;
+}
+
+uint64_t platform_get_time_us(void)
+{
+  return memoree_sim_time_us();
+}
+
+memoree_mutex_t platform_mutex_create(void)
+{
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0)
+    return NULL;
+
+  pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+  if (mutex && (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0 || pthread_mutex_init(mutex, &attr) != 0))
+  {
+    free(mutex);
+    mutex = NULL;
+  }
+
+  pthread_mutexattr_destroy(&attr);
+  return mutex;
+}
+
+void platform_mutex_delete(memoree_mutex_t mutex)
+{
+  if (!mutex)
+    return;
+
+  pthread_mutex_destroy(mutex);
+  free(mutex);
+}
+
+void platform_mutex_lock(memoree_mutex_t mutex)
+{
+  pthread_mutex_lock(mutex);
+}
+
+bool platform_mutex_trylock(memoree_mutex_t mutex)
+{
+  return pthread_mutex_trylock(mutex) == 0;
+}
+
+void platform_mutex_unlock(memoree_mutex_t mutex)
+{
+  pthread_mutex_unlock(mutex);
+}
+
+/// I2C functions
+memoree_interface_t platform_i2c_bus_init(memoree_i2c_conf_t *bus_conf)
+{
+  if (!bus_conf || !bus_conf->speed)
+    return NULL;
+
+  sim_i2c_if_t *bus = malloc(sizeof(sim_i2c_if_t));
+  if (!bus)
+    return NULL;
+
+  bus->port = bus_conf->port;
+  bus->speed = bus_conf->speed;
+  return bus;
+}
+
+memoree_err_t platform_i2c_bus_deinit(memoree_interface_t bus)
+{
+  if (!bus)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  free(bus);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_i2c_init(memoree_interface_t bus, memoree_i2c_conf_t *i2c_conf)
+{
+  if (!bus || !i2c_conf)
+    return NULL;
+
+  // Chips are selected by the address of each transfer, so devices use the bus handle directly
+  return bus;
+}
+
+memoree_err_t platform_i2c_deinit(memoree_interface_t interface)
+{
+  if (!interface)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  return MEMOREE_ERR_OK;
+}
+
+/// @brief Clock out a start condition and the address byte
+/// @return The addressed chip if it acknowledged, NULL otherwise
+static sim_chip_t *_sim_i2c_address(sim_i2c_if_t *i2c, uint8_t addr, uint32_t *block)
+{
+  _sim_clock(SIM_I2C_START_STOP_BITS / 2 + SIM_I2C_BYTE_BITS, i2c->speed);
+
+  sim_chip_t *chip = _sim_find_i2c(i2c->port, addr, block);
+  if (!chip)
+    return NULL;
+
+  chip->counters.transactions++;
+  if (_sim_busy(chip))
+  {
+    chip->counters.nacks++;
+    return NULL;
+  }
+
+  return chip;
+}
+
+memoree_err_t platform_i2c_ping(memoree_interface_t interface, uint8_t addr, uint32_t timeout_ms)
+{
+  if (!interface)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint32_t block;
+  sim_chip_t *chip = _sim_i2c_address(interface, addr, &block);
+  _sim_clock(SIM_I2C_START_STOP_BITS / 2, ((sim_i2c_if_t *)interface)->speed);
+
+  return chip ? MEMOREE_ERR_OK : MEMOREE_ERR_FAIL;
+}
+
+int32_t platform_i2c_read(memoree_interface_t interface, uint8_t addr, uint8_t *read_buff,
+                          size_t read_size, size_t timeout_ms)
+{
+  if (!interface || (read_size && !read_buff))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  sim_i2c_if_t *i2c = interface;
+  uint32_t block;
+  sim_chip_t *chip = _sim_i2c_address(i2c, addr, &block);
+  if (!chip)
+  {
+    _sim_clock(SIM_I2C_START_STOP_BITS / 2, i2c->speed);
+    return MEMOREE_ERR_FAIL;
+  }
+
+  _sim_24xx_read(chip, read_buff, read_size);
+  _sim_clock(read_size * SIM_I2C_BYTE_BITS + SIM_I2C_START_STOP_BITS / 2, i2c->speed);
+
+  return read_size;
+}
+
+int32_t platform_i2c_writev(memoree_interface_t interface, uint8_t addr, const memoree_iovec_t *segs,
+                            size_t seg_cnt, size_t timeout_ms)
+{
+  if (!interface || (seg_cnt && !segs))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  size_t write_size = 0;
+  for (size_t s = 0; s < seg_cnt; s++)
+  {
+    if (segs[s].len && !segs[s].buff)
+      return MEMOREE_ERR_INVALID_ARG;
+    write_size += segs[s].len;
+  }
+
+  sim_i2c_if_t *i2c = interface;
+  uint32_t block;
+  sim_chip_t *chip;
+
+  /// Retry as long as a timeout has not occured
+  uint64_t start = sim_time_ns;
+  uint32_t attempts = 0;
+  do
+  {
+    if (attempts++)
+      PLATFORM_STATS_RETRY(interface);
+    chip = _sim_i2c_address(i2c, addr, &block);
+    if (!chip)
+      _sim_clock(SIM_I2C_START_STOP_BITS / 2, i2c->speed);
+  } while (!chip && sim_time_ns < start + (uint64_t)timeout_ms * 1000000);
+
+  if (!chip)
+    return (timeout_ms) ? MEMOREE_ERR_TIMEOUT : MEMOREE_ERR_FAIL;
+
+  _sim_clock(write_size * SIM_I2C_BYTE_BITS + SIM_I2C_START_STOP_BITS / 2, i2c->speed);
+  _sim_24xx_write(chip, block, segs, seg_cnt);
+
+  return write_size;
+}
+
+int32_t platform_i2c_write(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff,
+                           size_t write_size, size_t timeout_ms)
+{
+  if (!write_buff)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  memoree_iovec_t seg = {.buff = write_buff, .len = write_size};
+  return platform_i2c_writev(interface, addr, &seg, 1, timeout_ms);
+}
+
+memoree_err_t platform_i2c_write_read(memoree_interface_t interface, uint8_t addr, uint8_t *write_buff, size_t write_size,
+                                      uint8_t *read_buff, size_t read_size, size_t timeout_ms)
+{
+  if (!interface || (write_size && !write_buff) || (read_size && !read_buff))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  sim_i2c_if_t *i2c = interface;
+  uint32_t block;
+  sim_chip_t *chip = _sim_i2c_address(i2c, addr, &block);
+  if (!chip)
+  {
+    _sim_clock(SIM_I2C_START_STOP_BITS / 2, i2c->speed);
+    return MEMOREE_ERR_FAIL;
+  }
+
+  memoree_iovec_t seg = {.buff = write_buff, .len = write_size};
+  _sim_clock(write_size * SIM_I2C_BYTE_BITS, i2c->speed);
+  _sim_24xx_write(chip, block, &seg, 1);
+
+  // Repeated start, address byte with the read bit set, then the data
+  _sim_clock(SIM_I2C_START_STOP_BITS / 2 + SIM_I2C_BYTE_BITS, i2c->speed);
+  _sim_24xx_read(chip, read_buff, read_size);
+  _sim_clock(read_size * SIM_I2C_BYTE_BITS + SIM_I2C_START_STOP_BITS / 2, i2c->speed);
+
+  return MEMOREE_ERR_OK;
+}
+
+///////////////////////////////SPI FUNCTIONS
+
+memoree_interface_t platform_spi_bus_init(memoree_spi_conf_t *bus_conf)
+{
+  if (!bus_conf)
+    return NULL;
+
+  sim_spi_bus_t *bus = malloc(sizeof(sim_spi_bus_t));
+  if (!bus)
+    return NULL;
+
+  bus->port = bus_conf->port;
+  bus->max_lines = (bus_conf->hd_pin >= 0 && bus_conf->wp_pin >= 0) ? 4 : 2;
+  bus->max_transfer = bus_conf->max_transfer ? bus_conf->max_transfer : SIM_SPI_MAX_TRANSFER;
+  return bus;
+}
+
+memoree_err_t platform_spi_bus_deinit(memoree_interface_t bus)
+{
+  if (!bus)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  free(bus);
+  return MEMOREE_ERR_OK;
+}
+
+memoree_interface_t platform_spi_init(memoree_interface_t bus, memoree_spi_conf_t *spi_conf)
+{
+  if (!bus || !spi_conf || !spi_conf->speed)
+    return NULL;
+
+  sim_spi_bus_t *spi_bus = bus;
+
+  memoree_spi_if_t *interface = malloc(sizeof(memoree_spi_if_t));
+  sim_spi_dev_t *dev = malloc(sizeof(sim_spi_dev_t));
+  if (!interface || !dev)
+  {
+    free(interface);
+    free(dev);
+    return NULL;
+  }
+
+  dev->speed = spi_conf->speed;
+  dev->queued_until_ns = 0;
+  interface->port = spi_bus->port;
+  interface->cs_pin = spi_conf->cs_pin;
+  interface->dev_handle = dev;
+  interface->max_lines = spi_bus->max_lines;
+  interface->max_transfer = (spi_conf->max_transfer && spi_conf->max_transfer < spi_bus->max_transfer) ? spi_conf->max_transfer
+                                                                                                       : spi_bus->max_transfer;
+
+  return interface;
+}
+
+memoree_err_t platform_spi_deinit(memoree_spi_if_t *interface)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  free(interface->dev_handle);
+  free(interface);
+  return MEMOREE_ERR_OK;
+}
+
+/// @brief Apply \a spi_t to the selected chip and return the virtual time the transaction takes on the bus in \a duration_ns
+static memoree_err_t _sim_spi_transfer(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t, uint64_t *duration_ns)
+{
+  if (!interface || !interface->dev_handle || !spi_t || (spi_t->write_len && !spi_t->write_buff) ||
+      (spi_t->read_len && !spi_t->read_buff))
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint32_t speed = ((sim_spi_dev_t *)interface->dev_handle)->speed;
+  uint8_t addr_lines = spi_t->addr_lines ? spi_t->addr_lines : 1;
+  uint8_t data_lines = spi_t->data_lines ? spi_t->data_lines : 1;
+  if ((addr_lines > 1 || data_lines > 1) && spi_t->write_len && spi_t->read_len)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  // Dummy cycles are counted in clocks, the address and data phases shift out one bit per line each clock
+  uint64_t bits = spi_t->cmd_len + (spi_t->addr_len + addr_lines - 1) / addr_lines + spi_t->dummy_len +
+                  ((uint64_t)MAX(spi_t->write_len, spi_t->read_len) * 8 + data_lines - 1) / data_lines;
+
+  // Data phases longer than max_transfer move in several chunks while chip select stays asserted
+  uint32_t data_len = MAX(spi_t->write_len, spi_t->read_len);
+  uint32_t chunks = data_len ? (data_len + interface->max_transfer - 1) / interface->max_transfer : 1;
+
+  sim_chip_t *chip = _sim_find_spi(interface->port, interface->cs_pin);
+  // Nothing drives the data input line when no chip is selected
+  if (!chip)
+    _sim_fill(spi_t, 0xFF);
+  else
+  {
+    chip->counters.transactions++;
+    chip->counters.chunks += chunks;
+    if (chip->conf.chip == MEMOREE_SIM_CHIP_93CXX)
+      _sim_93cxx_transfer(chip, spi_t);
+    else
+      _sim_25xx_transfer(chip, spi_t);
+  }
+
+  *duration_ns = SIM_SPI_CS_OVERHEAD_NS + (chunks - 1) * SIM_SPI_CHUNK_GAP_NS + (bits * 1000000000ULL) / speed;
+
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t platform_spi_write_read(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+{
+  uint64_t duration_ns = 0;
+  memoree_err_t ret = _sim_spi_transfer(interface, spi_t, &duration_ns);
+
+  sim_time_ns += duration_ns;
+  return ret;
+}
+
+memoree_err_t platform_spi_wait_ready(memoree_spi_if_t *interface, uint32_t timeout_ms)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint8_t status = 0;
+  memoree_spi_transaction_t t = {
+      .read_len = 1,
+      .read_buff = &status,
+  };
+
+  // Clock in DO without a start bit until the chip reports ready
+  uint64_t deadline = sim_time_ns + (uint64_t)timeout_ms * 1000000;
+  do
+  {
+    platform_spi_write_read(interface, &t);
+  } while (!status && sim_time_ns < deadline);
+
+  return status ? MEMOREE_ERR_OK : MEMOREE_ERR_TIMEOUT;
+}
+
+memoree_err_t platform_spi_queue(memoree_spi_if_t *interface, memoree_spi_transaction_t *spi_t)
+{
+  uint64_t duration_ns = 0;
+  memoree_err_t ret = _sim_spi_transfer(interface, spi_t, &duration_ns);
+  if (ret != MEMOREE_ERR_OK)
+    return ret;
+
+  // The bus is busy in the background while the caller's virtual clock keeps running
+  ((sim_spi_dev_t *)interface->dev_handle)->queued_until_ns = sim_time_ns + duration_ns;
+  return MEMOREE_ERR_OK;
+}
+
+memoree_err_t platform_spi_queue_result(memoree_spi_if_t *interface, uint32_t timeout_ms)
+{
+  if (!interface || !interface->dev_handle)
+    return MEMOREE_ERR_INVALID_ARG;
+
+  uint64_t until_ns = ((sim_spi_dev_t *)interface->dev_handle)->queued_until_ns;
+  if (sim_time_ns >= until_ns)
+    return MEMOREE_ERR_OK;
+
+  if (sim_time_ns + (uint64_t)timeout_ms * 1000000 < until_ns)
+  {
+    sim_time_ns += (uint64_t)timeout_ms * 1000000;
+    return MEMOREE_ERR_TIMEOUT;
+  }
+
+  sim_time_ns = until_ns;
+  return MEMOREE_ERR_OK;
+}
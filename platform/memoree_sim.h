@@ -0,0 +1,77 @@
+#ifndef _MEMOREE_SIM_H_
+#define _MEMOREE_SIM_H_
+
+/**
+ * @file    memoree_sim.h
+ * @brief   Control interface of the simulated platform implemented in memoree_sim.c
+ * @note    The simulated platform replaces memoree_espidf.c or memoree_linux.c at link time. Chips are attached to a
+ *          port with memoree_sim_add() before calling memoree_init() on the same port, chip select or address.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../memoree.h"
+
+#define MEMOREE_SIM_MAX_CHIPS 16    ///< Maximum number of chips that can be attached at the same time
+#define MEMOREE_SIM_SFDP_SIZE 256   ///< Size of the SFDP area served by a simulated 25XX part
+
+/// @brief Families of simulated memory ICs
+typedef enum
+{
+  MEMOREE_SIM_CHIP_24XX,  ///< I2C EEPROM
+  MEMOREE_SIM_CHIP_93CXX, ///< Microwire EEPROM in x8 organization
+  MEMOREE_SIM_CHIP_25XX,  ///< SFDP-capable SPI flash
+} memoree_sim_chip_t;
+
+/// @brief Description of a simulated memory IC
+typedef struct
+{
+  memoree_sim_chip_t chip;      ///< Chip family
+  int port;                     ///< Port the chip is attached to, as passed in memoree_i2c_conf_t or memoree_spi_conf_t
+  uint8_t addr;                 ///< 7-bit I2C address with the block select bits cleared (24XX only)
+  int cs_pin;                   ///< Chip select pin (93CXX and 25XX only)
+  uint32_t size;                ///< Size in bytes, must be a power of 2. 25XX parts over 16 MB use 4-byte addresses.
+  uint16_t page_size;           ///< Page size in bytes, writes roll over within a page
+  uint8_t addr_len;             ///< Number of address bits sent in the address phase (24XX and 93CXX only)
+  uint32_t write_time_us;       ///< Write cycle time (tWR) for EEPROMs, page program time (tPP) for flash
+  uint32_t erase_time_us;       ///< 4 KB sector erase time (tSE) for flash, ERASE time for 93CXX
+  uint32_t block_erase_time_us; ///< 32 KB and 64 KB block erase time (tBE) for flash
+  uint32_t chip_erase_time_us;  ///< Chip erase time for flash, ERAL and WRAL time for 93CXX
+  const uint8_t *sfdp;          ///< SFDP area served by the SFDP read command, or NULL to generate one from this description
+  uint32_t sfdp_len;            ///< Length of \a sfdp in bytes, at most MEMOREE_SIM_SFDP_SIZE
+} memoree_sim_conf_t;
+
+/// @brief Activity counters of a simulated chip
+typedef struct
+{
+  uint32_t transactions; ///< Bus transactions addressed to the chip
+  uint64_t bytes;        ///< Bytes clocked in either direction, excluding command and address phases
+  uint32_t nacks;        ///< I2C transactions not acknowledged because the chip was busy
+  uint32_t busy_rejects; ///< Commands ignored because the chip was busy
+  uint32_t programs;     ///< Write or page program cycles started
+  uint32_t erases;       ///< Erase cycles started
+  uint32_t chunks;       ///< SPI transfers after splitting data phases at max_transfer (see memoree_spi_conf_t)
+} memoree_sim_counters_t;
+
+/// @brief Attach a simulated chip to the bus. The memory array is initialized to 0xFF.
+/// @return Chip index, on success
+/// @return \link memoree_err_t \endlink error code, on failure
+int memoree_sim_add(const memoree_sim_conf_t *conf);
+
+/// @brief Detach all simulated chips and reset the virtual clock to 0
+void memoree_sim_reset(void);
+
+/// @brief Returns the memory array of the chip at index \a chip, or NULL if there is none
+uint8_t *memoree_sim_data(int chip);
+
+/// @brief Returns whether the chip at index \a chip is in an internal write or erase cycle
+bool memoree_sim_busy(int chip);
+
+/// @brief Returns the activity counters of the chip at index \a chip
+memoree_err_t memoree_sim_get_counters(int chip, memoree_sim_counters_t *counters);
+
+/// @brief Returns the virtual time elapsed since the last memoree_sim_reset(), in microseconds
+/// @note Virtual time advances with bus clock cycles and calls to platform_ms_delay(), never with host execution time
+uint64_t memoree_sim_time_us(void);
+
+#endif
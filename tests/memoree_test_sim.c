@@ -0,0 +1,1307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memoree.h"
+#include "memoree_sim.h"
+#include "memoree_platform.h"
+
+/// Host tests run against the simulated platform, built and run with
+///   make -C tests test
+/// Times are measured in the simulator's virtual time, so the bounds checked here do not depend on the host's load.
+
+#define SIM_I2C_PORT 0
+#define SIM_SPI_PORT 1
+
+/// @brief Record a failed check, with the line it is on, without stopping the test
+#define CHECK(cond)                                                   \
+  do                                                                  \
+  {                                                                   \
+    if (!(cond))                                                      \
+    {                                                                 \
+      printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+static int failures;
+
+/// @brief 2 MB SPI flash, the base of the 25XX tests
+static const memoree_sim_conf_t flash_25xx = {
+    .chip = MEMOREE_SIM_CHIP_25XX,
+    .port = SIM_SPI_PORT,
+    .cs_pin = 1,
+    .size = 2 * 1024 * 1024,
+    .page_size = 256,
+    .write_time_us = 700,
+    .erase_time_us = 45000,
+    .block_erase_time_us = 150000,
+    .chip_erase_time_us = 5000000,
+};
+
+/// @brief 32 KB I2C EEPROM, initialized as a 24XX256
+static const memoree_sim_conf_t eeprom_24xx = {
+    .chip = MEMOREE_SIM_CHIP_24XX,
+    .port = SIM_I2C_PORT,
+    .addr = 0x50,
+    .size = 32768,
+    .page_size = 64,
+    .addr_len = 16,
+    .write_time_us = 2000,
+};
+
+/// @brief Attach the simulated chip described by \a conf and initialize it as \a variant
+/// @param chip Set to the index of the simulated chip
+static memoree_t attach(const memoree_sim_conf_t *conf, memoree_variant_t variant, void *interface_conf, int *chip)
+{
+  *chip = memoree_sim_add(conf);
+  memoree_t mem = (*chip >= 0) ? memoree_init(variant, interface_conf) : NULL;
+  CHECK(*chip >= 0 && mem);
+  return mem;
+}
+
+/// @brief Attach a 25XX part described by \a conf and initialize it on its chip select at 40 MHz
+static memoree_t attach_25xx(const memoree_sim_conf_t *conf, int *chip)
+{
+  memoree_spi_conf_t spi_conf = {.port = conf->port, .cs_pin = conf->cs_pin, .speed = 40000000};
+  return attach(conf, MEMOREE_VARIANT_25XX_SFDP, &spi_conf, chip);
+}
+
+/// @brief Attach a 24XX256 described by \a conf and initialize it at 400 kHz
+static memoree_t attach_24xx(const memoree_sim_conf_t *conf, int *chip)
+{
+  memoree_i2c_conf_t i2c_conf = {.port = conf->port, .addr = conf->addr, .speed = 400000};
+  return attach(conf, MEMOREE_VARIANT_24XX256, &i2c_conf, chip);
+}
+
+/// @brief Time the I2C bus takes to clock \a bytes, each followed by an acknowledge bit
+static uint64_t i2c_time_us(uint64_t bytes, uint32_t speed)
+{
+  return bytes * 9 * 1000000 / speed;
+}
+
+/// @brief Time a single data line takes to clock \a bytes
+static uint64_t spi_time_us(uint64_t bytes, uint32_t speed)
+{
+  return bytes * 8 * 1000000 / speed;
+}
+
+/// @brief Fill \a len bytes of \a buff with random data
+static uint8_t *random_image(uint32_t len)
+{
+  uint8_t *image = malloc(len);
+  for (uint32_t i = 0; image && i < len; i++)
+    image[i] = rand();
+  return image;
+}
+
+/// @brief Write \a len bytes of random data at \a addr of \a mem and read them back
+/// @param write_us, read_us Set to the virtual time taken by the write and by the read
+/// @return Whether the data reached the simulated array at \a addr and was read back unchanged
+static bool round_trip(memoree_t mem, int chip, uint32_t addr, uint32_t len, uint64_t *write_us, uint64_t *read_us)
+{
+  uint8_t *image = random_image(len);
+  uint8_t *readback = malloc(len);
+  bool ok = image && readback;
+
+  uint64_t start = memoree_sim_time_us();
+  ok = ok && memoree_write(mem, addr, image, len, 100, false) == (int)len;
+  *write_us = memoree_sim_time_us() - start;
+  CHECK(ok);
+  CHECK(ok && !memcmp(memoree_sim_data(chip) + addr, image, len));
+
+  start = memoree_sim_time_us();
+  ok = ok && memoree_read(mem, addr, readback, len, 1000) == (int)len;
+  *read_us = memoree_sim_time_us() - start;
+  CHECK(ok);
+  CHECK(ok && !memcmp(readback, image, len));
+
+  free(image);
+  free(readback);
+  return ok;
+}
+
+static void test_24xx(void)
+{
+  memoree_sim_conf_t conf = {
+      .chip = MEMOREE_SIM_CHIP_24XX,
+      .port = SIM_I2C_PORT,
+      .addr = 0x50,
+      .size = 32768,
+      .page_size = 64,
+      .addr_len = 16,
+      .write_time_us = 2000,
+  };
+  memoree_i2c_conf_t i2c_conf = {.port = SIM_I2C_PORT, .addr = 0x50, .speed = 400000};
+
+  int chip = memoree_sim_add(&conf);
+  memoree_t mem = memoree_init(MEMOREE_VARIANT_24XX256, &i2c_conf);
+  CHECK(chip >= 0 && mem);
+  if (chip < 0 || !mem)
+    return;
+
+  uint64_t write_us, read_us;
+  round_trip(mem, chip, 0, conf.size, &write_us, &read_us);
+
+  // Every page waits out its write cycle, and the bus carries the device and memory address of each page on top of the
+  // data itself
+  uint32_t pages = conf.size / conf.page_size;
+  uint64_t cycles_us = (uint64_t)pages * conf.write_time_us;
+  uint64_t transfer_us = i2c_time_us(conf.size + pages * 3, i2c_conf.speed);
+  CHECK(write_us >= cycles_us);
+  CHECK(write_us <= (cycles_us + transfer_us) * 12 / 10);
+  CHECK(read_us <= i2c_time_us(conf.size, i2c_conf.speed) * 11 / 10);
+
+  uint64_t start = memoree_sim_time_us();
+  CHECK(memoree_erase(mem, 0xFF) == MEMOREE_ERR_OK);
+  uint64_t erase_us = memoree_sim_time_us() - start;
+  CHECK(erase_us >= cycles_us && erase_us <= (cycles_us + transfer_us) * 12 / 10);
+  for (uint32_t i = 0; i < conf.size; i += conf.page_size)
+    CHECK(memoree_sim_data(chip)[i] == 0xFF);
+
+  CHECK(memoree_ping(mem, 100) == MEMOREE_ERR_OK);
+  memoree_deinit(mem, true);
+}
+
+static void test_93cxx(void)
+{
+  memoree_sim_conf_t conf = {
+      .chip = MEMOREE_SIM_CHIP_93CXX,
+      .port = SIM_SPI_PORT,
+      .cs_pin = 0,
+      .size = 128,
+      .page_size = 1,
+      .addr_len = 7,
+      .write_time_us = 2000,
+      .erase_time_us = 2000,
+      .chip_erase_time_us = 6000,
+  };
+  memoree_spi_conf_t spi_conf = {.port = SIM_SPI_PORT, .cs_pin = 0, .speed = 2000000};
+
+  int chip = memoree_sim_add(&conf);
+  memoree_t mem = memoree_init(MEMOREE_VARIANT_93C46, &spi_conf);
+  CHECK(chip >= 0 && mem);
+  if (chip < 0 || !mem)
+    return;
+
+  uint64_t write_us, read_us;
+  round_trip(mem, chip, 0, conf.size, &write_us, &read_us);
+
+  // Each byte is its own write instruction of start bit, opcode, address and data
+  uint64_t cycles_us = (uint64_t)conf.size * conf.write_time_us;
+  uint64_t transfer_us = (uint64_t)conf.size * (3 + conf.addr_len + 8) * 1000000 / spi_conf.speed;
+  CHECK(write_us >= cycles_us);
+  CHECK(write_us <= (cycles_us + transfer_us) * 12 / 10);
+  CHECK(read_us <= (spi_time_us(conf.size, spi_conf.speed) + transfer_us) * 11 / 10);
+
+  memoree_deinit(mem, true);
+}
+
+/// @brief Round trip of \a len bytes at \a addr of a 25XX part of \a size bytes
+static void test_25xx_part(uint32_t size, uint32_t addr, uint32_t len)
+{
+  memoree_sim_conf_t conf = {
+      .chip = MEMOREE_SIM_CHIP_25XX,
+      .port = SIM_SPI_PORT,
+      .cs_pin = 1,
+      .size = size,
+      .page_size = 256,
+      .write_time_us = 700,
+      .erase_time_us = 45000,
+      .block_erase_time_us = 150000,
+      .chip_erase_time_us = 5000000,
+  };
+  memoree_spi_conf_t spi_conf = {.port = SIM_SPI_PORT, .cs_pin = 1, .speed = 40000000};
+
+  int chip = memoree_sim_add(&conf);
+  memoree_t mem = memoree_init(MEMOREE_VARIANT_25XX_SFDP, &spi_conf);
+  CHECK(chip >= 0 && mem);
+  if (chip < 0 || !mem)
+    return;
+
+  memoree_info_t info;
+  CHECK(memoree_get_info(mem, &info) == MEMOREE_ERR_OK && info.size == size);
+
+  uint64_t write_us, read_us;
+  if (round_trip(mem, chip, addr, len, &write_us, &read_us) && addr >= (1UL << 24))
+  {
+    // Parts over 16 MB are addressed with 4 bytes, so nothing may have been written 16 MB lower
+    for (uint32_t i = 0; i < len; i++)
+      CHECK(memoree_sim_data(chip)[addr - (1UL << 24) + i] == 0xFF);
+  }
+
+  uint32_t pages = len / conf.page_size;
+  uint64_t cycles_us = (uint64_t)pages * conf.write_time_us;
+  uint64_t transfer_us = spi_time_us(len + pages * 6, spi_conf.speed);
+  CHECK(write_us >= cycles_us);
+  CHECK(write_us <= (cycles_us + transfer_us) * 12 / 10);
+  CHECK(read_us <= spi_time_us(len, spi_conf.speed) * 11 / 10);
+
+  uint64_t start = memoree_sim_time_us();
+  CHECK(memoree_erase(mem, 0xFF) == MEMOREE_ERR_OK);
+  uint64_t erase_us = memoree_sim_time_us() - start;
+  CHECK(erase_us >= conf.chip_erase_time_us && erase_us <= conf.chip_erase_time_us * 11 / 10);
+  for (uint32_t i = 0; i < len; i++)
+    CHECK(memoree_sim_data(chip)[addr + i] == 0xFF);
+
+  CHECK(memoree_ping(mem, 100) == MEMOREE_ERR_OK);
+  memoree_deinit(mem, true);
+}
+
+static void test_25xx(void)
+{
+  test_25xx_part(2 * 1024 * 1024, 0, 2 * 1024 * 1024);
+}
+
+/// @brief A part over 16 MB, addressed with 4 bytes, written above its first 16 MB
+static void test_25xx_4byte(void)
+{
+  test_25xx_part(32 * 1024 * 1024, 24 * 1024 * 1024 + 4096, 65536);
+}
+
+/// @brief A custom SFDP area with a vendor table and a 4-byte address instruction table after the BFPT
+static void test_sfdp(void)
+{
+  // The BFPT is taken from the table generated for a plain part
+  int chip;
+  memoree_t plain = attach_25xx(&flash_25xx, &chip);
+  uint8_t sfdp[MEMOREE_SIM_SFDP_SIZE];
+  CHECK(plain && memoree_read_sfdp(plain, 0, sfdp, sizeof(sfdp), 100) == (int)sizeof(sfdp));
+  if (!plain)
+    return;
+  memoree_deinit(plain, true);
+
+  static const uint8_t vendor_header[8] = {0xC2, 0x00, 0x01, 1, 0x80, 0x00, 0x00, 0x00};
+  static const uint8_t bait_header[8] = {0x84, 0x00, 0x01, 2, 0x90, 0x00, 0x00, 0xFF};
+  static const uint8_t vendor_table[4] = {0x78, 0x56, 0x34, 0x12};
+  uint32_t bait_instr = MEMOREE_SFDP_4BAIT_READ | MEMOREE_SFDP_4BAIT_FAST_READ | MEMOREE_SFDP_4BAIT_PP | (1 << 9) | (1 << 10);
+  uint8_t bait_table[8] = {bait_instr, bait_instr >> 8, bait_instr >> 16, bait_instr >> 24, 0x21, 0xDC, 0xFF, 0xFF};
+
+  sfdp[6] = 2;
+  memcpy(&sfdp[16], vendor_header, sizeof(vendor_header));
+  memcpy(&sfdp[24], bait_header, sizeof(bait_header));
+  memcpy(&sfdp[0x80], vendor_table, sizeof(vendor_table));
+  memcpy(&sfdp[0x90], bait_table, sizeof(bait_table));
+
+  memoree_sim_conf_t conf = flash_25xx;
+  conf.cs_pin = 2;
+  conf.sfdp = sfdp;
+  conf.sfdp_len = sizeof(sfdp);
+  memoree_t mem = attach_25xx(&conf, &chip);
+  if (!mem)
+    return;
+
+  sfdp_param_t param;
+  CHECK(memoree_get_sfdp(mem, &param, 100) == MEMOREE_ERR_OK);
+  CHECK(param.header_cnt == 3);
+  CHECK(param.headers[0].id == MEMOREE_SFDP_ID_BFPT && param.fparam_ptr == param.headers[0].ptr);
+  CHECK(param.headers[1].id == 0x00C2 && param.headers[1].size == 4 && param.headers[1].ptr == 0x80);
+  CHECK(param.headers[2].id == MEMOREE_SFDP_ID_4BAIT && param.headers[2].size == 8 && param.headers[2].ptr == 0x90);
+  CHECK(param.size == conf.size && param.page_size == conf.page_size && param.min_sector == 4096);
+  CHECK(param.addr4_instr == bait_instr);
+  CHECK(param.erase[0].opcode_4b == 0x21 && param.erase[1].opcode_4b == 0xDC && !param.erase[2].opcode_4b);
+
+  uint8_t vendor[4];
+  CHECK(memoree_read_sfdp(mem, param.headers[1].ptr, vendor, sizeof(vendor), 100) == (int)sizeof(vendor));
+  CHECK(!memcmp(vendor, vendor_table, sizeof(vendor)));
+
+  uint64_t write_us, read_us;
+  round_trip(mem, chip, 0x1000, conf.page_size, &write_us, &read_us);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Count the bytes of \a chip in [\a addr, \a addr + \a len) that are not erased
+static uint32_t count_programmed(int chip, uint32_t addr, uint32_t len)
+{
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < len; i++)
+    n += memoree_sim_data(chip)[addr + i] != 0xFF;
+  return n;
+}
+
+/// @brief Ranges erased with the fewest sector, block and chip erases
+static void test_erase_range(void)
+{
+  int chip;
+  memoree_t mem = attach_25xx(&flash_25xx, &chip);
+  if (!mem)
+    return;
+  uint8_t *data = memoree_sim_data(chip);
+  memset(data, 0x5A, flash_25xx.size);
+
+  // A sector on each side of a 64 KB block
+  memoree_sim_counters_t before, after;
+  memoree_sim_get_counters(chip, &before);
+  CHECK(memoree_erase_range(mem, 0xF000, 0x12000) == MEMOREE_ERR_OK);
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.erases - before.erases == 3);
+  CHECK(count_programmed(chip, 0xF000, 0x12000) == 0);
+  CHECK(data[0xEFFF] == 0x5A && data[0x21000] == 0x5A);
+
+  // Two 32 KB halves of different 64 KB blocks
+  memoree_sim_get_counters(chip, &before);
+  CHECK(memoree_erase_range(mem, 0x38000, 0x10000) == MEMOREE_ERR_OK);
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.erases - before.erases == 2);
+  CHECK(count_programmed(chip, 0x38000, 0x10000) == 0);
+  CHECK(data[0x37FFF] == 0x5A && data[0x48000] == 0x5A);
+
+  CHECK(memoree_erase_range(mem, 0x100, 0x1000) == MEMOREE_ERR_INVALID_ARG);
+  CHECK(memoree_erase_range(mem, 0x1000, 0x800) == MEMOREE_ERR_INVALID_ARG);
+  CHECK(memoree_erase_range(mem, 0x1000, 0) == MEMOREE_ERR_INVALID_ARG);
+  CHECK(memoree_erase_range(mem, flash_25xx.size - 0x1000, 0x2000) == MEMOREE_ERR_INVALID_ARG);
+  CHECK(data[0x100] == 0x5A && data[flash_25xx.size - 1] == 0x5A);
+
+  // The whole array takes a single chip erase
+  memoree_sim_get_counters(chip, &before);
+  uint64_t start_us = memoree_sim_time_us();
+  CHECK(memoree_erase_range(mem, 0, flash_25xx.size) == MEMOREE_ERR_OK);
+  CHECK(memoree_sim_time_us() - start_us >= flash_25xx.chip_erase_time_us);
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.erases - before.erases == 1);
+  CHECK(count_programmed(chip, 0, flash_25xx.size) == 0);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Completion of an asynchronous job, as reported to its callback
+typedef struct
+{
+  int calls;
+  int result;
+} job_done_t;
+
+static void job_done(memoree_job_t job, int result, void *arg)
+{
+  job_done_t *done = arg;
+  done->calls++;
+  done->result = result;
+}
+
+/// @brief Poll \a job until it completes, with the CPU free for a millisecond between polls
+/// @return Result of the job, or MEMOREE_ERR_TIMEOUT if it did not complete within \a max_polls polls
+static int poll_job(memoree_job_t job, int max_polls)
+{
+  int ret = memoree_job_poll(job);
+  for (int i = 0; ret == MEMOREE_ERR_IN_PROGRESS && i < max_polls; i++)
+  {
+    platform_ms_delay(1);
+    ret = memoree_job_poll(job);
+  }
+  return ret;
+}
+
+/// @brief Reads, writes and erases of a 25XX part run as jobs over queued SPI transfers
+static void test_async(void)
+{
+  int chip;
+  memoree_t mem = attach_25xx(&flash_25xx, &chip);
+  uint8_t *image = random_image(3 * 4096);
+  uint8_t *readback = malloc(3 * 4096);
+  if (!mem || !image || !readback)
+    goto out;
+  const uint32_t addr = 0x10000 + 100, len = 3 * 4096 - 200;
+
+  job_done_t done = {0};
+  memoree_job_t job = memoree_write_async(mem, addr, image, len, job_done, &done);
+  CHECK(job && memoree_job_poll(job) == MEMOREE_ERR_IN_PROGRESS && !done.calls);
+  CHECK(poll_job(job, 1000) == (int)len);
+  CHECK(done.calls == 1 && done.result == (int)len);
+  CHECK(memoree_job_poll(job) == (int)len && done.calls == 1);
+  CHECK(!memcmp(memoree_sim_data(chip) + addr, image, len));
+  CHECK(memoree_sim_data(chip)[addr - 1] == 0xFF && memoree_sim_data(chip)[addr + len] == 0xFF);
+  memoree_job_free(job);
+
+  done = (job_done_t){0};
+  job = memoree_read_async(mem, addr, readback, len, job_done, &done);
+  CHECK(job && memoree_job_poll(job) == MEMOREE_ERR_IN_PROGRESS);
+  CHECK(poll_job(job, 1000) == (int)len);
+  CHECK(done.calls == 1 && done.result == (int)len);
+  CHECK(!memcmp(readback, image, len));
+  memoree_job_free(job);
+
+  // The sectors the write touched take an erase cycle each
+  done = (job_done_t){0};
+  memoree_sim_counters_t before, after;
+  memoree_sim_get_counters(chip, &before);
+  job = memoree_erase_async(mem, 0x10000, 3 * 4096, job_done, &done);
+  CHECK(job && memoree_job_poll(job) == MEMOREE_ERR_IN_PROGRESS);
+  CHECK(poll_job(job, 1000) == MEMOREE_ERR_OK);
+  CHECK(done.calls == 1 && done.result == MEMOREE_ERR_OK);
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.erases - before.erases == 3);
+  CHECK(count_programmed(chip, 0x10000, 3 * 4096) == 0);
+  memoree_job_free(job);
+
+  // Jobs are refused ranges past the end of the device and flash erases that are not sector aligned
+  CHECK(!memoree_write_async(mem, flash_25xx.size - 10, image, 20, NULL, NULL));
+  CHECK(!memoree_erase_async(mem, 0x100, 4096, NULL, NULL));
+
+out:
+  free(image);
+  free(readback);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Read \a len bytes at \a addr of \a chip through a 25XX initialized with \a max_transfer, checking the data and
+///        the number of chunks the single read transaction was split into
+static void read_chunked(int chip, uint32_t max_transfer, uint32_t addr, uint32_t len, uint32_t chunks)
+{
+  memoree_spi_conf_t spi_conf = {.port = SIM_SPI_PORT, .cs_pin = flash_25xx.cs_pin, .speed = 40000000, .max_transfer = max_transfer};
+  memoree_t mem = memoree_init(MEMOREE_VARIANT_25XX_SFDP, &spi_conf);
+  uint8_t *readback = malloc(len);
+  CHECK(mem && readback);
+  if (mem && readback)
+  {
+    memoree_sim_counters_t before, after;
+    memoree_sim_get_counters(chip, &before);
+    CHECK(memoree_read(mem, addr, readback, len, 100) == (int)len);
+    memoree_sim_get_counters(chip, &after);
+    CHECK(after.transactions - before.transactions == 1);
+    CHECK(after.chunks - before.chunks == chunks);
+    CHECK(!memcmp(readback, memoree_sim_data(chip) + addr, len));
+  }
+  free(readback);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Reads longer than max_transfer are split into chunks of one transaction
+static void test_max_transfer(void)
+{
+  int chip = memoree_sim_add(&flash_25xx);
+  CHECK(chip >= 0);
+  if (chip < 0)
+    return;
+  uint8_t *image = random_image(flash_25xx.size);
+  if (!image)
+    return;
+  memcpy(memoree_sim_data(chip), image, flash_25xx.size);
+  free(image);
+
+  read_chunked(chip, 1000, 0x3000 + 7, 10000, 10);
+  read_chunked(chip, 1000, 0x3000, 1000, 1);
+  // The platform default of the simulator is 4096 bytes
+  read_chunked(chip, 0, 0x20000, 10000, 3);
+  read_chunked(chip, 0, 0, flash_25xx.size, flash_25xx.size / 4096);
+}
+
+/// @brief Read and write across the blocks of a 24XX part whose high address bits are sent as I2C address bits
+/// @param addr_len Memory address bits, each block being 2^addr_len bytes
+static void blocks_24xx(memoree_variant_t variant, uint8_t addr, uint32_t size, uint16_t page_size, uint8_t addr_len)
+{
+  memoree_sim_conf_t conf = {
+      .chip = MEMOREE_SIM_CHIP_24XX,
+      .port = SIM_I2C_PORT,
+      .addr = addr,
+      .size = size,
+      .page_size = page_size,
+      .addr_len = addr_len,
+      .write_time_us = 5000,
+  };
+  memoree_i2c_conf_t i2c_conf = {.port = SIM_I2C_PORT, .addr = addr, .speed = 400000};
+  int chip;
+  memoree_t mem = attach(&conf, variant, &i2c_conf, &chip);
+  uint8_t *image = random_image(size);
+  uint8_t *readback = malloc(size);
+  if (!mem || !image || !readback)
+    goto out;
+  memcpy(memoree_sim_data(chip), image, size);
+
+  // Each block is read by its own transaction, as the address counter rolls over within a block
+  const uint32_t block_size = 1UL << addr_len;
+  memoree_sim_counters_t before, after;
+  memoree_sim_get_counters(chip, &before);
+  CHECK(memoree_read(mem, block_size - 16, readback, 32, 100) == 32);
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.transactions - before.transactions == 2);
+  CHECK(!memcmp(readback, image + block_size - 16, 32));
+
+  memset(readback, 0, size);
+  CHECK(memoree_read(mem, 0, readback, size, 1000) == (int)size);
+  CHECK(!memcmp(readback, image, size));
+
+  uint8_t byte;
+  CHECK(memoree_read_byte(mem, size - 1, &byte, 100) == MEMOREE_ERR_OK && byte == image[size - 1]);
+
+  // A write ending a block and starting the next
+  for (uint32_t i = 0; i < 2 * page_size; i++)
+    image[block_size - page_size + i] ^= 0xFF;
+  CHECK(memoree_write(mem, block_size - page_size, image + block_size - page_size, 2 * page_size, 100, false) == 2 * page_size);
+  CHECK(!memcmp(memoree_sim_data(chip), image, size));
+  CHECK(memoree_read(mem, block_size - page_size, readback, 2 * page_size, 100) == 2 * page_size);
+  CHECK(!memcmp(readback, image + block_size - page_size, 2 * page_size));
+
+out:
+  free(image);
+  free(readback);
+  memoree_deinit(mem, true);
+}
+
+/// @brief 24XX16 parts take 3 block bits in their I2C address and 24XX1024 parts 1
+static void test_24xx_blocks(void)
+{
+  blocks_24xx(MEMOREE_VARIANT_24XX16, 0x50, 2048, 16, 8);
+  memoree_sim_reset();
+  blocks_24xx(MEMOREE_VARIANT_24XX1024, 0x50, 131072, 128, 16);
+}
+
+/// @brief Number of write cycles \a chip has started
+static uint32_t programs(int chip)
+{
+  memoree_sim_counters_t counters;
+  memoree_sim_get_counters(chip, &counters);
+  return counters.programs;
+}
+
+/// @brief Writes held in the write-back cache are seen by reads and programmed once per page when written back
+static void test_write_cache(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  if (!mem)
+    return;
+  uint8_t *data = memoree_sim_data(chip);
+  uint8_t shadow[256];
+  memset(shadow, 0xFF, sizeof(shadow));
+
+  memoree_cache_conf_t cache_conf = {.pages = 2};
+  CHECK(memoree_cache_attach(mem, &cache_conf) == MEMOREE_ERR_OK);
+
+  // Small writes to one page stay in RAM, and reads overlay them on the device's contents
+  uint8_t buff[256];
+  for (uint32_t i = 0; i < 20; i++)
+  {
+    uint8_t bytes[3] = {i, i + 1, i + 2};
+    CHECK(memoree_write(mem, 3 * i, bytes, sizeof(bytes), 100, false) == sizeof(bytes));
+    memcpy(shadow + 3 * i, bytes, sizeof(bytes));
+  }
+  CHECK(memoree_write_byte(mem, 63, 0xA5, 100) == MEMOREE_ERR_OK);
+  shadow[63] = 0xA5;
+  CHECK(programs(chip) == 0 && data[0] == 0xFF);
+  CHECK(memoree_read(mem, 0, buff, 128, 100) == 128 && !memcmp(buff, shadow, 128));
+  CHECK(memoree_read_byte(mem, 63, buff, 100) == MEMOREE_ERR_OK && buff[0] == 0xA5);
+  CHECK(programs(chip) == 0);
+
+  CHECK(memoree_flush(mem) == MEMOREE_ERR_OK);
+  CHECK(programs(chip) == 1 && !memcmp(data, shadow, 128));
+  CHECK(memoree_flush(mem) == MEMOREE_ERR_OK && programs(chip) == 1);
+
+  // A third dirty page evicts the least recently used of the two slots
+  for (uint32_t page = 1; page <= 3; page++)
+  {
+    memset(shadow + 64 * page, page, 10);
+    CHECK(memoree_write(mem, 64 * page, shadow + 64 * page, 10, 100, false) == 10);
+  }
+  CHECK(programs(chip) == 2 && data[64] == 1 && data[128] == 0xFF);
+  CHECK(memoree_read(mem, 0, buff, sizeof(buff), 100) == sizeof(buff) && !memcmp(buff, shadow, sizeof(buff)));
+
+  // Erases discard the dirty pages they cover
+  CHECK(memoree_erase_page(mem, 2, 0xFF) == MEMOREE_ERR_OK);
+  memset(shadow + 128, 0xFF, 64);
+  CHECK(memoree_flush(mem) == MEMOREE_ERR_OK);
+  CHECK(!memcmp(data, shadow, sizeof(shadow)));
+
+  // Once past its deadline a page is left alone by reads and written back by memoree_cache_poll()
+  CHECK(memoree_cache_detach(mem) == MEMOREE_ERR_OK);
+  cache_conf.flush_after_ms = 20;
+  CHECK(memoree_cache_attach(mem, &cache_conf) == MEMOREE_ERR_OK);
+  CHECK(memoree_write_byte(mem, 5, 0x42, 100) == MEMOREE_ERR_OK);
+  platform_ms_delay(30);
+  uint32_t before = programs(chip);
+  CHECK(memoree_read_byte(mem, 5, buff, 100) == MEMOREE_ERR_OK && buff[0] == 0x42);
+  CHECK(programs(chip) == before && data[5] != 0x42);
+  CHECK(memoree_cache_poll(mem) == MEMOREE_ERR_OK);
+  CHECK(programs(chip) == before + 1 && data[5] == 0x42);
+
+  // Deinitializing the device writes back what is left
+  CHECK(memoree_write_byte(mem, 300, 0x43, 100) == MEMOREE_ERR_OK && data[300] == 0xFF);
+  memoree_deinit(mem, true);
+  CHECK(data[300] == 0x43);
+}
+
+/// @brief Short reads served from the read cache, with lines prefetched ahead of a sequential reader
+static void test_read_cache(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  uint8_t *image = random_image(eeprom_24xx.size);
+  if (!mem || !image)
+    goto out;
+  memcpy(memoree_sim_data(chip), image, eeprom_24xx.size);
+
+  memoree_cache_conf_t cache_conf = {.read_lines = 16, .line_size = 64, .prefetch = 3};
+  CHECK(memoree_cache_attach(mem, &cache_conf) == MEMOREE_ERR_OK);
+
+  // After the first miss every miss continues the sequence and reads its line and the next 3 in one transaction, so the
+  // 64 lines of the first 4 KB take 17 transactions and the last prefetched line, past the 4 KB, is never read
+  uint8_t buff[64];
+  bool ok = true;
+  memoree_sim_counters_t before, after;
+  memoree_sim_get_counters(chip, &before);
+  for (uint32_t addr = 0; addr < 4096; addr += 4)
+    ok &= memoree_read(mem, addr, buff, 4, 100) == 4 && !memcmp(buff, image + addr, 4);
+  CHECK(ok);
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.transactions - before.transactions == 17);
+
+  memoree_cache_stats_t stats;
+  CHECK(memoree_cache_get_stats(mem, &stats) == MEMOREE_ERR_OK);
+  CHECK(stats.hits == 1024 - 17 && stats.misses == 17);
+  CHECK(stats.prefetches == 48 && stats.prefetch_hits == 47);
+
+  // The cache holds the last 15 lines read and the unread prefetched one, and reads of a line or more go straight to the
+  // device
+  memoree_sim_get_counters(chip, &before);
+  CHECK(memoree_read(mem, 4096 - 64 * 15 + 10, buff, 20, 100) == 20 && !memcmp(buff, image + 4096 - 64 * 15 + 10, 20));
+  CHECK(memoree_read(mem, 4000, buff, 64, 100) == 64 && !memcmp(buff, image + 4000, 64));
+  memoree_sim_get_counters(chip, &after);
+  CHECK(after.transactions - before.transactions == 1);
+  CHECK(memoree_cache_get_stats(mem, &stats) == MEMOREE_ERR_OK && stats.hits == 1024 - 17 + 1 && stats.misses == 17);
+
+  // A write invalidates the lines it covers
+  memset(image + 4000, 0x3C, 8);
+  CHECK(memoree_write(mem, 4000, image + 4000, 8, 100, false) == 8);
+  CHECK(memoree_read(mem, 3998, buff, 12, 100) == 12 && !memcmp(buff, image + 3998, 12));
+  CHECK(memoree_cache_get_stats(mem, &stats) == MEMOREE_ERR_OK && stats.misses == 18);
+
+out:
+  free(image);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Only the pages that differ are programmed, and flash pages that would need an erase stop the write
+static void test_write_diff(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  uint8_t *image = random_image(4096);
+  if (!mem || !image)
+    goto out;
+  memcpy(memoree_sim_data(chip) + 1000, image, 4096);
+
+  // Two bytes in the 64-byte pages starting at 1024 and 4992, and none in the partial pages at each end
+  uint32_t programmed = 0, before = programs(chip);
+  image[1024 + 5 - 1000] ^= 0x01;
+  image[4992 + 63 - 1000] ^= 0x80;
+  CHECK(memoree_write_diff(mem, 1000, image, 4096, 100, &programmed) == 4096);
+  CHECK(programmed == 2 && programs(chip) - before == 2);
+  CHECK(!memcmp(memoree_sim_data(chip) + 1000, image, 4096));
+
+  CHECK(memoree_write_diff(mem, 1000, image, 4096, 100, &programmed) == 4096);
+  CHECK(programmed == 0 && programs(chip) - before == 2);
+  memoree_deinit(mem, true);
+
+  mem = attach_25xx(&flash_25xx, &chip);
+  if (!mem)
+    goto out;
+  uint8_t *data = memoree_sim_data(chip);
+  memset(image, 0xF0, 4096);
+  memcpy(data, image, 4096);
+
+  // Clearing bits needs no erase
+  image[256 + 1] = 0x30;
+  image[768 + 2] = 0x00;
+  CHECK(memoree_write_diff(mem, 0, image, 4096, 100, &programmed) == 4096);
+  CHECK(programmed == 2 && !memcmp(data, image, 4096));
+
+  // The page setting a bit is refused, after the pages before it have been programmed
+  image[512] = 0xE0;
+  image[1024] = 0xF8;
+  image[2048] = 0x00;
+  CHECK(memoree_write_diff(mem, 0, image, 4096, 100, &programmed) == MEMOREE_ERR_FAIL);
+  CHECK(programmed == 1 && data[512] == 0xE0 && data[1024] == 0xF0 && data[2048] == 0xF0);
+
+out:
+  free(image);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Bitwise reference of the reflected CRC-32 with polynomial \a poly
+static uint32_t crc_reference(const uint8_t *data, uint32_t len, uint32_t poly)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+  }
+  return ~crc;
+}
+
+/// @brief Checksum and verify \a mem, whose \a chip holds \a image at \a addr
+static void checksum_verify(memoree_t mem, int chip, uint32_t addr, uint8_t *image, uint32_t len)
+{
+  // Check values of the CRC catalogue
+  static const uint8_t check[] = "123456789";
+  memcpy(memoree_sim_data(chip) + addr + 1, check, 9);
+  uint32_t digest = 0;
+  CHECK(memoree_checksum(mem, addr + 1, 9, MEMOREE_CHECKSUM_CRC32, &digest) == MEMOREE_ERR_OK && digest == 0xCBF43926);
+  CHECK(memoree_checksum(mem, addr + 1, 9, MEMOREE_CHECKSUM_CRC32C, &digest) == MEMOREE_ERR_OK && digest == 0xE3069283);
+
+  // Several pipelined chunks, starting and ending mid-chunk
+  memcpy(memoree_sim_data(chip) + addr, image, len);
+  CHECK(memoree_checksum(mem, addr + 3, len - 3, MEMOREE_CHECKSUM_CRC32, &digest) == MEMOREE_ERR_OK);
+  CHECK(digest == crc_reference(image + 3, len - 3, 0xEDB88320));
+  CHECK(memoree_checksum(mem, addr + 3, len - 3, MEMOREE_CHECKSUM_CRC32C, &digest) == MEMOREE_ERR_OK);
+  CHECK(digest == crc_reference(image + 3, len - 3, 0x82F63B78));
+
+  uint32_t mismatch = 0;
+  CHECK(memoree_verify(mem, addr, image, len, &mismatch) == MEMOREE_ERR_OK);
+  memoree_sim_data(chip)[addr + 2500] ^= 0x10;
+  memoree_sim_data(chip)[addr + 4000] ^= 0x10;
+  CHECK(memoree_verify(mem, addr, image, len, &mismatch) == MEMOREE_ERR_MISMATCH && mismatch == addr + 2500);
+  CHECK(memoree_verify(mem, addr + 2501, image + 2501, len - 2501, &mismatch) == MEMOREE_ERR_MISMATCH);
+  CHECK(mismatch == addr + 4000);
+  CHECK(memoree_verify(mem, addr, image, 2500, NULL) == MEMOREE_ERR_OK);
+}
+
+/// @brief Checksums match known answers and verify reports the first differing address, on I2C and on pipelined SPI
+static void test_checksum(void)
+{
+  const uint32_t len = 5000;
+  uint8_t *image = random_image(len);
+  if (!image)
+    return;
+
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  if (mem)
+    checksum_verify(mem, chip, 1000, image, len);
+  memoree_deinit(mem, true);
+
+  mem = attach_25xx(&flash_25xx, &chip);
+  if (mem)
+    checksum_verify(mem, chip, 0x10000 - 7, image, len);
+  memoree_deinit(mem, true);
+  free(image);
+}
+
+/// @brief Image handed to memoree_program_stream() a few bytes at a time
+typedef struct
+{
+  const uint8_t *image;
+  uint32_t len;
+  uint32_t pos;
+  uint32_t max_read; ///< Largest number of bytes returned by one call
+  uint32_t delay_ms; ///< Time each call takes
+  int fail_at;       ///< Error returned once \a pos reaches it, or 0 for none
+  uint32_t progress; ///< Last progress reported
+  bool monotonic;    ///< Whether the progress reported never went backwards
+} stream_source_t;
+
+static int stream_source(uint8_t *buff, uint32_t len, void *ctx)
+{
+  stream_source_t *src = ctx;
+  if (src->fail_at && src->pos >= (uint32_t)src->fail_at)
+    return MEMOREE_ERR_FAIL;
+  uint32_t n = src->len - src->pos;
+  n = (n < len) ? n : len;
+  n = (n < src->max_read) ? n : src->max_read;
+  memcpy(buff, src->image + src->pos, n);
+  src->pos += n;
+  if (src->delay_ms)
+    platform_ms_delay(src->delay_ms);
+  return n;
+}
+
+static void stream_progress(uint32_t done, void *ctx)
+{
+  stream_source_t *src = ctx;
+  src->monotonic &= done >= src->progress;
+  src->progress = done;
+}
+
+/// @brief Images pulled from a source that returns less than asked are programmed in whole pages
+static void test_program_stream(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  uint8_t *image = random_image(5000);
+  if (!mem || !image)
+    goto out;
+
+  // 77 full pages and a partial one at each end, while the source's 136 ms are spent during the write cycles
+  stream_source_t src = {.image = image, .len = 5000, .max_read = 37, .delay_ms = 1, .monotonic = true};
+  uint32_t before = programs(chip);
+  uint64_t start = memoree_sim_time_us();
+  CHECK(memoree_program_stream(mem, 10, stream_source, stream_progress, &src) == 5000);
+  uint64_t stream_us = memoree_sim_time_us() - start;
+  CHECK(src.progress == 5000 && src.monotonic);
+  CHECK(programs(chip) - before == 79);
+  CHECK(!memcmp(memoree_sim_data(chip) + 10, image, 5000));
+  CHECK(memoree_sim_data(chip)[9] == 0xFF && memoree_sim_data(chip)[5010] == 0xFF);
+  CHECK(stream_us < 79 * eeprom_24xx.write_time_us + (5000 + 36) / 37 * 1000);
+
+  // The image is cut short at the end of the memory
+  src = (stream_source_t){.image = image, .len = 5000, .max_read = 100, .monotonic = true};
+  CHECK(memoree_program_stream(mem, eeprom_24xx.size - 768, stream_source, NULL, &src) == 768);
+  CHECK(!memcmp(memoree_sim_data(chip) + eeprom_24xx.size - 768, image, 768));
+
+  // A source error stops the stream once the pages already pulled are programmed
+  memset(memoree_sim_data(chip), 0xFF, eeprom_24xx.size);
+  src = (stream_source_t){.image = image, .len = 5000, .max_read = 64, .fail_at = 640, .monotonic = true};
+  CHECK(memoree_program_stream(mem, 0, stream_source, stream_progress, &src) == MEMOREE_ERR_FAIL);
+  CHECK(src.progress <= 640 && !memcmp(memoree_sim_data(chip), image, src.progress));
+  CHECK(count_programmed(chip, 640, 4096) == 0);
+
+out:
+  free(image);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Collects what memoree_dump_stream() passes to it
+typedef struct
+{
+  uint8_t *buff;
+  uint32_t len;
+  int calls;
+  uint32_t max_chunk; ///< Longest chunk passed
+  int fail_at;        ///< Call that returns MEMOREE_ERR_TIMEOUT, or 0 for none
+} dump_sink_t;
+
+static int dump_sink(const uint8_t *data, uint32_t len, void *ctx)
+{
+  dump_sink_t *sink = ctx;
+  if (++sink->calls == sink->fail_at)
+    return MEMOREE_ERR_TIMEOUT;
+  memcpy(sink->buff + sink->len, data, len);
+  sink->len += len;
+  sink->max_chunk = (len > sink->max_chunk) ? len : sink->max_chunk;
+  return 0;
+}
+
+/// @brief Dump \a len bytes at \a addr of \a mem in chunks of \a chunk, checking they arrive in \a calls sink calls
+static void dump_chunked(memoree_t mem, int chip, uint32_t addr, uint32_t len, uint32_t chunk, int calls, uint32_t max_chunk)
+{
+  dump_sink_t sink = {.buff = malloc(len)};
+  CHECK(sink.buff);
+  if (!sink.buff)
+    return;
+  CHECK(memoree_dump_stream(mem, addr, len, dump_sink, &sink, chunk) == (int)len);
+  CHECK(sink.len == len && sink.calls == calls && sink.max_chunk == max_chunk);
+  CHECK(!memcmp(sink.buff, memoree_sim_data(chip) + addr, len));
+
+  // A sink error stops the dump, and the device is left usable
+  sink = (dump_sink_t){.buff = sink.buff, .fail_at = 2};
+  CHECK(memoree_dump_stream(mem, addr, len, dump_sink, &sink, chunk) == (calls > 1 ? MEMOREE_ERR_TIMEOUT : (int)len));
+  CHECK(sink.calls == (calls > 1 ? 2 : 1));
+  uint8_t byte;
+  CHECK(memoree_read_byte(mem, addr, &byte, 100) == MEMOREE_ERR_OK && byte == memoree_sim_data(chip)[addr]);
+  free(sink.buff);
+}
+
+/// @brief Dumps are passed to the sink in chunks, of the longest single read when no chunk size is given
+static void test_dump_stream(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  uint8_t *image = random_image(flash_25xx.size);
+  if (!mem || !image)
+    goto out;
+  memcpy(memoree_sim_data(chip), image, eeprom_24xx.size);
+  dump_chunked(mem, chip, 7, 10000, 1000, 10, 1000);
+  // A whole 24XX block could be read at once, but chunks picked by the library are kept to 4 KB
+  dump_chunked(mem, chip, 7, 10000, 0, 3, 4096);
+  dump_chunked(mem, chip, 0, eeprom_24xx.size, 0, eeprom_24xx.size / 4096, 4096);
+  memoree_deinit(mem, true);
+
+  mem = attach_25xx(&flash_25xx, &chip);
+  if (!mem)
+    goto out;
+  memcpy(memoree_sim_data(chip), image, flash_25xx.size);
+  dump_chunked(mem, chip, 7, 10000, 1000, 10, 1000);
+  // The simulator's SPI transfers default to 4 KB
+  dump_chunked(mem, chip, 7, 10000, 0, 3, 4096);
+  dump_chunked(mem, chip, 0x1000, 4096, 0, 1, 4096);
+  dump_chunked(mem, chip, 0, flash_25xx.size, 0, flash_25xx.size / 4096, 4096);
+
+out:
+  free(image);
+  memoree_deinit(mem, true);
+}
+
+/// @brief Speed of the bus \a mem is attached to, which is set by the first memoree_bus_init() or memoree_init() on a port
+static uint32_t bus_speed(memoree_t mem)
+{
+  memoree_info_t info = {0};
+  CHECK(memoree_get_info(mem, &info) == MEMOREE_ERR_OK);
+  return info.speed;
+}
+
+/// @brief A bus stays initialized while a memoree_bus_init() reference or an attached chip holds it
+static void test_bus_refs(void)
+{
+  memoree_sim_conf_t conf = eeprom_24xx;
+  int chips[2] = {memoree_sim_add(&conf), -1};
+  conf.addr = 0x51;
+  chips[1] = memoree_sim_add(&conf);
+  CHECK(chips[0] >= 0 && chips[1] >= 0);
+
+  memoree_i2c_conf_t bus_conf = {.port = SIM_I2C_PORT, .speed = 400000};
+  memoree_bus_t bus = memoree_bus_init(MEMOREE_TYPE_I2C, &bus_conf);
+  CHECK(bus && memoree_bus_init(MEMOREE_TYPE_I2C, &bus_conf) == bus);
+
+  // One chip attaches to the bus object, the other to the bus of its port, at the speed the bus was set up with
+  memoree_i2c_conf_t conf_0 = {.addr = 0x50, .bus = bus};
+  memoree_i2c_conf_t conf_1 = {.port = SIM_I2C_PORT, .addr = 0x51, .speed = 100000};
+  memoree_t mems[2] = {memoree_init(MEMOREE_VARIANT_24XX256, &conf_0), memoree_init(MEMOREE_VARIANT_24XX256, &conf_1)};
+  CHECK(mems[0] && mems[1]);
+  if (!bus || !mems[0] || !mems[1])
+    return;
+  CHECK(bus_speed(mems[0]) == 400000 && bus_speed(mems[1]) == 400000);
+
+  // A bus of the wrong type is refused without taking a reference
+  memoree_spi_conf_t spi_conf = {.cs_pin = 1, .speed = 1000000, .bus = bus};
+  CHECK(!memoree_init(MEMOREE_VARIANT_25XX_SFDP, &spi_conf));
+
+  CHECK(memoree_bus_deinit(bus) == MEMOREE_ERR_OK);
+  CHECK(memoree_bus_deinit(bus) == MEMOREE_ERR_OK);
+  CHECK(memoree_bus_deinit(NULL) == MEMOREE_ERR_INVALID_ARG);
+
+  // The chips keep the bus after its memoree_bus_init() references are gone, and each other's after one leaves
+  uint8_t bytes[2][4] = {{1, 2, 3, 4}, {5, 6, 7, 8}};
+  for (int i = 0; i < 2; i++)
+  {
+    CHECK(memoree_write(mems[i], 100, bytes[i], 4, 100, false) == 4);
+    CHECK(!memcmp(memoree_sim_data(chips[i]) + 100, bytes[i], 4));
+  }
+  CHECK(memoree_deinit(mems[0], true) == MEMOREE_ERR_OK);
+  uint8_t readback[4];
+  CHECK(memoree_read(mems[1], 100, readback, 4, 100) == 4 && !memcmp(readback, bytes[1], 4));
+  CHECK(memoree_deinit(mems[1], true) == MEMOREE_ERR_OK);
+
+  // Once the last reference is gone the port gets a new bus at the speed of the next chip
+  mems[0] = memoree_init(MEMOREE_VARIANT_24XX256, &conf_1);
+  CHECK(mems[0] && bus_speed(mems[0]) == 100000);
+  memoree_deinit(mems[0], true);
+}
+
+/// @brief Every device of a gang gets its own status, so that one failing device does not hide the others
+static void test_gang(void)
+{
+  // Two EEPROMs on the I2C bus, an address with nothing behind it, and two flash parts, one of them not erased
+  memoree_sim_conf_t eeprom = eeprom_24xx, flash = flash_25xx;
+  int chips[5];
+  chips[0] = memoree_sim_add(&eeprom);
+  eeprom.addr = 0x51;
+  chips[1] = memoree_sim_add(&eeprom);
+  chips[2] = -1;
+  chips[3] = memoree_sim_add(&flash);
+  flash.cs_pin = 2;
+  chips[4] = memoree_sim_add(&flash);
+
+  memoree_t devs[5] = {0};
+  for (int i = 0; i < 3; i++)
+  {
+    memoree_i2c_conf_t i2c_conf = {.port = SIM_I2C_PORT, .addr = 0x50 + i, .speed = 400000};
+    devs[i] = memoree_init(MEMOREE_VARIANT_24XX256, &i2c_conf);
+  }
+  for (int i = 3; i < 5; i++)
+  {
+    memoree_spi_conf_t spi_conf = {.port = SIM_SPI_PORT, .cs_pin = i - 2, .speed = 40000000};
+    devs[i] = memoree_init(MEMOREE_VARIANT_25XX_SFDP, &spi_conf);
+  }
+  const uint32_t addr = 0x100, len = 4096;
+  uint8_t *image = random_image(len);
+  bool ok = image && chips[0] >= 0 && chips[1] >= 0 && chips[3] >= 0 && chips[4] >= 0;
+  for (int i = 0; i < 5; i++)
+    ok &= devs[i] != NULL;
+  CHECK(ok);
+  if (!ok)
+    goto out;
+  memset(memoree_sim_data(chips[4]) + addr, 0x00, len);
+
+  memoree_err_t status[5];
+  CHECK(memoree_gang_program(devs, 5, addr, image, len, status) == 3);
+  CHECK(status[0] == MEMOREE_ERR_OK && status[1] == MEMOREE_ERR_OK && status[3] == MEMOREE_ERR_OK);
+  CHECK(status[2] == MEMOREE_ERR_TIMEOUT);
+  CHECK(status[4] == MEMOREE_ERR_MISMATCH);
+  for (int i = 0; i < 5; i++)
+    if (chips[i] >= 0 && i != 4)
+      CHECK(!memcmp(memoree_sim_data(chips[i]) + addr, image, len));
+
+  // A range past the end of the EEPROMs is refused for them only, as is a missing device
+  CHECK(memoree_gang_program(devs, 5, eeprom.size - 10, image, 20, status) == 2);
+  for (int i = 0; i < 3; i++)
+    CHECK(status[i] == MEMOREE_ERR_INVALID_ARG);
+  CHECK(status[3] == MEMOREE_ERR_OK && status[4] == MEMOREE_ERR_OK);
+  CHECK(!memcmp(memoree_sim_data(chips[4]) + eeprom.size - 10, image, 20));
+
+  memoree_t missing[2] = {devs[0], NULL};
+  CHECK(memoree_gang_program(missing, 2, addr, image, len, status) == 1);
+  CHECK(status[0] == MEMOREE_ERR_OK && status[1] == MEMOREE_ERR_INVALID_ARG);
+
+out:
+  free(image);
+  for (int i = 0; i < 5; i++)
+    memoree_deinit(devs[i], true);
+}
+
+/// @brief Write \a vol whole from \a image, starting a few bytes in, and read it back
+/// @return Size of the volume, or 0 on failure
+static uint32_t volume_round_trip(memoree_volume_t vol, memoree_volume_layout_t layout, uint8_t *image)
+{
+  memoree_volume_info_t info = {0};
+  CHECK(vol && memoree_volume_get_info(vol, &info) == MEMOREE_ERR_OK && info.layout == layout);
+  uint8_t *readback = calloc(1, info.size);
+  if (!vol || !readback)
+  {
+    free(readback);
+    return 0;
+  }
+
+  CHECK(memoree_volume_write(vol, 5, image + 5, info.size - 5) == (int)info.size - 5);
+  CHECK(memoree_volume_write(vol, 0, image, 5) == 5);
+  CHECK(memoree_volume_read(vol, 0, readback, info.size, 1000) == (int)info.size);
+  CHECK(!memcmp(readback, image, info.size));
+  CHECK(memoree_volume_read(vol, 1000, readback, 3000, 1000) == 3000 && !memcmp(readback, image + 1000, 3000));
+  CHECK(memoree_volume_write(vol, info.size - 1, image, 2) == MEMOREE_ERR_INVALID_ARG);
+  free(readback);
+  return info.size;
+}
+
+/// @brief Concatenated, striped and mirrored volumes over 24XX parts of different sizes
+static void test_volumes(void)
+{
+  // Two 8 KB parts with 32-byte pages and a 16 KB part with 64-byte pages
+  static const struct
+  {
+    memoree_variant_t variant;
+    uint32_t size;
+    uint16_t page_size;
+  } parts[3] = {{MEMOREE_VARIANT_24XX64, 8192, 32}, {MEMOREE_VARIANT_24XX64, 8192, 32}, {MEMOREE_VARIANT_24XX128, 16384, 64}};
+  int chips[3];
+  memoree_t mems[3];
+  for (int i = 0; i < 3; i++)
+  {
+    memoree_sim_conf_t conf = eeprom_24xx;
+    conf.addr = 0x50 + i;
+    conf.size = parts[i].size;
+    conf.page_size = parts[i].page_size;
+    memoree_i2c_conf_t i2c_conf = {.port = SIM_I2C_PORT, .addr = conf.addr, .speed = 400000};
+    mems[i] = attach(&conf, parts[i].variant, &i2c_conf, &chips[i]);
+  }
+  uint8_t *image = random_image(32768);
+  if (!mems[0] || !mems[1] || !mems[2] || !image)
+    goto out;
+
+  // The 16 KB part sits between the 8 KB ones
+  memoree_t concat[3] = {mems[0], mems[2], mems[1]};
+  memoree_volume_t vol = memoree_volume_init(MEMOREE_VOLUME_CONCAT, concat, 3);
+  CHECK(volume_round_trip(vol, MEMOREE_VOLUME_CONCAT, image) == 32768);
+  CHECK(!memcmp(memoree_sim_data(chips[0]), image, 8192));
+  CHECK(!memcmp(memoree_sim_data(chips[2]), image + 8192, 16384));
+  CHECK(!memcmp(memoree_sim_data(chips[1]), image + 24576, 8192));
+  memoree_volume_deinit(vol);
+
+  // Stripes are a page long and alternate between the members, which must share their page size
+  CHECK(!memoree_volume_init(MEMOREE_VOLUME_STRIPE, concat, 3));
+  vol = memoree_volume_init(MEMOREE_VOLUME_STRIPE, mems, 2);
+  CHECK(volume_round_trip(vol, MEMOREE_VOLUME_STRIPE, image) == 16384);
+  bool striped = true;
+  for (uint32_t stripe = 0; stripe < 16384 / 32; stripe++)
+    striped &= !memcmp(memoree_sim_data(chips[stripe % 2]) + stripe / 2 * 32, image + stripe * 32, 32);
+  CHECK(striped);
+  memoree_volume_deinit(vol);
+
+  // Mirrors are as large as their smallest member, and every member holds a copy
+  for (uint32_t i = 0; i < 8192; i++)
+    image[i] ^= 0xFF;
+  vol = memoree_volume_init(MEMOREE_VOLUME_MIRROR, concat, 3);
+  CHECK(volume_round_trip(vol, MEMOREE_VOLUME_MIRROR, image) == 8192);
+  for (int i = 0; i < 3; i++)
+    CHECK(!memcmp(memoree_sim_data(chips[i]), image, 8192));
+  memoree_volume_deinit(vol);
+
+  // The members stay usable on their own
+  uint8_t byte;
+  CHECK(memoree_read_byte(mems[2], 8192, &byte, 100) == MEMOREE_ERR_OK && byte == memoree_sim_data(chips[2])[8192]);
+
+out:
+  free(image);
+  for (int i = 0; i < 3; i++)
+    memoree_deinit(mems[i], true);
+}
+
+#if MEMOREE_STATS
+/// @brief Check that the latencies of the \a op operations of \a stats add up to their count, and that the
+///        operation lasting \a us is in its bucket
+static void check_latency(const memoree_stats_t *stats, memoree_stats_op_t op, uint64_t us)
+{
+  uint32_t total = 0;
+  for (int i = 0; i < MEMOREE_STATS_BUCKETS; i++)
+    total += stats->latency[op][i];
+  CHECK(total == stats->ops[op]);
+
+  int bucket = 0;
+  while (bucket < MEMOREE_STATS_BUCKETS - 1 && us >= (2ULL << bucket))
+    bucket++;
+  CHECK(stats->latency[op][bucket] >= 1);
+}
+
+/// @brief Counters of the bytes moved, the bus and wait time, and the latency of each operation
+static void test_stats(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  memoree_i2c_conf_t absent_conf = {.port = SIM_I2C_PORT, .addr = 0x57, .speed = 400000};
+  memoree_t absent = memoree_init(MEMOREE_VARIANT_24XX256, &absent_conf);
+  uint8_t *image = random_image(640);
+  CHECK(absent);
+  if (!mem || !absent || !image)
+    goto out;
+
+  // Ten pages, each waiting out its write cycle, and the polls in between
+  memoree_stats_t stats;
+  uint64_t start = memoree_sim_time_us();
+  CHECK(memoree_write(mem, 0, image, 640, 100, false) == 640);
+  uint64_t write_us = memoree_sim_time_us() - start;
+  CHECK(memoree_get_stats(mem, &stats) == MEMOREE_ERR_OK);
+  CHECK(stats.ops[MEMOREE_STATS_OP_WRITE] == 1 && stats.bytes_written == 640 && stats.bytes_read == 0);
+  CHECK(stats.transactions >= 10 && stats.polls > 0);
+  CHECK(stats.wait_us >= 9 * eeprom_24xx.write_time_us && stats.wait_us + stats.bus_us <= write_us);
+  CHECK(stats.bus_us >= i2c_time_us(640, 400000));
+  CHECK(!stats.timeouts && !stats.errors);
+  check_latency(&stats, MEMOREE_STATS_OP_WRITE, write_us);
+
+  start = memoree_sim_time_us();
+  CHECK(memoree_read(mem, 0, image, 640, 100) == 640);
+  uint64_t read_us = memoree_sim_time_us() - start;
+  start = memoree_sim_time_us();
+  CHECK(memoree_erase_page(mem, 0, 0xFF) == MEMOREE_ERR_OK);
+  uint64_t erase_us = memoree_sim_time_us() - start;
+  CHECK(memoree_checksum(mem, 0, 64, MEMOREE_CHECKSUM_CRC32, &(uint32_t){0}) == MEMOREE_ERR_OK);
+  CHECK(memoree_get_stats(mem, &stats) == MEMOREE_ERR_OK);
+  CHECK(stats.ops[MEMOREE_STATS_OP_READ] == 2 && stats.bytes_read == 640 + 64);
+  CHECK(stats.ops[MEMOREE_STATS_OP_ERASE] == 1 && stats.bytes_written == 640);
+  check_latency(&stats, MEMOREE_STATS_OP_READ, read_us);
+  check_latency(&stats, MEMOREE_STATS_OP_ERASE, erase_us);
+
+  CHECK(memoree_reset_stats(mem) == MEMOREE_ERR_OK);
+  CHECK(memoree_get_stats(mem, &stats) == MEMOREE_ERR_OK);
+  CHECK(!stats.ops[MEMOREE_STATS_OP_READ] && !stats.transactions && !stats.bus_us && !stats.latency[MEMOREE_STATS_OP_READ][0]);
+
+  // A read nobody acknowledges counts as an operation, but not its bytes
+  CHECK(memoree_read(absent, 0, image, 16, 10) < 0);
+  CHECK(memoree_get_stats(absent, &stats) == MEMOREE_ERR_OK);
+  CHECK(stats.ops[MEMOREE_STATS_OP_READ] == 1 && stats.bytes_read == 0 && stats.timeouts + stats.errors > 0);
+
+out:
+  free(image);
+  memoree_deinit(absent, true);
+  memoree_deinit(mem, true);
+}
+#else
+/// @brief Without MEMOREE_STATS the counters are not kept
+static void test_stats(void)
+{
+  int chip;
+  memoree_t mem = attach_24xx(&eeprom_24xx, &chip);
+  memoree_stats_t stats;
+  CHECK(memoree_get_stats(mem, &stats) == MEMOREE_ERR_FAIL);
+  CHECK(memoree_reset_stats(mem) == MEMOREE_ERR_FAIL);
+  memoree_deinit(mem, true);
+}
+#endif
+
+/// @brief Four 24XX parts sharing an I2C bus, written one after the other and then together
+static void test_write_multi(void)
+{
+  enum
+  {
+    DEVICES = 4,
+    LEN = 8192,
+  };
+
+  memoree_t mems[DEVICES];
+  int chips[DEVICES];
+  uint8_t *images[DEVICES];
+  memoree_write_req_t reqs[DEVICES];
+
+  for (int i = 0; i < DEVICES; i++)
+  {
+    memoree_sim_conf_t conf = {
+        .chip = MEMOREE_SIM_CHIP_24XX,
+        .port = SIM_I2C_PORT,
+        .addr = 0x50 + i,
+        .size = 32768,
+        .page_size = 64,
+        .addr_len = 16,
+        .write_time_us = 5000,
+    };
+    memoree_i2c_conf_t i2c_conf = {.port = SIM_I2C_PORT, .addr = 0x50 + i, .speed = 400000};
+
+    chips[i] = memoree_sim_add(&conf);
+    mems[i] = memoree_init(MEMOREE_VARIANT_24XX256, &i2c_conf);
+    images[i] = random_image(LEN);
+    CHECK(chips[i] >= 0 && mems[i] && images[i]);
+    if (chips[i] < 0 || !mems[i] || !images[i])
+      return;
+
+    reqs[i] = (memoree_write_req_t){.mem = mems[i], .addr = 0, .data = images[i], .len = LEN};
+  }
+
+  uint64_t start = memoree_sim_time_us();
+  for (int i = 0; i < DEVICES; i++)
+    CHECK(memoree_write(mems[i], 0, images[i], LEN, 100, false) == LEN);
+  uint64_t sequential_us = memoree_sim_time_us() - start;
+
+  for (int i = 0; i < DEVICES; i++)
+    images[i][0] ^= 0xFF;
+
+  start = memoree_sim_time_us();
+  CHECK(memoree_write_multi(reqs, DEVICES) == DEVICES);
+  uint64_t multi_us = memoree_sim_time_us() - start;
+
+  for (int i = 0; i < DEVICES; i++)
+  {
+    CHECK(reqs[i].result == LEN);
+    CHECK(!memcmp(memoree_sim_data(chips[i]), images[i], LEN));
+    free(images[i]);
+    memoree_deinit(mems[i], true);
+  }
+
+  // The write cycles of all four parts overlap, so the bus is the limit rather than the write cycles
+  CHECK(multi_us * 2 < sequential_us);
+}
+
+int main(void)
+{
+  static const struct
+  {
+    const char *name;
+    void (*run)(void);
+  } tests[] = {
+      {"24XX", test_24xx},
+      {"93CXX", test_93cxx},
+      {"25XX", test_25xx},
+      {"25XX 4-byte", test_25xx_4byte},
+      {"SFDP tables", test_sfdp},
+      {"erase_range", test_erase_range},
+      {"async", test_async},
+      {"max_transfer", test_max_transfer},
+      {"24XX blocks", test_24xx_blocks},
+      {"write cache", test_write_cache},
+      {"read cache", test_read_cache},
+      {"write_diff", test_write_diff},
+      {"checksum", test_checksum},
+      {"stream", test_program_stream},
+      {"dump_stream", test_dump_stream},
+      {"bus refs", test_bus_refs},
+      {"gang", test_gang},
+      {"volumes", test_volumes},
+      {"stats", test_stats},
+      {"write_multi", test_write_multi},
+  };
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+  {
+    int before = failures;
+    tests[i].run();
+    memoree_sim_reset();
+    printf("%-12s %s\n", tests[i].name, (failures == before) ? "ok" : "FAILED");
+  }
+
+  printf("%d failed checks\n", failures);
+  return failures ? 1 : 0;
+}